@@ -73,7 +73,7 @@ void loop(void) {
     switch (status) {
     case PmsStatus::OK: {
         Serial.println("_________________");
-        const auto newRead = millis();
+        const auto newRead = pms.getFrameTimestamp(); // arrival of the frame, not the time of read()
         Serial.print("Wait time ");
         Serial.println(newRead - lastRead);
         lastRead = newRead;
@@ -0,0 +1,42 @@
+#pragma once
+
+// Tiny helpers shared by host benchmarks: stopwatch and report lines
+
+#include <chrono>
+#include <stdio.h>
+
+namespace bench {
+
+	class Stopwatch {
+		std::chrono::steady_clock::time_point t0;
+	public:
+		Stopwatch() : t0(std::chrono::steady_clock::now()) {}
+
+		void restart() {
+			t0 = std::chrono::steady_clock::now();
+		}
+
+		double seconds() const {
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		}
+	};
+
+	inline void header(const char* title) {
+		printf("\n== %s\n", title);
+	}
+
+	// name: count items in seconds -> items/s, ns/item
+	inline void rate(const char* name, const double count, const double seconds, const char* unit = "frame") {
+		printf("  %-36s %12.0f %s/s %10.1f ns/%s\n", name, seconds > 0 ? count / seconds : 0.0, unit, count > 0 ? seconds * 1e9 / count : 0.0, unit);
+	}
+
+	inline void value(const char* name, const double value, const char* unit = "") {
+		printf("  %-36s %12.3f %s\n", name, value, unit);
+	}
+
+	// keeps the result alive, so the compiler can not remove measured code
+	template <typename T>
+	inline void doNotOptimize(const T& value) {
+		asm volatile("" : : "g"(&value) : "memory");
+	}
+}
@@ -0,0 +1,762 @@
+// Parser benchmarks using simulated sensor (PmsSimSerial), no hardware is required
+//
+// Usage: pmsBench [all|read|dispatch|parser|capture|resync|status|statistics|cleanliness|history|rollup|latest|replay] [iterations]
+//   read   - Pms::read() throughput
+//   dispatch - virtual IPmsSerial vs. direct calls (BasicPms<Model, SerialT>) vs. PmsSerialAdapter
+//   parser - PmsParser::feed() throughput for different chunk sizes
+//   capture - batch decoding of a recorded capture (PmsCaptureDecoder) vs. PmsParser::feed() vs. memcpy()
+//   resync - cost of recovery after every kind of injected fault
+//   status - PmsStatus outcome rates for random fault mix
+//   statistics - PmsStatistics, PmsQuantiles, PmsAirQuality and PmsFilter update cost
+//   cleanliness - ISO 14644-1 levels: float getLevel() vs. fixed point getLevelFixed(), getLevels(), getCleanlinessLevels(); accuracy over all values
+//   history - PmsHistoryWriter size per sample, encode and decode throughput
+//   rollup - PmsRollup update cost (a frame per second), range queries of the whole history at hour, minute and raw resolution
+//   latest - PmsLatest (seqlock) publish/get cost, sampling thread throughput with busy readers: seqlock vs. std::mutex
+//   replay - Pms::read() through PmsRecorderSerial, then the recording replayed through Pms as fast as possible (PmsReplaySerial)
+//
+// Run it before and after any parser change, compare the numbers. Correctness is checked by tests (extras/test, ctest), not here
+
+#include <pms.h>
+#include <pmsSerialSimulator.h>
+#include <pmsStatistics.h>
+#include <pmsAirQuality.h>
+#include <pmsFilter.h>
+#include <pmsHistory.h>
+#include <pmsRollup.h>
+#include <pmsCapture.h>
+#include <pmsLatest.h>
+#include <pmsSerialRecorder.h>
+#include "bench.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace pmsx;
+
+namespace {
+
+	PmsData sampleData() {
+		PmsData data{};
+		for (PmsData::pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+			data.raw[i] = static_cast<pmsData_t>(1000 + 37 * i);
+		}
+		return data;
+	}
+
+	void benchRead(const unsigned long iterations) {
+		bench::header("Pms::read() throughput");
+
+		PmsSimSerial sim;
+		sim.setInterval(0);
+		sim.setData(sampleData());
+		Pms pms(&sim);
+		pms.begin();
+
+		PmsData data;
+		unsigned long ok = 0;
+		bench::Stopwatch stopwatch;
+		for (unsigned long i = 0; i < iterations; ++i) {
+			sim.emitFrame();
+			if (pms.read(data) == PmsStatus::OK) {
+				++ok;
+			}
+			bench::doNotOptimize(data);
+		}
+		const auto seconds = stopwatch.seconds();
+		bench::rate("Pms::read (with simulator)", static_cast<double>(ok), seconds);
+	}
+
+	// noise: garbage bytes before every frame, skipped by available() (chunks passed to the parser)
+	template <typename PmsT>
+	void benchDispatchOne(const char* name, PmsT& pms, PmsSimSerial& sim, const unsigned long iterations, const size_t noise) {
+		pms.begin();
+		PmsData data;
+		unsigned long ok = 0;
+		bench::Stopwatch stopwatch;
+		for (unsigned long i = 0; i < iterations; ++i) {
+			if (noise > 0) {
+				sim.injectGarbage(noise);
+			}
+			sim.emitFrame();
+			pms.available();
+			if (pms.read(data) == PmsStatus::OK) {
+				++ok;
+			}
+			bench::doNotOptimize(data);
+		}
+		bench::rate(name, static_cast<double>(ok), stopwatch.seconds());
+	}
+
+	void benchDispatch(const unsigned long iterations) {
+		const size_t noises[]{ 0, 16 };
+		for (const auto noise : noises) {
+			char title[80];
+			snprintf(title, sizeof title, "Serial dispatch, %zu bytes of noise before every frame", noise);
+			bench::header(title);
+
+			PmsSimSerial sim;
+			sim.setInterval(0);
+			sim.setData(sampleData());
+
+			Pms virtualPms(&sim);
+			benchDispatchOne("virtual: Pms (IPmsSerial*)", virtualPms, sim, iterations, noise);
+
+			BasicPms<Pms5003, PmsSimSerial> directPms(&sim);
+			benchDispatchOne("direct: BasicPms<.., PmsSimSerial>", directPms, sim, iterations, noise);
+
+			PmsSerialAdapter<PmsSimSerial> adapter(sim);
+			Pms adaptedPms(&adapter);
+			benchDispatchOne("type erased: PmsSerialAdapter", adaptedPms, sim, iterations, noise);
+		}
+	}
+
+	void benchParser(const unsigned long iterations) {
+		bench::header("PmsParser::feed() throughput");
+
+		PmsSimSerial sim;
+		sim.setInterval(0);
+		sim.setData(sampleData());
+		sim.begin(9600);
+
+		constexpr size_t framesInStream = 64;
+		std::vector<uint8_t> stream(framesInStream * PmsData::FRAME_SIZE);
+		for (size_t i = 0; i < framesInStream; ++i) {
+			sim.emitFrame();
+			sim.read(stream.data() + i * PmsData::FRAME_SIZE, PmsData::FRAME_SIZE);
+		}
+
+		const size_t chunks[]{ 1, 7, PmsData::FRAME_SIZE, stream.size() };
+		for (const auto chunk : chunks) {
+			PmsParser parser;
+			unsigned long ok = 0;
+			const unsigned long rounds = iterations / framesInStream + 1;
+			bench::Stopwatch stopwatch;
+			for (unsigned long round = 0; round < rounds; ++round) {
+				for (size_t pos = 0; pos < stream.size(); pos += chunk) {
+					parser.feed(stream.data() + pos, min(chunk, stream.size() - pos), [&ok](PmsStatus status, const PmsData& data) {
+						bench::doNotOptimize(data);
+						ok += status == PmsStatus::OK;
+					});
+				}
+			}
+			const auto seconds = stopwatch.seconds();
+			char name[40];
+			snprintf(name, sizeof name, "feed, chunk %zu bytes", chunk);
+			bench::rate(name, static_cast<double>(ok), seconds);
+		}
+	}
+
+	void benchCaptureRate(const char* name, const double frames, const double bytes, const double seconds) {
+		char label[48];
+		snprintf(label, sizeof label, "%s (MB/s)", name);
+		bench::rate(name, frames, seconds);
+		bench::value(label, bytes / seconds / 1e6, "MB/s");
+	}
+
+	void benchCapture(const unsigned long iterations) {
+		bench::header("Batch decoding of a capture, 1% of frames damaged");
+
+		PmsSimSerial sim;
+		sim.setInterval(0);
+		sim.setData(sampleData());
+		sim.begin(9600);
+
+		std::vector<uint8_t> capture;
+		capture.reserve(iterations * (PmsData::FRAME_SIZE + 1));
+		uint8_t buffer[256];
+		for (unsigned long i = 0; i < iterations; ++i) {
+			switch (i % 400) {
+			case 100: sim.injectGarbage(7); break;
+			case 200: sim.injectTruncatedFrame(13); break;
+			case 300: sim.injectBadChecksum(); break;
+			case 399: sim.injectBadLength(); break;
+			default: break;
+			}
+			sim.emitFrame();
+			for (size_t got = sim.read(buffer, sizeof buffer); got > 0; got = sim.read(buffer, sizeof buffer)) {
+				capture.insert(capture.end(), buffer, buffer + got);
+			}
+		}
+		// At least 256 MB per measurement
+		const unsigned long rounds = 256UL * 1024 * 1024 / (capture.size() + 1) + 1;
+		const double bytes = static_cast<double>(capture.size()) * rounds;
+
+		std::vector<uint8_t> copy(capture.size());
+		bench::Stopwatch stopwatch;
+		for (unsigned long round = 0; round < rounds; ++round) {
+			memcpy(copy.data(), capture.data(), capture.size());
+			bench::doNotOptimize(copy[round % copy.size()]);
+		}
+		benchCaptureRate("memcpy", static_cast<double>(iterations) * rounds, bytes, stopwatch.seconds());
+
+		unsigned long parsed = 0;
+		stopwatch.restart();
+		for (unsigned long round = 0; round < rounds; ++round) {
+			PmsParser parser;
+			parser.feed(capture.data(), capture.size(), [&parsed](PmsStatus status, const PmsData& data) {
+				bench::doNotOptimize(data);
+				parsed += status == PmsStatus::OK;
+			});
+		}
+		benchCaptureRate("PmsParser::feed", static_cast<double>(parsed), bytes, stopwatch.seconds());
+
+		constexpr size_t capacity = 64 * 1024;
+		// Padding: columns spaced by 128 KB share cache sets
+		std::vector<pmsData_t> columnData((capacity + 32) * PmsData::DATA_SIZE);
+		pmsData_t* columns[PmsData::DATA_SIZE];
+		for (pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+			columns[i] = columnData.data() + i * (capacity + 32);
+		}
+		std::vector<uint64_t> offsets(capacity);
+		PmsCaptureDecoder decoder(columns, offsets.data(), capacity);
+		stopwatch.restart();
+		for (unsigned long round = 0; round < rounds; ++round) {
+			for (size_t done = 0; done < capture.size();) {
+				const size_t used = decoder.decode(capture.data() + done, capture.size() - done, done);
+				bench::doNotOptimize(columns[4][decoder.getFrames() / 2]);
+				decoder.clear();
+				if (used == 0) {
+					break;
+				}
+				done += used;
+			}
+			decoder.finish();
+		}
+		const auto seconds = stopwatch.seconds();
+		const auto& counters = decoder.getCounters();
+		benchCaptureRate("PmsCaptureDecoder::decode", static_cast<double>(counters.frames), bytes, seconds);
+		bench::value("frames found: decoder - parser", static_cast<double>(counters.frames) - static_cast<double>(parsed), "");
+	}
+
+	enum class Fault : uint8_t { NONE, GARBAGE, TRUNCATED, BAD_CHECKSUM, BAD_LENGTH };
+
+	const char* faultName(const Fault fault) {
+		switch (fault) {
+		case Fault::NONE: return "none";
+		case Fault::GARBAGE: return "garbage (1..16 bytes)";
+		case Fault::TRUNCATED: return "truncated frame";
+		case Fault::BAD_CHECKSUM: return "bad checksum";
+		case Fault::BAD_LENGTH: return "wrong frame length";
+		}
+		return "?";
+	}
+
+	void inject(PmsSimSerial& sim, const Fault fault, const unsigned long seed) {
+		switch (fault) {
+		case Fault::NONE:
+			break;
+		case Fault::GARBAGE:
+			sim.injectGarbage(1 + seed % 16);
+			break;
+		case Fault::TRUNCATED:
+			sim.injectTruncatedFrame(1 + seed % (PmsData::FRAME_SIZE - 1));
+			break;
+		case Fault::BAD_CHECKSUM:
+			sim.injectBadChecksum();
+			break;
+		case Fault::BAD_LENGTH:
+			sim.injectBadLength();
+			break;
+		}
+	}
+
+	void benchResync(const unsigned long iterations) {
+		bench::header("Resync after a fault (fault followed by 4 good frames)");
+		printf("  %-24s %14s %14s %14s %14s\n", "fault", "lost frames", "read() calls", "skipped bytes", "us/recovery");
+
+		constexpr unsigned long goodFrames = 4;
+		const Fault faults[]{ Fault::NONE, Fault::GARBAGE, Fault::TRUNCATED, Fault::BAD_CHECKSUM, Fault::BAD_LENGTH };
+		const unsigned long trials = iterations / 10 + 1;
+
+		for (const auto fault : faults) {
+			PmsSimSerial sim;
+			sim.setInterval(0);
+			sim.setData(sampleData());
+			Pms pms(&sim);
+			pms.begin();
+
+			unsigned long lost = 0;
+			unsigned long calls = 0;
+			PmsData data;
+			bench::Stopwatch stopwatch;
+			for (unsigned long trial = 0; trial < trials; ++trial) {
+				sim.flushInput();
+				inject(sim, fault, trial);
+				for (unsigned long i = 0; i < goodFrames; ++i) {
+					sim.emitFrame();
+				}
+				unsigned long ok = 0;
+				for (;;) {
+					++calls;
+					const auto status = pms.read(data);
+					if (status == PmsStatus::NO_DATA) {
+						break;
+					}
+					ok += status == PmsStatus::OK;
+				}
+				lost += goodFrames - ok;
+			}
+			const auto seconds = stopwatch.seconds();
+			printf("  %-24s %14.3f %14.2f %14.2f %14.3f\n", faultName(fault), static_cast<double>(lost) / trials, static_cast<double>(calls) / trials, static_cast<double>(pms.getSkipped()) / trials, seconds * 1e6 / trials);
+		}
+	}
+
+	void benchStatus(const unsigned long iterations) {
+		bench::header("PmsStatus outcome rates (10% of frames are faulty)");
+
+		PmsSimSerial sim;
+		sim.setInterval(0);
+		sim.setData(sampleData());
+		Pms pms(&sim);
+		pms.begin();
+
+		unsigned long outcomes[PmsStatus::NO_SERIAL + 1]{};
+		unsigned long faults = 0;
+		uint32_t seed = 12345;
+		PmsData data;
+		for (unsigned long i = 0; i < iterations; ++i) {
+			seed = seed * 1103515245U + 12345U;
+			const auto draw = (seed >> 8) % 40;
+			if (draw < 4) {
+				inject(sim, static_cast<Fault>(1 + draw), seed >> 16);
+				++faults;
+			}
+			sim.emitFrame();
+			for (;;) {
+				const auto status = pms.read(data);
+				++outcomes[status];
+				if (status == PmsStatus::NO_DATA) {
+					break;
+				}
+			}
+		}
+
+		printf("  frames sent %lu, faults injected %lu\n", sim.getFramesSent(), faults);
+		for (uint8_t status = PmsStatus::OK; status <= PmsStatus::NO_SERIAL; ++status) {
+			PmsStatus value{ status };
+			printf("  %-36s %12lu %8.3f %%\n", value.getErrorMsg(), outcomes[status], 100.0 * outcomes[status] / sim.getFramesSent());
+		}
+	}
+
+	// Noisy signal with a spike every 64 frames, all channels filtered
+	template <uint8_t Window>
+	void benchFilter(const char* name, const PmsFilterConfig& config, const unsigned long iterations) {
+		PmsFilter<Window> filter;
+		filter.setConfig(config);
+		PmsData data = sampleData();
+		uint32_t noise = 1;
+		bench::Stopwatch stopwatch;
+		for (unsigned long i = 0; i < iterations; ++i) {
+			for (PmsData::pmsIdx_t channel = 0; channel < PmsData::DATA_SIZE; ++channel) {
+				noise = noise * 1664525UL + 1013904223UL;
+				data.raw[channel] = static_cast<pmsData_t>(1000 + (noise >> 24) + (i % 64 == 0 ? 5000 : 0));
+			}
+			bench::doNotOptimize(filter.update(data));
+		}
+		bench::rate(name, static_cast<double>(iterations), stopwatch.seconds());
+		bench::doNotOptimize(filter);
+	}
+
+	void benchStatistics(const unsigned long iterations) {
+		bench::header("Streaming statistics, all channels");
+
+		PmsData data = sampleData();
+		PmsStatistics<16> statistics;
+		bench::Stopwatch stopwatch;
+		for (unsigned long i = 0; i < iterations; ++i) {
+			data.raw[i % PmsData::DATA_SIZE] = static_cast<pmsData_t>(i);
+			statistics.update(data);
+		}
+		bench::rate("PmsStatistics<16>::update", static_cast<double>(iterations), stopwatch.seconds());
+		bench::doNotOptimize(statistics);
+
+		PmsQuantiles quantiles(0.9f);
+		stopwatch.restart();
+		for (unsigned long i = 0; i < iterations; ++i) {
+			data.raw[i % PmsData::DATA_SIZE] = static_cast<pmsData_t>(i);
+			quantiles.update(data);
+		}
+		bench::rate("PmsQuantiles::update", static_cast<double>(iterations), stopwatch.seconds());
+		bench::doNotOptimize(quantiles);
+
+		// A frame per second: an hour (and NowCast) is closed every 3600 updates
+		PmsAirQuality airQuality;
+		stopwatch.restart();
+		for (unsigned long i = 0; i < iterations; ++i) {
+			data.raw[i % PmsData::DATA_SIZE] = static_cast<pmsData_t>(i);
+			airQuality.update(data, i * 1000UL);
+		}
+		bench::rate("PmsAirQuality::update", static_cast<double>(iterations), stopwatch.seconds());
+		bench::doNotOptimize(airQuality);
+
+		benchFilter<5>("PmsFilter<5>, Hampel + rate limit", PmsFilterConfig{ PmsFilterConfig::HAMPEL | PmsFilterConfig::RATE_LIMIT, 30, 5, 500 }, iterations);
+		benchFilter<31>("PmsFilter<31>, median", PmsFilterConfig{ PmsFilterConfig::MEDIAN, 0, 0, 0 }, iterations);
+	}
+
+	void benchCleanliness(const unsigned long iterations) {
+		bench::header("ISO 14644-1 cleanliness levels, 6 channels");
+
+		typedef PmsData::Cleanliness Cleanliness;
+		constexpr pmsIdx_t size = Cleanliness::SIZE;
+
+		// Accuracy: every possible value, every channel
+		PmsData data{};
+		double maxError = 0.0;
+		for (uint32_t value = 0; value <= 0xffffU; ++value) {
+			for (pmsIdx_t i = 0; i < size; ++i) {
+				data.particles[i] = static_cast<pmsData_t>(value);
+			}
+			for (pmsIdx_t i = 0; i < size; ++i) {
+				const double error = fabs(static_cast<double>(data.particles.getLevelFixed(i)) / Cleanliness::LEVEL_SCALE - data.particles.getLevel(i));
+				maxError = error > maxError ? error : maxError;
+			}
+		}
+		bench::value("fixed point max error", maxError * Cleanliness::LEVEL_SCALE, "1/1000 level"); // accuracy is checked by extras/test/pmsTestCleanliness
+
+		std::vector<PmsData> frames(1024);
+		uint32_t seed = 1;
+		for (auto& frame : frames) {
+			seed = seed * 1103515245U + 12345U;
+			for (pmsIdx_t i = 0; i < size; ++i) {
+				frame.particles[i] = static_cast<pmsData_t>((seed >> (i + 4)) & 0x3fffU);
+			}
+		}
+		const unsigned long rounds = iterations / frames.size() + 1;
+		const double channels = static_cast<double>(rounds) * frames.size() * size;
+
+		float levelSum = 0.0f;
+		bench::Stopwatch stopwatch;
+		for (unsigned long round = 0; round < rounds; ++round) {
+			for (const auto& frame : frames) {
+				for (pmsIdx_t i = 0; i < size; ++i) {
+					levelSum += frame.particles.getLevel(i);
+				}
+			}
+		}
+		bench::rate("float getLevel()", channels, stopwatch.seconds(), "level");
+		bench::doNotOptimize(levelSum);
+
+		unsigned long fixedSum = 0;
+		stopwatch.restart();
+		for (unsigned long round = 0; round < rounds; ++round) {
+			for (const auto& frame : frames) {
+				for (pmsIdx_t i = 0; i < size; ++i) {
+					fixedSum += frame.particles.getLevelFixed(i);
+				}
+			}
+		}
+		bench::rate("getLevelFixed()", channels, stopwatch.seconds(), "level");
+		bench::doNotOptimize(fixedSum);
+
+		std::vector<uint16_t> levels(frames.size() * size);
+		stopwatch.restart();
+		for (unsigned long round = 0; round < rounds; ++round) {
+			getCleanlinessLevels(frames.data(), frames.size(), levels.data());
+			bench::doNotOptimize(levels[round % levels.size()]);
+		}
+		bench::rate("getCleanlinessLevels() batch", channels, stopwatch.seconds(), "level");
+	}
+
+	// Random walk: values change slowly, PM channels move together
+	void nextSample(PmsData& data, uint32_t& seed) {
+		seed = seed * 1103515245U + 12345U;
+		const int step = static_cast<int>((seed >> 16) % 5) - 2;
+		for (PmsData::pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+			seed = seed * 1103515245U + 12345U;
+			const int own = i < 6 ? step : static_cast<int>((seed >> 16) % 9) - 4;
+			const int value = data.raw.getValue(i) + own;
+			data.raw[i] = static_cast<pmsData_t>(value < 0 ? 0 : value > 60000 ? 60000 : value);
+		}
+	}
+
+	void benchHistory(const unsigned long iterations) {
+		bench::header("History: delta + zigzag + varint blocks");
+
+		char path[]{ "/tmp/pmsBenchXXXXXX" };
+		const int fd = mkstemp(path);
+		FILE* file = fd < 0 ? nullptr : fdopen(fd, "wb");
+		if (file == nullptr) {
+			printf("  !!! can not create temporary file\n");
+			return;
+		}
+
+		PmsData data = sampleData();
+		uint32_t seed = 12345;
+		uint32_t timestamp = 0;
+		bench::Stopwatch stopwatch;
+		{
+			PmsHistoryFile sink(file);
+			PmsHistoryWriter<PmsHistoryFile> writer(sink);
+			writer.begin();
+			for (unsigned long i = 0; i < iterations; ++i) {
+				nextSample(data, seed);
+				timestamp += 1;
+				writer.append(timestamp, data);
+			}
+		}
+		fclose(file);
+		bench::rate("PmsHistoryWriter::append (with file)", static_cast<double>(iterations), stopwatch.seconds(), "sample");
+
+		PmsHistoryReader reader;
+		if (!reader.open(path)) {
+			printf("  !!! can not open %s\n", path);
+			unlink(path);
+			return;
+		}
+		const double bytes = static_cast<double>(PmsHistoryFormat::FILE_HEADER_SIZE + reader.getBlockCount() * PmsHistoryWriter<PmsHistoryFile>::BLOCK_SIZE);
+		bench::value("size per sample (frame: 32 bytes)", bytes / iterations, "bytes");
+
+		unsigned long decoded = 0;
+		stopwatch.restart();
+		for (size_t block = 0; block < reader.getBlockCount(); ++block) {
+			decoded += reader.decodeBlock(block, [](uint32_t, const PmsData& sample) {
+				bench::doNotOptimize(sample);
+			});
+		}
+		bench::rate("PmsHistoryReader::decodeBlock", static_cast<double>(decoded), stopwatch.seconds(), "sample");
+
+		const unsigned long lookups = 100000;
+		unsigned long found = 0;
+		stopwatch.restart();
+		for (unsigned long i = 0; i < lookups; ++i) {
+			seed = seed * 1103515245U + 12345U;
+			found += reader.findBlock(seed % (timestamp + 1)) < reader.getBlockCount();
+		}
+		bench::rate("PmsHistoryReader::findBlock", static_cast<double>(found), stopwatch.seconds(), "lookup");
+		unlink(path);
+	}
+
+	template <typename RollupT>
+	void benchRollupQuery(const char* name, const RollupT& rollup, const PmsRollupTier tier, const uint32_t now) {
+		const unsigned long queries = 100;
+		unsigned long entries = 0;
+		bench::Stopwatch stopwatch;
+		for (unsigned long i = 0; i < queries; ++i) {
+			entries += rollup.query(tier, 0, now, [](const PmsAggregate& entry) {
+				bench::doNotOptimize(entry);
+			});
+		}
+		const double seconds = stopwatch.seconds();
+		bench::rate(name, static_cast<double>(queries), seconds, "query");
+		bench::value("  entries per query", static_cast<double>(entries) / queries);
+	}
+
+	void benchRollup(const unsigned long iterations) {
+		bench::header("Rollup: raw frames, minutes, hours");
+
+		// A minute of frames, a day of minutes, 30 days of hours: about 240 KB
+		static PmsRollup<60, 1440, 720> rollup;
+		rollup.reset();
+		PmsData data = sampleData();
+		uint32_t seed = 12345;
+		uint32_t timestamp = 0;
+		bench::Stopwatch stopwatch;
+		for (unsigned long i = 0; i < iterations; ++i) {
+			nextSample(data, seed);
+			timestamp += 1;
+			rollup.update(timestamp, data);
+		}
+		bench::rate("PmsRollup::update", static_cast<double>(iterations), stopwatch.seconds());
+		bench::value("history, hours", (timestamp - rollup.getOldest(PmsRollupTier::HOUR)) / 3600.0);
+
+		benchRollupQuery("PmsRollup::query, hours", rollup, PmsRollupTier::HOUR, timestamp);
+		benchRollupQuery("PmsRollup::query, minutes", rollup, PmsRollupTier::MINUTE, timestamp);
+		benchRollupQuery("PmsRollup::query, raw", rollup, PmsRollupTier::RAW, timestamp);
+	}
+
+	// Readers poll the slot as fast as they can, the sampling thread publishes iterations readings
+	template <typename Publish, typename Get>
+	void benchLatestContended(const char* name, const unsigned long iterations, const unsigned readers, Publish publish, Get get) {
+		std::atomic<bool> stop{ false };
+		std::atomic<unsigned long> reads{ 0 };
+		std::vector<std::thread> threads;
+		for (unsigned i = 0; i < readers; ++i) {
+			threads.emplace_back([&]() {
+				unsigned long done = 0;
+				while (!stop.load(std::memory_order_relaxed)) {
+					get();
+					++done;
+				}
+				reads += done;
+			});
+		}
+		PmsData data = sampleData();
+		bench::Stopwatch stopwatch;
+		for (unsigned long i = 0; i < iterations; ++i) {
+			data.raw[i % PmsData::DATA_SIZE] = static_cast<pmsData_t>(i);
+			publish(data, i);
+		}
+		const double seconds = stopwatch.seconds();
+		stop = true;
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		bench::rate(name, static_cast<double>(iterations), seconds, "publish");
+		bench::value("  reads by all readers", static_cast<double>(reads.load()), "");
+	}
+
+	void benchLatest(const unsigned long iterations) {
+		bench::header("Latest reading for many readers");
+
+		PmsData data = sampleData();
+		PmsLatest latest;
+		bench::Stopwatch stopwatch;
+		for (unsigned long i = 0; i < iterations; ++i) {
+			data.raw[i % PmsData::DATA_SIZE] = static_cast<pmsData_t>(i);
+			latest.publish(PmsStatus{ PmsStatus::OK }, data, i);
+		}
+		bench::rate("PmsLatest::publish", static_cast<double>(iterations), stopwatch.seconds(), "publish");
+
+		PmsReading reading;
+		stopwatch.restart();
+		for (unsigned long i = 0; i < iterations; ++i) {
+			latest.get(reading);
+			bench::doNotOptimize(reading);
+		}
+		bench::rate("PmsLatest::get", static_cast<double>(iterations), stopwatch.seconds(), "get");
+
+		uint32_t version = latest.getVersion();
+		unsigned long changed = 0;
+		stopwatch.restart();
+		for (unsigned long i = 0; i < iterations; ++i) {
+			changed += latest.getChanged(reading, version);
+		}
+		bench::rate("PmsLatest::getChanged, unchanged", static_cast<double>(iterations), stopwatch.seconds(), "get");
+		bench::doNotOptimize(changed);
+
+		const unsigned readers = 4;
+		printf("  %u readers, %u CPUs\n", readers, std::thread::hardware_concurrency());
+		benchLatestContended("seqlock", iterations, readers, [&](const PmsData& data, const unsigned long timestamp) {
+			latest.publish(PmsStatus{ PmsStatus::OK }, data, timestamp);
+		}, [&]() {
+			PmsReading copy;
+			latest.get(copy);
+			bench::doNotOptimize(copy);
+		});
+
+		std::mutex mutex;
+		PmsReading shared;
+		benchLatestContended("std::mutex", iterations, readers, [&](const PmsData& data, const unsigned long timestamp) {
+			std::lock_guard<std::mutex> lock(mutex);
+			shared.status = PmsStatus{ PmsStatus::OK };
+			shared.timestamp = timestamp;
+			shared.data = data;
+		}, [&]() {
+			PmsReading copy;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				copy = shared;
+			}
+			bench::doNotOptimize(copy);
+		});
+	}
+
+	// Sink for PmsRecorderSerial: memory
+	class MemorySink {
+		std::vector<uint8_t>& bytes;
+	public:
+		explicit MemorySink(std::vector<uint8_t>& bytes) : bytes(bytes) {}
+
+		size_t write(const uint8_t* buffer, const size_t size) {
+			bytes.insert(bytes.end(), buffer, buffer + size);
+			return size;
+		}
+	};
+
+	void benchReplay(const unsigned long iterations) {
+		bench::header("Recording and replay of the byte stream, 1% of frames damaged");
+
+		PmsSimSerial sim;
+		sim.setInterval(0);
+		sim.setData(sampleData());
+		std::vector<uint8_t> capture;
+		capture.reserve(iterations * (PmsData::FRAME_SIZE + 8));
+		MemorySink sink(capture);
+		unsigned long recorded = 0;
+		{
+			PmsRecorderSerial<MemorySink, PmsSimSerial, 4096> recorder(sim, sink);
+			BasicPms<Pms5003, PmsRecorderSerial<MemorySink, PmsSimSerial, 4096>> pms(&recorder);
+			pms.begin();
+			PmsData data;
+			bench::Stopwatch stopwatch;
+			for (unsigned long i = 0; i < iterations; ++i) {
+				switch (i % 400) {
+				case 100: sim.injectGarbage(7); break;
+				case 200: sim.injectTruncatedFrame(13); break;
+				case 300: sim.injectBadChecksum(); break;
+				case 399: sim.injectBadLength(); break;
+				default: break;
+				}
+				sim.emitFrame();
+				for (PmsStatus status = pms.read(data); status != PmsStatus::NO_DATA; status = pms.read(data)) {
+					recorded += status == PmsStatus::OK;
+				}
+			}
+			bench::rate("Pms::read via PmsRecorderSerial", static_cast<double>(recorded), stopwatch.seconds());
+		}
+		bench::value("capture overhead", 100.0 * capture.size() / (static_cast<double>(iterations) * PmsData::FRAME_SIZE) - 100.0, "%");
+
+		PmsReplaySerial replay(capture.data(), capture.size(), 0);
+		BasicPms<Pms5003, PmsReplaySerial> pms(&replay);
+		pms.begin();
+		PmsData data;
+		unsigned long replayed = 0;
+		bench::Stopwatch stopwatch;
+		while (!replay.isFinished()) {
+			replayed += pms.read(data) == PmsStatus::OK;
+		}
+		const double seconds = stopwatch.seconds();
+		bench::rate("PmsReplaySerial, speed 0", static_cast<double>(replayed), seconds);
+		bench::value("PmsReplaySerial, speed 0 (MB/s)", replay.getReceived() / seconds / 1e6, "MB/s");
+		bench::value("recorded days at 1 frame/s per second", replayed / seconds / 86400.0, "days/s");
+	}
+}
+
+int main(int argc, char* argv[]) {
+	const char* section = argc > 1 ? argv[1] : "all";
+	const unsigned long iterations = argc > 2 ? strtoul(argv[2], nullptr, 10) : 200000UL;
+	const bool all = strcmp(section, "all") == 0;
+
+	printf("%s, %lu iterations\n", pmsxApiVersion, iterations);
+	if (all || strcmp(section, "read") == 0) {
+		benchRead(iterations);
+	}
+	if (all || strcmp(section, "dispatch") == 0) {
+		benchDispatch(iterations);
+	}
+	if (all || strcmp(section, "parser") == 0) {
+		benchParser(iterations);
+	}
+	if (all || strcmp(section, "capture") == 0) {
+		benchCapture(iterations);
+	}
+	if (all || strcmp(section, "resync") == 0) {
+		benchResync(iterations);
+	}
+	if (all || strcmp(section, "status") == 0) {
+		benchStatus(iterations);
+	}
+	if (all || strcmp(section, "statistics") == 0) {
+		benchStatistics(iterations);
+	}
+	if (all || strcmp(section, "cleanliness") == 0) {
+		benchCleanliness(iterations);
+	}
+	if (all || strcmp(section, "history") == 0) {
+		benchHistory(iterations);
+	}
+	if (all || strcmp(section, "rollup") == 0) {
+		benchRollup(iterations);
+	}
+	if (all || strcmp(section, "latest") == 0) {
+		benchLatest(iterations);
+	}
+	if (all || strcmp(section, "replay") == 0) {
+		benchReplay(iterations);
+	}
+	return EXIT_SUCCESS;
+}
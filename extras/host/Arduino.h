@@ -0,0 +1,145 @@
+#pragma once
+
+// Minimal replacement of the Arduino core for POSIX hosts (Linux gateways, unit benches)
+//
+// Provides just enough of <Arduino.h> to compile pms5003 library:
+//   millis(), micros(), delay(), delayMicroseconds()
+//   pinMode(), digitalWrite(), digitalRead() - there are no GPIO on a host, see setHostPinHandler()
+//   min(), max(), Serial (stdout)
+//
+// Include directory extras/host is used by CMakeLists.txt only, it is never visible to Arduino IDE
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+////////////////////////////////////////
+
+template <typename T, typename U>
+inline auto min(const T& a, const U& b) -> decltype(a < b ? a : b) {
+	return (a < b) ? a : b;
+}
+
+template <typename T, typename U>
+inline auto max(const T& a, const U& b) -> decltype(a < b ? b : a) {
+	return (a < b) ? b : a;
+}
+
+////////////////////////////////////////
+
+// Time: CLOCK_MONOTONIC, counted from the first call
+
+inline uint64_t hostMonotonicMicros() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000U + static_cast<uint64_t>(ts.tv_nsec) / 1000U;
+}
+
+inline uint64_t hostEpochMicros() {
+	static const uint64_t epoch = hostMonotonicMicros();
+	return epoch;
+}
+
+inline uint64_t hostElapsedMicros() {
+	const auto epoch = hostEpochMicros();
+	return hostMonotonicMicros() - epoch;
+}
+
+inline unsigned long micros() {
+	return static_cast<unsigned long>(hostElapsedMicros());
+}
+
+inline unsigned long millis() {
+	return static_cast<unsigned long>(hostElapsedMicros() / 1000U);
+}
+
+inline void delayMicroseconds(unsigned int us) {
+	timespec ts{ static_cast<time_t>(us / 1000000U), static_cast<long>(us % 1000000U) * 1000L };
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+inline void delay(unsigned long ms) {
+	timespec ts{ static_cast<time_t>(ms / 1000U), static_cast<long>(ms % 1000U) * 1000000L };
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+////////////////////////////////////////
+
+// GPIO: pin state is only remembered
+// Gateways driving SET/RESET lines (sysfs, libgpiod, USB adapter DTR/RTS) should install a handler
+
+typedef void (*hostPinHandler_t)(uint8_t pin, uint8_t mode, uint8_t value);
+
+inline hostPinHandler_t& hostPinHandler() {
+	static hostPinHandler_t handler = nullptr;
+	return handler;
+}
+
+inline uint8_t* hostPinState() {
+	static uint8_t state[UINT8_MAX + 1]{};
+	return state;
+}
+
+inline void setHostPinHandler(hostPinHandler_t handler) {
+	hostPinHandler() = handler;
+}
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+	if (hostPinHandler()) {
+		hostPinHandler()(pin, mode, hostPinState()[pin]);
+	}
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t value) {
+	hostPinState()[pin] = value;
+	if (hostPinHandler()) {
+		hostPinHandler()(pin, OUTPUT, value);
+	}
+}
+
+inline int digitalRead(uint8_t pin) {
+	return hostPinState()[pin];
+}
+
+////////////////////////////////////////
+
+// Serial: console output only
+
+class HostConsole {
+public:
+	void begin(unsigned long) {}
+
+	explicit operator bool() const {
+		return true;
+	}
+
+	size_t print(const char* value) { return printf("%s", value); }
+	size_t print(char value) { return printf("%c", value); }
+	size_t print(int value) { return printf("%d", value); }
+	size_t print(unsigned int value) { return printf("%u", value); }
+	size_t print(long value) { return printf("%ld", value); }
+	size_t print(unsigned long value) { return printf("%lu", value); }
+	size_t print(unsigned char value) { return printf("%u", value); }
+	size_t print(double value, int digits = 2) { return printf("%.*f", digits, value); }
+
+	size_t println() { return printf("\n"); }
+
+	template <typename T>
+	size_t println(const T& value) {
+		const auto result = print(value);
+		return result + println();
+	}
+};
+
+static HostConsole Serial __attribute__((unused));
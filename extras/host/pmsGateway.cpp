@@ -0,0 +1,61 @@
+// Many sensors, single thread: PmsGroup (epoll) example
+//
+// Usage: pmsGateway [-p period] <device> [<device> ...]
+//   pmsGateway /dev/ttyUSB0 /dev/ttyUSB1              - active mode
+//   pmsGateway -p 1000 /dev/ttyUSB0 /dev/ttyUSB1      - passive mode, CMD_READ_DATA every 1000 ms
+
+#include <pms.h>
+#include <pmsGroup.h>
+
+#include <stdlib.h>
+
+namespace {
+	constexpr size_t maxSensors = 64;
+
+	PmsPosixSerial* serials[maxSensors];
+	pmsx::Pms pmses[maxSensors];
+}
+
+int main(int argc, char* argv[]) {
+	unsigned long period = 0;
+	int first = 1;
+	if (argc > 2 && strcmp(argv[1], "-p") == 0) {
+		period = strtoul(argv[2], nullptr, 10);
+		first = 3;
+	}
+	if (first >= argc) {
+		fprintf(stderr, "Usage: %s [-p period] <device> [<device> ...]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	pmsx::PmsGroup<maxSensors> group;
+	if (!group.initialized()) {
+		fprintf(stderr, "epoll: initialization failed\n");
+		return EXIT_FAILURE;
+	}
+
+	for (int arg = first; arg < argc && static_cast<size_t>(arg - first) < maxSensors; ++arg) {
+		const auto i = static_cast<size_t>(arg - first);
+		serials[i] = new PmsPosixSerial(argv[arg]);
+		pmses[i].addSerial(serials[i]);
+		if (!pmses[i].begin() || group.add(pmses[i], *serials[i], period) < 0) {
+			fprintf(stderr, "PMS sensor: can not open %s\n", argv[arg]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (;;) {
+		group.poll(-1, [&](size_t sensor, pmsx::PmsStatus status, const pmsx::PmsData& data) {
+			if (status != pmsx::PmsStatus::OK) {
+				printf("%lu\t%s\t%s\n", millis(), argv[first + sensor], status.getErrorMsg());
+				return;
+			}
+			printf("%lu\t%s", millis(), argv[first + sensor]);
+			for (pmsx::PmsData::pmsIdx_t i = 0; i < data.raw.getSize(); ++i) {
+				printf("\t%u", data.raw.getValue(i));
+			}
+			printf("\n");
+			fflush(stdout);
+		});
+	}
+}
@@ -0,0 +1,116 @@
+// Host counterpart of Examples/p01basic: reads PMS5003 connected to a tty (or pty)
+//
+// Usage: pmsMonitor [-r capture] <device> [passive]
+//   pmsMonitor /dev/ttyUSB0
+//   pmsMonitor /dev/ttyUSB0 passive
+//   pmsMonitor -r site.pmsr /dev/ttyUSB0 - the byte stream is recorded as well, replay it with pmsReplay
+//
+// pty pair as a stand-in for a real sensor:
+//   socat -d -d pty,raw,echo=0 pty,raw,echo=0
+//   pmsMonitor /dev/pts/N, write frames to the other end
+
+#include <pms.h>
+#include <pmsSerialRecorder.h>
+
+#include <signal.h>
+#include <stdlib.h>
+
+namespace {
+	volatile sig_atomic_t stopped = 0;
+
+	void stop(int) {
+		stopped = 1;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	const char* capturePath = nullptr;
+	if (argc > 2 && strcmp(argv[1], "-r") == 0) {
+		capturePath = argv[2];
+		argc -= 2;
+		argv += 2;
+	}
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s [-r capture] <device> [passive]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	const bool passive = argc > 2 && strcmp(argv[2], "passive") == 0;
+
+	PmsPosixSerial pmsSerial(argv[1]);
+	FILE* captureFile = capturePath != nullptr ? fopen(capturePath, "wb") : nullptr;
+	if (capturePath != nullptr && captureFile == nullptr) {
+		fprintf(stderr, "%s: can not create\n", capturePath);
+		return EXIT_FAILURE;
+	}
+	pmsx::PmsHistoryFile captureSink(captureFile);
+	PmsRecorderSerial<pmsx::PmsHistoryFile, PmsPosixSerial, 4096> recorder(pmsSerial, captureSink);
+	pmsx::Pms pms(captureFile != nullptr ? static_cast<IPmsSerial*>(&recorder) : &pmsSerial);
+
+	// The capture is complete after Ctrl+C
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+
+	Serial.println(pmsx::pmsxApiVersion);
+	if (!pms.begin()) {
+		fprintf(stderr, "PMS sensor: can not open %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	pms.write(passive ? pmsx::PmsCmd::CMD_MODE_PASSIVE : pmsx::PmsCmd::CMD_MODE_ACTIVE);
+
+	auto lastRead = millis();
+	while (!stopped) {
+		if (passive) {
+			pms.write(pmsx::PmsCmd::CMD_READ_DATA);
+		}
+		if (!pms.waitForData(passive ? pms.getPassiveTimeout() : pmsx::Pms::WAKEUP_TIME, pmsx::PmsData::FRAME_SIZE)) {
+			continue;
+		}
+
+		pmsx::PmsData data;
+		auto status = pms.read(data);
+
+		switch (status) {
+		case pmsx::PmsStatus::OK: {
+			Serial.println("_________________");
+			const auto newRead = pms.getFrameTimestamp(); // arrival of the frame, not the time of read()
+			Serial.print("Wait time ");
+			Serial.println(newRead - lastRead);
+			lastRead = newRead;
+			if (passive) {
+				Serial.print("Read latency ");
+				Serial.print(pms.getReadLatency());
+				Serial.print(", timeout ");
+				Serial.println(pms.getPassiveTimeout());
+			}
+
+			auto view = data.raw;
+			for (pmsx::PmsData::pmsIdx_t i = 0; i < view.getSize(); ++i) {
+				Serial.print(view.getValue(i));
+				Serial.print("\t");
+				Serial.print(view.getName(i));
+				Serial.print(" [");
+				Serial.print(view.getMetric(i));
+				Serial.println("]");
+			}
+			fflush(stdout);
+			break;
+		}
+		case pmsx::PmsStatus::NO_DATA:
+			break;
+		default:
+			Serial.print("!!! Pms error: ");
+			Serial.println(status.getErrorMsg());
+		}
+
+		if (passive) {
+			delay(1000);
+		}
+	}
+
+	recorder.flush();
+	if (captureFile != nullptr) {
+		fclose(captureFile);
+	}
+	return EXIT_SUCCESS;
+}
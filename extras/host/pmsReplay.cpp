@@ -0,0 +1,63 @@
+// Replays a capture recorded by PmsRecorderSerial (pmsMonitor -r) through Pms: the real available() / read() / parser code
+//
+// Usage: pmsReplay <capture> [speed]
+//   pmsReplay site.pmsr        - as fast as possible, summary only
+//   pmsReplay site.pmsr 1      - real time, every frame is printed (recorded millis(), values)
+//   pmsReplay site.pmsr 60     - 60 times faster
+
+#include <pms.h>
+#include <pmsCapture.h>
+#include <pmsSerialRecorder.h>
+
+#include <stdlib.h>
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <capture> [speed]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	const unsigned int speed = argc > 2 ? static_cast<unsigned int>(strtoul(argv[2], nullptr, 10)) : 0;
+
+	pmsx::PmsCaptureFile capture;
+	if (!capture.open(argv[1])) {
+		fprintf(stderr, "%s: can not open\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+	PmsReplaySerial replay(capture.getData(), capture.getSize(), speed);
+	pmsx::Pms pms(&replay);
+	if (!pms.begin()) {
+		fprintf(stderr, "%s: not a capture\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	unsigned long outcomes[pmsx::PmsStatus::NO_SERIAL + 1]{};
+	const auto t0 = micros();
+	while (!replay.isFinished()) {
+		if (speed > 0 && !pms.waitForData(pmsx::Pms::WAKEUP_TIME, pmsx::PmsData::FRAME_SIZE)) {
+			continue;
+		}
+		pmsx::PmsData data;
+		const auto status = pms.read(data);
+		++outcomes[min(static_cast<uint8_t>(status), static_cast<uint8_t>(pmsx::PmsStatus::NO_SERIAL))];
+		if (speed > 0 && status == pmsx::PmsStatus::OK) {
+			printf("%lu", static_cast<unsigned long>(replay.getTimestamp()));
+			for (pmsx::PmsData::pmsIdx_t i = 0; i < data.raw.getSize(); ++i) {
+				printf("\t%u", data.raw.getValue(i));
+			}
+			printf("\n");
+			fflush(stdout);
+		}
+	}
+	const double seconds = (micros() - t0) * 1e-6;
+
+	printf("replayed %lu bytes (%lu sent, %lu discarded) in %.3f s, %.1f MB/s%s\n", replay.getReceived(), replay.getSent(), replay.getDiscarded(),
+		seconds, seconds > 0 ? replay.getReceived() / seconds * 1e-6 : 0.0, replay.isTruncated() ? ", capture is truncated" : "");
+	printf("skipped %lu bytes\n", pms.getSkipped());
+	for (uint8_t status = pmsx::PmsStatus::OK; status <= pmsx::PmsStatus::NO_SERIAL; ++status) {
+		if (status != pmsx::PmsStatus::NO_DATA) {
+			pmsx::PmsStatus value{ status };
+			printf("%-30s %lu\n", value.getErrorMsg(), outcomes[status]);
+		}
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,164 @@
+// Air quality indexes: NowCast, US EPA AQI and EU CAQI against values computed by hand
+//
+//   NowCast: weight of a steady series is 1, a large range clamps the weight at 1/2, 2 of the 3 most recent hours are required
+//   AQI: both edges of every breakpoint of PM2.5 (0.1 micro g/m3) and PM10 (truncated to 1 micro g/m3), extrapolation above 500
+//   CAQI: every category edge of PM2.5 and PM10, very high above 100
+//
+// Concentrations are in 0.1 micro g/m3: an hour of 10 frames averages to any of them
+
+#include <pmsAirQuality.h>
+#include "test.h"
+
+#include <math.h>
+
+using namespace pmsx;
+
+namespace {
+
+	// 10 frames of an hour: average (0.1 micro g/m3) pm25, pm10
+	void feedHour(PmsAirQuality& airQuality, const unsigned long hour, const uint16_t pm25, const uint16_t pm10) {
+		for (uint16_t i = 0; i < 10; ++i) {
+			PmsData data{};
+			data.raw[4] = static_cast<pmsData_t>(pm25 / 10 + (i < pm25 % 10 ? 1 : 0));
+			data.raw[5] = static_cast<pmsData_t>(pm10 / 10 + (i < pm10 % 10 ? 1 : 0));
+			airQuality.update(data, hour * PmsAirQuality::HOUR + i * 1000UL);
+		}
+	}
+
+	// Three steady hours: NowCast and the hourly average are equal to the concentrations
+	void steady(PmsAirQuality& airQuality, const uint16_t pm25, const uint16_t pm10) {
+		airQuality.reset();
+		for (unsigned long hour = 0; hour < 3; ++hour) {
+			feedHour(airQuality, hour, pm25, pm10);
+		}
+		airQuality.advance(3 * PmsAirQuality::HOUR);
+	}
+
+	struct Edge {
+		uint16_t concentration; // 0.1 micro g/m3
+		uint16_t index;
+		uint8_t category;
+	};
+
+	void testNowCast() {
+		PmsAirQuality airQuality;
+		steady(airQuality, 123, 456);
+		TEST_CHECK(airQuality.getNowCast(PmsPollutant::PM25) == 123);
+		TEST_CHECK(airQuality.getNowCast(PmsPollutant::PM10) == 456);
+		TEST_CHECK(airQuality.getHourly(PmsPollutant::PM25) == 123);
+
+		// Weight 0.8 (newest first: 100.0, 80.0, 80.0): within the truncation of 0.1
+		airQuality.reset();
+		feedHour(airQuality, 0, 800, 0);
+		feedHour(airQuality, 1, 800, 0);
+		feedHour(airQuality, 2, 1000, 0);
+		airQuality.advance(3 * PmsAirQuality::HOUR);
+		const double expected = (1000.0 + 0.8 * 800 + 0.64 * 800) / (1 + 0.8 + 0.64);
+		const auto nowCast = airQuality.getNowCast(PmsPollutant::PM25);
+		if (!TEST_CHECK(fabs(nowCast - expected) <= 1.0)) {
+			printf("  NowCast %u, expected %.2f\n", nowCast, expected);
+		}
+
+		// min / max = 0.1: the weight is clamped at 0.5, (1000 + 0.5 * 100 + 0.25 * 100) / 1.75
+		airQuality.reset();
+		feedHour(airQuality, 0, 100, 0);
+		feedHour(airQuality, 1, 100, 0);
+		feedHour(airQuality, 2, 1000, 0);
+		airQuality.advance(3 * PmsAirQuality::HOUR);
+		TEST_CHECK(airQuality.getNowCast(PmsPollutant::PM25) == 614);
+	}
+
+	void testMissingHours() {
+		PmsAirQuality airQuality;
+		TEST_CHECK(!airQuality.getAqi().isValid());
+		TEST_CHECK(!airQuality.getCaqi().isValid());
+
+		// One hour: CAQI, no NowCast
+		feedHour(airQuality, 0, 100, 200);
+		airQuality.advance(PmsAirQuality::HOUR);
+		TEST_CHECK(airQuality.getNowCast(PmsPollutant::PM25) == PmsAirQuality::MISSING);
+		TEST_CHECK(!airQuality.getAqi().isValid());
+		TEST_CHECK(airQuality.getCaqi().isValid());
+
+		// Hour 1 is missing: 2 of the 3 most recent hours (0, 2)
+		feedHour(airQuality, 2, 100, 200);
+		airQuality.advance(3 * PmsAirQuality::HOUR);
+		TEST_CHECK(airQuality.getNowCast(PmsPollutant::PM25) == 100);
+		TEST_CHECK(airQuality.getAqi().isValid());
+
+		// Hours 3, 4 are missing: 1 of 3 (2)
+		airQuality.advance(5 * PmsAirQuality::HOUR);
+		TEST_CHECK(airQuality.getNowCast(PmsPollutant::PM25) == PmsAirQuality::MISSING);
+		TEST_CHECK(airQuality.getNowCast(PmsPollutant::PM10) == PmsAirQuality::MISSING);
+		TEST_CHECK(!airQuality.getAqi().isValid());
+		TEST_CHECK(airQuality.getHourly(PmsPollutant::PM25) == PmsAirQuality::MISSING);
+		TEST_CHECK(!airQuality.getCaqi().isValid());
+
+		// Older hours still count in the NowCast once 2 recent hours are back
+		feedHour(airQuality, 5, 100, 200);
+		feedHour(airQuality, 6, 100, 200);
+		airQuality.advance(7 * PmsAirQuality::HOUR);
+		TEST_CHECK(airQuality.getNowCast(PmsPollutant::PM25) == 100);
+	}
+
+	// pm25: the other pollutant is 0, its sub-index does not dominate
+	template <typename Index>
+	void checkEdges(const char* name, const bool pm25, const Edge* edges, const size_t count, Index index) {
+		PmsAirQuality airQuality;
+		for (size_t i = 0; i < count; ++i) {
+			const auto& edge = edges[i];
+			steady(airQuality, pm25 ? edge.concentration : 0, pm25 ? 0 : edge.concentration);
+			const auto result = index(airQuality);
+			const bool ok = TEST_CHECK(result.isValid()) && TEST_CHECK(result.index == edge.index) && TEST_CHECK(static_cast<uint8_t>(result.category) == edge.category)
+				&& TEST_CHECK(edge.index == 0 || result.dominant == (pm25 ? PmsPollutant::PM25 : PmsPollutant::PM10));
+			if (!ok) {
+				printf("  %s, %u.%u micro g/m3: index %u, category %u\n", name, edge.concentration / 10, edge.concentration % 10, result.index,
+					static_cast<unsigned>(result.category));
+			}
+		}
+	}
+
+	void testAqi() {
+		const Edge pm25[]{
+			{ 0, 0, 0 }, { 90, 50, 0 }, { 91, 51, 1 }, { 354, 100, 1 }, { 355, 101, 2 }, { 554, 150, 2 }, { 555, 151, 3 },
+			{ 1254, 200, 3 }, { 1255, 201, 4 }, { 2254, 300, 4 }, { 2255, 301, 5 }, { 3254, 500, 5 },
+			{ 5000, 848, 5 } // above the table: extrapolated, hazardous
+		};
+		// Truncated to 1 micro g/m3: 54.9 is 54; above 604: extrapolated
+		const Edge pm10[]{
+			{ 0, 0, 0 }, { 549, 50, 0 }, { 550, 51, 1 }, { 1549, 100, 1 }, { 1550, 101, 2 }, { 2549, 150, 2 }, { 2550, 151, 3 },
+			{ 3549, 200, 3 }, { 3550, 201, 4 }, { 4249, 300, 4 }, { 4250, 301, 5 }, { 6049, 500, 5 }, { 6050, 501, 5 }, { 7000, 607, 5 }
+		};
+		const auto aqi = [](const PmsAirQuality& airQuality) {
+			return airQuality.getAqi();
+		};
+		checkEdges("AQI PM2.5", true, pm25, _countof(pm25), aqi);
+		checkEdges("AQI PM10", false, pm10, _countof(pm10), aqi);
+		TEST_CHECK(strcmp(PmsAirQuality::getCategoryName(PmsAqiCategory::AQI_HAZARDOUS), "Hazardous") == 0);
+	}
+
+	void testCaqi() {
+		const Edge pm25[]{
+			{ 0, 0, 0 }, { 150, 25, 0 }, { 151, 25, 1 }, { 300, 50, 1 }, { 301, 50, 2 }, { 550, 75, 2 }, { 551, 75, 3 },
+			{ 1100, 100, 3 }, { 1101, 100, 4 }, { 1200, 105, 4 }
+		};
+		const Edge pm10[]{
+			{ 0, 0, 0 }, { 250, 25, 0 }, { 251, 25, 1 }, { 500, 50, 1 }, { 501, 50, 2 }, { 900, 75, 2 }, { 901, 75, 3 },
+			{ 1800, 100, 3 }, { 1801, 100, 4 }, { 2700, 125, 4 }
+		};
+		const auto caqi = [](const PmsAirQuality& airQuality) {
+			return airQuality.getCaqi();
+		};
+		checkEdges("CAQI PM2.5", true, pm25, _countof(pm25), caqi);
+		checkEdges("CAQI PM10", false, pm10, _countof(pm10), caqi);
+		TEST_CHECK(strcmp(PmsAirQuality::getCategoryName(PmsCaqiCategory::CAQI_VERY_HIGH), "Very high") == 0);
+	}
+}
+
+int main() {
+	testNowCast();
+	testMissingHours();
+	testAqi();
+	testCaqi();
+	return test::finish("pmsTestAirQuality");
+}
@@ -0,0 +1,197 @@
+// Capture decoder: checksum kernels, chunked decoding and counters against PmsParser
+//
+//   checksum: the scalar kernel and the SSE2 kernel (where compiled) agree on random frames of every frame size
+//   a simulated capture with every kind of fault: the same frames and counters as PmsParser, decoded in one call
+//   the same capture passed in chunks of 1 .. 2 * FRAME_SIZE + 1 bytes, and with small columns (full columns, clear()): the same rows and offsets
+
+#include <pms.h>
+#include <pmsCapture.h>
+#include <pmsSerialSimulator.h>
+#include "test.h"
+
+#include <vector>
+
+using namespace pmsx;
+
+namespace {
+
+	typedef std::vector<uint8_t> bytes_t;
+
+	uint32_t nextRandom(uint32_t& seed) {
+		seed = seed * 1103515245UL + 12345UL;
+		return seed >> 8;
+	}
+
+	template <typename Model>
+	void testKernels(const char* name) {
+		typedef BasicPmsCaptureDecoder<Model> decoder_t;
+		uint8_t frame[decoder_t::FRAME_SIZE];
+		uint32_t seed = 7;
+		unsigned long mismatches = 0;
+		for (unsigned round = 0; round < 10000; ++round) {
+			for (auto& value : frame) {
+				// Saturated frames every tenth round: the largest sums
+				value = round % 10 == 0 ? 0xff : static_cast<uint8_t>(nextRandom(seed));
+			}
+			uint16_t expected = 0;
+			for (size_t i = 0; i < decoder_t::SUM_SIZE; ++i) {
+				expected = static_cast<uint16_t>(expected + frame[i]);
+			}
+			mismatches += decoder_t::sumScalar(frame) != expected;
+#if defined __SSE2__
+			mismatches += decoder_t::sumVector(frame) != expected;
+#endif
+		}
+		if (!TEST_CHECK(mismatches == 0)) {
+			printf("  %s: %lu checksum mismatches\n", name, mismatches);
+		}
+	}
+
+	struct Decoded {
+		std::vector<PmsData> rows;
+		std::vector<uint64_t> offsets;
+		PmsCaptureCounters counters;
+	};
+
+	// Decodes capture passed in chunks of chunk bytes (0: at once), columns of capacity rows
+	Decoded decode(const bytes_t& capture, const size_t chunk, const size_t capacity) {
+		std::vector<pmsData_t> values(PmsData::DATA_SIZE * capacity);
+		pmsData_t* columns[PmsData::DATA_SIZE];
+		for (pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+			columns[i] = values.data() + i * capacity;
+		}
+		std::vector<uint64_t> offsets(capacity);
+		PmsCaptureDecoder decoder(columns, offsets.data(), capacity);
+
+		Decoded result;
+		const auto collect = [&]() {
+			for (size_t row = 0; row < decoder.getFrames(); ++row) {
+				PmsData data;
+				for (pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+					data.raw[i] = columns[i][row];
+				}
+				result.rows.push_back(data);
+				result.offsets.push_back(offsets[row]);
+			}
+			decoder.clear();
+		};
+
+		// Bytes not consumed by decode() are passed again, with the next chunk
+		bytes_t buffer;
+		uint64_t base = 0;
+		for (size_t i = 0; i < capture.size();) {
+			const size_t size = chunk == 0 ? capture.size() : min(chunk, capture.size() - i);
+			buffer.insert(buffer.end(), capture.begin() + i, capture.begin() + i + size);
+			i += size;
+			for (;;) {
+				const auto used = decoder.decode(buffer.data(), buffer.size(), base);
+				buffer.erase(buffer.begin(), buffer.begin() + used);
+				base += used;
+				const bool full = decoder.isFull();
+				collect();
+				if (!full) {
+					break;
+				}
+			}
+		}
+		decoder.finish();
+		result.counters = decoder.getCounters();
+		return result;
+	}
+
+	bool equal(const PmsCaptureCounters& a, const PmsCaptureCounters& b) {
+		return a.frames == b.frames && a.sumErrors == b.sumErrors && a.lengthMismatches == b.lengthMismatches && a.responses == b.responses && a.skipped == b.skipped;
+	}
+
+	bool equal(const Decoded& a, const Decoded& b) {
+		return a.rows.size() == b.rows.size() && (a.rows.empty() || memcmp(a.rows.data(), b.rows.data(), a.rows.size() * sizeof(PmsData)) == 0)
+			&& a.offsets == b.offsets && equal(a.counters, b.counters);
+	}
+
+	bytes_t simulate() {
+		const uint8_t response[]{ 0x42, 0x4D, 0x00, 0x04, 0xE1, 0x00, 0x01, 0x74 };
+		const uint8_t responseHeader[]{ 0x42, 0x4D, 0x00, 0x04 };
+		PmsSimSerial sim;
+		sim.setInterval(0);
+		bytes_t capture;
+		PmsData data{};
+		for (unsigned i = 0; i < 300; ++i) {
+			switch (i % 10) {
+			case 1: sim.injectGarbage(7); break;
+			case 2: sim.injectTruncatedFrame(13); break;
+			case 3: sim.injectBadChecksum(); break;
+			case 4: sim.injectBadLength(); break;
+			case 5: sim.injectBytes(response, sizeof response); break;
+			case 6: sim.injectBytes(responseHeader, sizeof responseHeader); break;
+			default: break;
+			}
+			for (pmsIdx_t j = 0; j < PmsData::DATA_SIZE; ++j) {
+				data.raw[j] = static_cast<pmsData_t>(i * 31 + j);
+			}
+			sim.setData(data);
+			sim.emitFrame();
+			const auto size = capture.size();
+			capture.resize(size + sim.available());
+			sim.read(capture.data() + size, capture.size() - size);
+		}
+		return capture;
+	}
+
+	void testDecode() {
+		const auto capture = simulate();
+
+		PmsParser parser;
+		std::vector<PmsData> frames;
+		PmsCaptureCounters expected{};
+		parser.feed(capture.data(), capture.size(), [&](const PmsStatus status, const PmsData& data) {
+			if (status == PmsStatus::OK) {
+				frames.push_back(data);
+				++expected.frames;
+			} else if (status == PmsStatus::SUM_ERROR) {
+				++expected.sumErrors;
+			} else if (status == PmsStatus::FRAME_LENGTH_MISMATCH) {
+				++expected.lengthMismatches;
+			}
+		});
+		expected.responses = parser.getResponseCount();
+		expected.skipped = parser.getSkipped();
+		TEST_CHECK(parser.isIdle());
+		TEST_CHECK(frames.size() == 300);
+		TEST_CHECK(expected.responses == 30);
+
+		const auto whole = decode(capture, 0, 1024);
+		TEST_CHECK(equal(whole.counters, expected));
+		TEST_CHECK(whole.rows.size() == frames.size() && memcmp(whole.rows.data(), frames.data(), frames.size() * sizeof(PmsData)) == 0);
+		bool located = whole.offsets.size() == frames.size();
+		for (size_t i = 0; located && i < whole.offsets.size(); ++i) {
+			PmsData data;
+			located = PmsParser::decode(capture.data() + whole.offsets[i], data) == PmsStatus::OK && memcmp(&data, &frames[i], sizeof data) == 0;
+		}
+		TEST_CHECK(located);
+
+		for (size_t chunk = 1; chunk <= 2 * PmsData::FRAME_SIZE + 1; ++chunk) {
+			if (!TEST_CHECK(equal(decode(capture, chunk, 1024), whole))) {
+				printf("  chunk %zu\n", chunk);
+			}
+		}
+		for (size_t capacity = 1; capacity <= 7; ++capacity) {
+			if (!TEST_CHECK(equal(decode(capture, 100, capacity), whole))) {
+				printf("  capacity %zu\n", capacity);
+			}
+		}
+
+		// Incomplete frame at the end: skipped by finish()
+		const bytes_t truncated(capture.begin(), capture.end() - 1);
+		const auto partial = decode(truncated, 0, 1024);
+		TEST_CHECK(partial.counters.frames == expected.frames - 1);
+		TEST_CHECK(partial.counters.skipped == expected.skipped + PmsData::FRAME_SIZE - 1);
+	}
+}
+
+int main() {
+	testKernels<Pms5003>("PMS5003");
+	testKernels<Pms5003T>("PMS5003T");
+	testKernels<Pms3003>("PMS3003");
+	testDecode();
+	return test::finish("pmsTestCapture");
+}
@@ -0,0 +1,66 @@
+// ISO 14644-1 levels: fixed point (getLevelFixed(), getLevels(), getCleanlinessLevels()) against float getLevel()
+//
+// Every value of every cleanliness channel of every model with particle counts.
+// Tolerance: PmsIsoLevel promises an error below 0.001 level, that is 1 in LEVEL_SCALE units (rounding included).
+// Batch functions are the same arithmetic: their results equal getLevelFixed() exactly.
+
+#include <pms.h>
+#include "test.h"
+
+#include <math.h>
+#include <vector>
+
+using namespace pmsx;
+
+namespace {
+
+	constexpr double TOLERANCE = 1.0; // LEVEL_SCALE units
+
+	template <typename Model>
+	void testModel(const char* name) {
+		typedef BasicPmsData<Model> data_t;
+		typedef typename data_t::Cleanliness Cleanliness;
+		constexpr pmsIdx_t size = Cleanliness::SIZE;
+
+		// A frame per value, all channels equal: the batch is checked on the same frames
+		std::vector<data_t> frames(0x10000);
+		for (uint32_t value = 0; value <= 0xffffU; ++value) {
+			for (pmsIdx_t i = 0; i < size; ++i) {
+				frames[value].particles[i] = static_cast<pmsData_t>(value);
+			}
+		}
+		std::vector<uint16_t> batch(frames.size() * size);
+		getCleanlinessLevels(frames.data(), frames.size(), batch.data());
+
+		for (pmsIdx_t i = 0; i < size; ++i) {
+			double maxError = 0.0;
+			uint32_t worst = 0;
+			unsigned long mismatches = 0;
+			for (uint32_t value = 0; value <= 0xffffU; ++value) {
+				const auto& particles = frames[value].particles;
+				const uint16_t fixed = particles.getLevelFixed(i);
+				const double error = fabs(fixed - static_cast<double>(particles.getLevel(i)) * Cleanliness::LEVEL_SCALE);
+				if (error > maxError) {
+					maxError = error;
+					worst = value;
+				}
+				uint16_t levels[size];
+				particles.getLevels(levels);
+				mismatches += levels[i] != fixed || batch[value * size + i] != fixed;
+			}
+			if (!TEST_CHECK(maxError <= TOLERANCE) || !TEST_CHECK(mismatches == 0)) {
+				printf("  %s, channel %u (%s): max error %.3f / %u at %u, batch mismatches %lu\n",
+					name, i, Cleanliness::getName(i), maxError, Cleanliness::LEVEL_SCALE, worst, mismatches);
+			}
+		}
+		// Zero particles: level 0 by definition
+		TEST_CHECK(frames[0].particles.getLevelFixed(0) == 0);
+	}
+}
+
+int main() {
+	testModel<Pms5003>("PMS5003");
+	testModel<Pms5003T>("PMS5003T");
+	testModel<Pms5003ST>("PMS5003ST");
+	return test::finish("pmsTestCleanliness");
+}
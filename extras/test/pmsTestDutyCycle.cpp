@@ -0,0 +1,179 @@
+// Duty cycle against the simulator: readings of every cycle, the sensor sleeps between them
+//
+//   active mode: frames are averaged, no command fails
+//   passive mode (the simulator sends no frame without CMD_READ_DATA): passive mode is restored after wakeup, frames are requested
+//   full command queue at the start of a cycle: CMD_WAKEUP is queued later, not assumed
+//   commands that can not be written: repeated, given up, counted; cycling goes on when the port works again
+//   warm-up: only valid frames are counted as discarded, checksum and length errors are not
+
+#include <pms.h>
+#include <pmsDutyCycle.h>
+#include <pmsSerialSimulator.h>
+#include "test.h"
+
+using namespace pmsx;
+
+namespace {
+
+	struct Readings {
+		unsigned long count;
+		unsigned long awake; // ms with the simulator awake (approximately)
+		pmsData_t last;
+	};
+
+	// Runs the duty cycle for duration ms
+	Readings run(PmsDutyCycle& dutyCycle, PmsSimSerial& sim, const unsigned long duration) {
+		Readings readings{ 0, 0, 0 };
+		const auto t0 = millis();
+		auto previous = t0;
+		while (millis() - t0 < duration) {
+			const auto now = millis();
+			if (!sim.isModeSleep()) {
+				readings.awake += now - previous;
+			}
+			previous = now;
+			PmsData data;
+			if (dutyCycle.tick(data)) {
+				++readings.count;
+				readings.last = data.raw.getValue(4);
+			}
+			delay(1);
+		}
+		return readings;
+	}
+
+	PmsData sampleData() {
+		PmsData data{};
+		for (pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+			data.raw[i] = static_cast<pmsData_t>(100 + i);
+		}
+		return data;
+	}
+
+	void testActive() {
+		PmsSimSerial sim;
+		sim.setInterval(50);
+		sim.setWarmup(100);
+		sim.setData(sampleData());
+		Pms pms(&sim);
+		TEST_CHECK(pms.begin());
+		PmsDutyCycle dutyCycle(pms, 600, 200, 3);
+		dutyCycle.begin();
+
+		const auto readings = run(dutyCycle, sim, 1700);
+		TEST_CHECK(readings.count == 3);
+		TEST_CHECK(readings.last == 104);
+		if (!TEST_CHECK(readings.awake < 1200)) {
+			printf("  awake %lu ms of 1700\n", readings.awake);
+		}
+		TEST_CHECK(dutyCycle.getCollected() == 3);
+		TEST_CHECK(dutyCycle.getMissed() == 0);
+		TEST_CHECK(dutyCycle.getFailed() == 0);
+		dutyCycle.end();
+		run(dutyCycle, sim, 50);
+		TEST_CHECK(sim.isModeSleep());
+	}
+
+	void testPassive() {
+		PmsSimSerial sim;
+		sim.setInterval(0); // no frame without CMD_READ_DATA
+		sim.setWarmup(100);
+		sim.setData(sampleData());
+		Pms pms(&sim);
+		TEST_CHECK(pms.begin());
+		TEST_CHECK(pms.write(PmsCmd::CMD_MODE_PASSIVE));
+		PmsDutyCycle dutyCycle(pms, 600, 200, 3);
+		dutyCycle.begin();
+
+		const auto readings = run(dutyCycle, sim, 1700);
+		TEST_CHECK(readings.count == 3);
+		TEST_CHECK(readings.last == 104);
+		TEST_CHECK(dutyCycle.getCollected() == 3);
+		TEST_CHECK(dutyCycle.getMissed() == 0);
+		TEST_CHECK(dutyCycle.getFailed() == 0);
+		TEST_CHECK(pms.isModeActive() == false);
+	}
+
+	void testQueueFull() {
+		PmsSimSerial sim;
+		sim.setInterval(50);
+		sim.setWarmup(100);
+		sim.setData(sampleData());
+		Pms pms(&sim);
+		TEST_CHECK(pms.begin());
+		TEST_CHECK(pms.write(PmsCmd::CMD_SLEEP));
+		for (uint8_t i = 0; i < Pms::CMD_QUEUE_SIZE; ++i) {
+			pms.writeAsync(PmsCmd::CMD_READ_DATA);
+		}
+		PmsDutyCycle dutyCycle(pms, 600, 200, 3);
+		dutyCycle.begin();
+
+		const auto readings = run(dutyCycle, sim, 500);
+		TEST_CHECK(readings.count == 1);
+		TEST_CHECK(dutyCycle.getMissed() == 0);
+		TEST_CHECK(dutyCycle.getFailed() == 0);
+	}
+
+	void testFailed() {
+		PmsSimSerial sim;
+		sim.setInterval(50);
+		sim.setWarmup(100);
+		sim.setData(sampleData());
+		Pms pms(&sim);
+		TEST_CHECK(pms.begin());
+		sim.end(); // writes fail
+		PmsDutyCycle dutyCycle(pms, 300, 200, 3);
+		dutyCycle.begin();
+
+		auto readings = run(dutyCycle, sim, 100);
+		TEST_CHECK(readings.count == 0);
+		TEST_CHECK(dutyCycle.getMissed() == 1);
+		TEST_CHECK(dutyCycle.getFailed() == 2 * PmsDutyCycle::CMD_ATTEMPTS); // CMD_WAKEUP, CMD_SLEEP
+		TEST_CHECK(dutyCycle.getState() == PmsDutyState::SLEEPING);
+
+		sim.begin(0);
+		readings = run(dutyCycle, sim, 600);
+		TEST_CHECK(readings.count == 1);
+		TEST_CHECK(dutyCycle.getMissed() == 1);
+		TEST_CHECK(dutyCycle.getFailed() == 2 * PmsDutyCycle::CMD_ATTEMPTS);
+	}
+
+	// The simulator sends frames only on demand: 2 valid frames and 2 broken ones during warm-up
+	void testDiscarded() {
+		PmsSimSerial sim;
+		sim.setInterval(0);
+		sim.setWarmup(0);
+		sim.setData(sampleData());
+		Pms pms(&sim);
+		TEST_CHECK(pms.begin());
+		PmsDutyCycle dutyCycle(pms, 1000, 200, 1);
+		dutyCycle.begin();
+		PmsData data;
+		const auto t0 = millis();
+		while (dutyCycle.getState() != PmsDutyState::WARMUP && millis() - t0 < 100) {
+			dutyCycle.tick(data);
+			delay(1);
+		}
+		TEST_CHECK(dutyCycle.getState() == PmsDutyState::WARMUP);
+		sim.emitFrame();
+		sim.injectBadChecksum();
+		sim.injectBadLength();
+		sim.emitFrame();
+		while (dutyCycle.getState() == PmsDutyState::WARMUP && millis() - t0 < 400) {
+			dutyCycle.tick(data);
+			delay(1);
+		}
+		if (!TEST_CHECK(dutyCycle.getDiscarded() == 2)) {
+			printf("  discarded %lu\n", dutyCycle.getDiscarded());
+		}
+	}
+}
+
+int main() {
+	testActive();
+	testPassive();
+	testQueueFull();
+	testFailed();
+	testDiscarded();
+	return test::finish("pmsTestDutyCycle");
+}
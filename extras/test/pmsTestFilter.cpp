@@ -0,0 +1,107 @@
+// Spike filter: running median against sorting the window, Hampel and rate limit on crafted signals
+
+#include <pmsFilter.h>
+#include "test.h"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+using namespace pmsx;
+
+namespace {
+
+	uint32_t nextRandom(uint32_t& seed) {
+		seed = seed * 1103515245UL + 12345UL;
+		return seed >> 8;
+	}
+
+	// range: values 0 .. range - 1, small ranges give many equal values
+	template <uint8_t Window>
+	void testMedian(const unsigned count, const uint32_t range) {
+		for (uint32_t seed = 1; seed < 8; ++seed) {
+			PmsRunningMedian<Window> median;
+			std::deque<pmsData_t> window;
+			uint32_t state = seed;
+			for (unsigned i = 0; i < count; ++i) {
+				const auto value = static_cast<pmsData_t>(nextRandom(state) % range);
+				median.update(value);
+				window.push_back(value);
+				if (window.size() > Window) {
+					window.pop_front();
+				}
+				std::vector<pmsData_t> sorted(window.begin(), window.end());
+				std::sort(sorted.begin(), sorted.end());
+				// Even count: the lower median
+				if (!TEST_CHECK(median.get() == sorted[(sorted.size() - 1) / 2]) || !TEST_CHECK(median.getCount() == sorted.size())) {
+					printf("  Window %u, range %u, seed %u, frame %u\n", Window, range, seed, i);
+					return;
+				}
+			}
+		}
+	}
+
+	PmsData frameOf(const pmsData_t value) {
+		PmsData data{};
+		for (pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+			data.raw[i] = value;
+		}
+		return data;
+	}
+
+	void testHampel() {
+		PmsFilter<5> filter;
+		filter.setConfig(PmsFilterConfig{ PmsFilterConfig::HAMPEL, 30, 5, 0 });
+		const pmsData_t signal[]{ 100, 102, 98, 101, 99, 100, 900, 101, 99, 100 };
+		for (size_t i = 0; i < sizeof signal / sizeof signal[0]; ++i) {
+			auto data = frameOf(signal[i]);
+			const auto replaced = filter.update(data);
+			if (signal[i] == 900) {
+				TEST_CHECK(replaced == (1UL << PmsData::DATA_SIZE) - 1);
+				TEST_CHECK(data.raw.getValue(4) == 100);
+			} else {
+				TEST_CHECK(replaced == 0);
+				TEST_CHECK(data.raw.getValue(4) == signal[i]);
+			}
+		}
+		TEST_CHECK(filter.getReplacedCount(0) == 1);
+
+		// A step is not a spike: the median follows it
+		for (int i = 0; i < 5; ++i) {
+			auto data = frameOf(500);
+			filter.update(data);
+		}
+		auto data = frameOf(500);
+		TEST_CHECK(filter.update(data) == 0);
+		TEST_CHECK(filter.getMedian(0) == 500);
+	}
+
+	void testRateLimit() {
+		PmsFilter<1> filter;
+		filter.setConfig(3, PmsFilterConfig{ PmsFilterConfig::RATE_LIMIT, 0, 0, 10 });
+		const pmsData_t input[]{ 100, 150, 150, 50, 45 };
+		const pmsData_t output[]{ 100, 110, 120, 110, 100 };
+		for (size_t i = 0; i < sizeof input / sizeof input[0]; ++i) {
+			auto data = frameOf(input[i]);
+			filter.update(data);
+			TEST_CHECK(data.raw.getValue(3) == output[i]);
+			TEST_CHECK(data.raw.getValue(2) == input[i]);
+			TEST_CHECK(filter.isReplaced(3) == (input[i] != output[i]));
+		}
+	}
+}
+
+int main() {
+	testMedian<1>(200, 100);
+	testMedian<2>(200, 100);
+	testMedian<3>(300, 5);
+	testMedian<4>(300, 100);
+	testMedian<5>(300, 1000);
+	testMedian<8>(300, 3);
+	testMedian<16>(1000, 65536);
+	testMedian<64>(2000, 500);
+	testMedian<255>(3000, 7);
+	testHampel();
+	testRateLimit();
+	return test::finish("pmsTestFilter");
+}
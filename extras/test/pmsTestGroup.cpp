@@ -0,0 +1,215 @@
+// PmsGroup: every byte of a grouped serial port goes through the parser of its Pms
+//
+//   a socket pair stands in for the sensor, frames are written in pieces (10 + 22 bytes)
+//   a queued command (wakeup, passive mode) must not steal bytes: Pms of a grouped sensor never reads the port
+//   passive mode: responses confirm the mode, frames after CMD_READ_DATA measure read latency, passive timeout does not back off
+//   full command queue: the due CMD_READ_DATA is not dropped, it is sent as soon as the queue has room (not one period later)
+
+#include <pms.h>
+#include <pmsGroup.h>
+#include "test.h"
+
+#include <sys/socket.h>
+#include <vector>
+
+using namespace pmsx;
+
+namespace {
+
+	void putWord(uint8_t* where, const uint16_t value) {
+		where[0] = static_cast<uint8_t>(value >> 8);
+		where[1] = static_cast<uint8_t>(value);
+	}
+
+	std::vector<uint8_t> buildFrame(const pmsData_t value) {
+		std::vector<uint8_t> frame(PmsData::FRAME_SIZE);
+		frame[0] = 0x42;
+		frame[1] = 0x4D;
+		putWord(&frame[2], PmsData::FRAME_SIZE - 4);
+		for (pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+			putWord(&frame[4 + 2 * i], static_cast<uint16_t>(value + i));
+		}
+		uint16_t sum = 0;
+		for (size_t i = 0; i < PmsData::FRAME_SIZE - 2; ++i) {
+			sum = static_cast<uint16_t>(sum + frame[i]);
+		}
+		putWord(&frame[PmsData::FRAME_SIZE - 2], sum);
+		return frame;
+	}
+
+	std::vector<uint8_t> buildResponse(const uint8_t cmd, const uint8_t value) {
+		std::vector<uint8_t> response{ 0x42, 0x4D, 0x00, 0x04, cmd, value, 0, 0 };
+		uint16_t sum = 0;
+		for (size_t i = 0; i < 6; ++i) {
+			sum = static_cast<uint16_t>(sum + response[i]);
+		}
+		putWord(&response[6], sum);
+		return response;
+	}
+
+	// The sensor side of a socket pair
+	class Sensor {
+		int fd;
+		std::vector<uint8_t> received;
+
+	public:
+		explicit Sensor(const int fd) : fd(fd) {}
+
+		void send(const uint8_t* bytes, const size_t size) {
+			TEST_CHECK(::write(fd, bytes, size) == static_cast<ssize_t>(size));
+		}
+
+		// Returns command bytes (PmsCmd low byte) received since the previous call
+		std::vector<uint8_t> commands() {
+			uint8_t buffer[64];
+			const auto done = ::recv(fd, buffer, sizeof buffer, MSG_DONTWAIT);
+			if (done > 0) {
+				received.insert(received.end(), buffer, buffer + done);
+			}
+			std::vector<uint8_t> result;
+			while (received.size() >= 7) {
+				result.push_back(received[2]);
+				received.erase(received.begin(), received.begin() + 7);
+			}
+			return result;
+		}
+	};
+
+	struct Outcomes {
+		unsigned long ok;
+		unsigned long bad;
+	};
+
+	template <typename Group>
+	void pollFor(Group& group, const unsigned long duration, Outcomes& outcomes) {
+		const auto t0 = millis();
+		while (millis() - t0 < duration) {
+			group.poll(5, [&](size_t, const PmsStatus status, const PmsData&) {
+				if (status == PmsStatus::OK) {
+					++outcomes.ok;
+				} else {
+					++outcomes.bad;
+				}
+			});
+		}
+	}
+
+	// Active mode, CMD_WAKEUP queued: warm-up ends with the first frame, no byte is lost
+	void testActive() {
+		int fds[2];
+		TEST_CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+		PmsPosixSerial serial(fds[0]);
+		Pms pms(&serial);
+		TEST_CHECK(pms.begin());
+		PmsGroup<4> group;
+		TEST_CHECK(group.add(pms, serial) == 0);
+		TEST_CHECK(pms.hasExternalInput());
+		const auto ticket = pms.writeAsync(PmsCmd::CMD_WAKEUP);
+
+		Sensor sensor(fds[1]);
+		Outcomes outcomes{ 0, 0 };
+		for (pmsData_t i = 0; i < 5; ++i) {
+			const auto frame = buildFrame(static_cast<pmsData_t>(100 * i));
+			sensor.send(frame.data(), 10);
+			pollFor(group, 20, outcomes);
+			sensor.send(frame.data() + 10, frame.size() - 10);
+			pollFor(group, 20, outcomes);
+		}
+		TEST_CHECK(outcomes.ok == 5);
+		TEST_CHECK(outcomes.bad == 0);
+		TEST_CHECK(pms.getCmdState(ticket) == PmsCmdState::DONE);
+		TEST_CHECK(pms.getSkipped() == 0);
+		PmsData data;
+		TEST_CHECK(pms.read(data) == PmsStatus::NO_DATA);
+
+		TEST_CHECK(group.remove(0));
+		TEST_CHECK(!pms.hasExternalInput());
+		close(fds[1]);
+	}
+
+	// Passive mode: the response confirms the mode, CMD_READ_DATA is answered by a frame after 30 ms
+	void testPassive() {
+		int fds[2];
+		TEST_CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+		PmsPosixSerial serial(fds[0]);
+		Pms pms(&serial);
+		TEST_CHECK(pms.begin());
+		PmsGroup<4> group;
+		TEST_CHECK(group.add(pms, serial, 100) == 0);
+
+		Sensor sensor(fds[1]);
+		Outcomes outcomes{ 0, 0 };
+		unsigned long requests = 0;
+		const auto t0 = millis();
+		while (millis() - t0 < 1000) {
+			for (const auto cmd : sensor.commands()) {
+				if (cmd == 0xe1) {
+					const auto response = buildResponse(0xe1, 0x00);
+					sensor.send(response.data(), response.size());
+				} else if (cmd == 0xe2) {
+					++requests;
+					pollFor(group, 30, outcomes);
+					const auto frame = buildFrame(static_cast<pmsData_t>(requests));
+					// Pieces: a data frame is not completed by a single read
+					sensor.send(frame.data(), 10);
+					pollFor(group, 5, outcomes);
+					sensor.send(frame.data() + 10, frame.size() - 10);
+				}
+			}
+			pollFor(group, 5, outcomes);
+		}
+		TEST_CHECK(pms.isModeActive() == false);
+		TEST_CHECK(requests >= 5);
+		TEST_CHECK(outcomes.ok + 1 >= requests && outcomes.ok <= requests);
+		TEST_CHECK(outcomes.bad == 0);
+		TEST_CHECK(pms.getReadLatency() >= 30);
+		TEST_CHECK(pms.getPassiveTimeout() < Pms::TIMEOUT_PASSIVE_MAX / 2);
+		close(fds[1]);
+	}
+
+	// The queue is full when the first request is due: CMD_MODE_PASSIVE of add() and 3 more
+	void testFullQueue() {
+		int fds[2];
+		TEST_CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+		PmsPosixSerial serial(fds[0]);
+		Pms pms(&serial);
+		TEST_CHECK(pms.begin());
+		PmsGroup<4> group;
+		TEST_CHECK(group.add(pms, serial, 1000) == 0);
+		while (pms.getCmdFree() > 0) {
+			TEST_CHECK(pms.writeAsync(PmsCmd::CMD_MODE_PASSIVE) != 0);
+		}
+
+		Sensor sensor(fds[1]);
+		Outcomes outcomes{ 0, 0 };
+		unsigned long modes = 0;
+		unsigned long requests = 0;
+		const auto t0 = millis();
+		while (millis() - t0 < 600) {
+			for (const auto cmd : sensor.commands()) {
+				if (cmd == 0xe1) {
+					++modes;
+					const auto response = buildResponse(0xe1, 0x00);
+					sensor.send(response.data(), response.size());
+				} else if (cmd == 0xe2) {
+					++requests;
+					const auto frame = buildFrame(static_cast<pmsData_t>(requests));
+					sensor.send(frame.data(), frame.size());
+				}
+			}
+			pollFor(group, 5, outcomes);
+		}
+		TEST_CHECK(modes == Pms::CMD_QUEUE_SIZE);
+		if (!TEST_CHECK(requests == 1) || !TEST_CHECK(outcomes.ok == 1)) {
+			printf("  %lu requests, %lu frames\n", requests, outcomes.ok);
+		}
+		close(fds[1]);
+	}
+}
+
+int main() {
+	testActive();
+	testPassive();
+	testFullQueue();
+	return test::finish("pmsTestGroup");
+}
@@ -0,0 +1,137 @@
+// Health watchdog against the simulator: escalation of recovery steps and the recovery
+//
+//   streaming: healthy, no recovery step
+//   stalled (no frames, the sensor answers commands): NO_FRAMES -> MODE -> SLEEP_WAKEUP -> RESET (no reset pin: SLEEP_WAKEUP again)
+//   the command queue is full when the reset fails: the fallback waits for room, all its commands are sent
+//   streaming again: recovered, backoff starts over
+
+#include <pms.h>
+#include <pmsHealth.h>
+#include <pmsSerialSimulator.h>
+#include "test.h"
+
+#include <vector>
+
+using namespace pmsx;
+
+namespace {
+
+	struct Completed {
+		PmsCmd cmd;
+		PmsCmdState state;
+	};
+
+	void logCommand(const PmsCmd cmd, const PmsCmdState state, void* context) {
+		static_cast<std::vector<Completed>*>(context)->push_back(Completed{ cmd, state });
+	}
+
+	// Number of commands completed since first (state: DONE or FAILED)
+	size_t count(const std::vector<Completed>& log, const size_t first, const PmsCmd cmd, const PmsCmdState state) {
+		size_t result = 0;
+		for (size_t i = first; i < log.size(); ++i) {
+			result += log[i].cmd == cmd && log[i].state == state;
+		}
+		return result;
+	}
+
+	class Stream {
+		PmsSimSerial& sim;
+		PmsData data;
+
+	public:
+		explicit Stream(PmsSimSerial& sim) : sim(sim), data{} {}
+
+		// Every frame differs from the previous one (not STUCK)
+		void next() {
+			++data.raw[0];
+			sim.setData(data);
+		}
+	};
+
+	// Ticks till the step is taken (or timeout ms)
+	bool waitForStep(PmsHealth& health, Stream& stream, const PmsRecoveryStep step, const unsigned long timeout) {
+		const auto t0 = millis();
+		while (millis() - t0 < timeout) {
+			stream.next();
+			health.tick();
+			PmsData data;
+			health.read(data);
+			if (health.getRecoveryStep() == step) {
+				return true;
+			}
+			delay(2);
+		}
+		return false;
+	}
+
+	void run(PmsHealth& health, Stream& stream, const unsigned long duration) {
+		const auto t0 = millis();
+		while (millis() - t0 < duration) {
+			stream.next();
+			health.tick();
+			PmsData data;
+			health.read(data);
+			delay(2);
+		}
+	}
+}
+
+int main() {
+	PmsSimSerial sim;
+	sim.setInterval(50);
+	sim.setWarmup(100);
+	Pms pms(&sim);
+	TEST_CHECK(pms.begin());
+	std::vector<Completed> log;
+	pms.setCmdCallback(logCommand, &log);
+	PmsHealth health(pms, PmsHealthConfig{ 300, 10, 50, 400, 1600, PmsCmd::CMD_MODE_ACTIVE });
+	health.begin();
+	Stream stream(sim);
+
+	run(health, stream, 500);
+	TEST_CHECK(health.isHealthy());
+	TEST_CHECK(health.getRecoveries() == 0);
+	TEST_CHECK(health.getFrames() >= 8);
+
+	// Stalled
+	sim.setInterval(0);
+	TEST_CHECK(waitForStep(health, stream, PmsRecoveryStep::MODE, 1000));
+	TEST_CHECK(health.getProblem() == PmsHealthProblem::NO_FRAMES);
+	TEST_CHECK(health.getRecoveries() == 1);
+	size_t first = log.size();
+	TEST_CHECK(waitForStep(health, stream, PmsRecoveryStep::SLEEP_WAKEUP, 2000));
+	TEST_CHECK(count(log, first, PmsCmd::CMD_MODE_ACTIVE, PmsCmdState::DONE) == 1);
+	TEST_CHECK(health.getRecoveries() == 2);
+	first = log.size();
+	TEST_CHECK(waitForStep(health, stream, PmsRecoveryStep::RESET, 6000));
+	TEST_CHECK(count(log, first, PmsCmd::CMD_SLEEP, PmsCmdState::DONE) == 1);
+	TEST_CHECK(count(log, first, PmsCmd::CMD_WAKEUP, PmsCmdState::DONE) == 1);
+	TEST_CHECK(count(log, first, PmsCmd::CMD_MODE_ACTIVE, PmsCmdState::DONE) == 1);
+	TEST_CHECK(health.getRecoveries() == 3);
+
+	// CMD_RESET and the mode command are queued; the application fills the rest of the queue with commands that wait for frames
+	first = log.size();
+	TEST_CHECK(pms.getCmdFree() == 2);
+	TEST_CHECK(pms.writeAsync(PmsCmd::CMD_WAKEUP, 200) != 0);
+	TEST_CHECK(pms.writeAsync(PmsCmd::CMD_WAKEUP, 200) != 0);
+	TEST_CHECK(pms.getCmdFree() == 0);
+	run(health, stream, 100);
+	TEST_CHECK(count(log, first, PmsCmd::CMD_RESET, PmsCmdState::FAILED) == 1);
+	TEST_CHECK(count(log, first, PmsCmd::CMD_SLEEP, PmsCmdState::DONE) == 0);
+
+	// Streaming again: the fallback completes, the next check finds the sensor healthy
+	sim.setInterval(50);
+	run(health, stream, 4000);
+	if (!TEST_CHECK(count(log, first, PmsCmd::CMD_SLEEP, PmsCmdState::DONE) == 1) || !TEST_CHECK(log.back().cmd == PmsCmd::CMD_MODE_ACTIVE)) {
+		printf("  %u commands completed after the reset\n", static_cast<unsigned>(log.size() - first));
+	}
+	TEST_CHECK(count(log, first, PmsCmd::CMD_WAKEUP, PmsCmdState::DONE) == 3);
+	TEST_CHECK(health.isHealthy());
+	TEST_CHECK(health.getRecoveryStep() == PmsRecoveryStep::NONE);
+	TEST_CHECK(health.getRecoveries() == 3);
+	TEST_CHECK(health.getRecovered() == 1);
+	TEST_CHECK(!sim.isModeSleep());
+	TEST_CHECK(sim.isModeActive());
+
+	return test::finish("pmsTestHealth");
+}
@@ -0,0 +1,167 @@
+// History round trip: PmsHistoryWriter -> file -> PmsHistoryReader gives back every sample
+//
+//   small blocks (many block boundaries), extreme deltas (0 -> 65535 -> 0, neighbouring channels in opposite directions),
+//   equal timestamps and large timestamp gaps
+//   findBlock() against a linear scan, read(from, to) against the source samples filtered by the range
+//   a file which is not a history is rejected
+
+#include <pmsHistory.h>
+#include "test.h"
+
+#include <stdlib.h>
+#include <vector>
+
+using namespace pmsx;
+
+namespace {
+
+	struct Sample {
+		uint32_t timestamp;
+		PmsData data;
+	};
+
+	typedef std::vector<Sample> samples_t;
+
+	uint32_t nextRandom(uint32_t& seed) {
+		seed = seed * 1103515245UL + 12345UL;
+		return seed >> 8;
+	}
+
+	samples_t generate() {
+		samples_t samples;
+		uint32_t seed = 99;
+		uint32_t timestamp = 1000;
+		PmsData data{};
+		for (unsigned s = 0; s < 5000; ++s) {
+			for (pmsIdx_t c = 0; c < PmsData::DATA_SIZE; ++c) {
+				if (s < 300) {
+					// 0 -> 65535 -> 0, the reference channel moves the other way
+					data.raw[c] = (s + c) % 2 ? 0xffff : 0;
+				} else if (s % 50 == 0) {
+					data.raw[c] = static_cast<pmsData_t>(nextRandom(seed));
+				} else {
+					data.raw[c] = static_cast<pmsData_t>(data.raw.getValue(c) + nextRandom(seed) % 7 - 3);
+				}
+			}
+			timestamp += s % 500 == 0 ? 1000000UL : nextRandom(seed) % 3; // equal timestamps as well
+			samples.push_back(Sample{ timestamp, data });
+		}
+		return samples;
+	}
+
+	bool equal(const Sample& sample, const uint32_t timestamp, const PmsData& data) {
+		return sample.timestamp == timestamp && memcmp(&sample.data, &data, sizeof data) == 0;
+	}
+
+	// Samples with timestamps in [from, to]
+	samples_t select(const samples_t& samples, const uint32_t from, const uint32_t to) {
+		samples_t result;
+		for (const auto& sample : samples) {
+			if (sample.timestamp >= from && sample.timestamp <= to) {
+				result.push_back(sample);
+			}
+		}
+		return result;
+	}
+
+	void testRange(const PmsHistoryReader& reader, const samples_t& samples, const uint32_t from, const uint32_t to) {
+		const auto expected = select(samples, from, to);
+		size_t index = 0;
+		bool ok = true;
+		const auto count = reader.read(from, to, [&](const uint32_t timestamp, const PmsData& data) {
+			ok = ok && index < expected.size() && equal(expected[index], timestamp, data);
+			++index;
+		});
+		if (!TEST_CHECK(ok) || !TEST_CHECK(count == expected.size()) || !TEST_CHECK(index == expected.size())) {
+			printf("  read(%u, %u): %zu samples, expected %zu\n", from, to, count, expected.size());
+		}
+	}
+}
+
+int main() {
+	const auto samples = generate();
+	char path[] = "/tmp/pmsTestHistoryXXXXXX";
+	const int fd = mkstemp(path);
+	if (!TEST_CHECK(fd >= 0)) {
+		return test::finish("pmsTestHistory");
+	}
+	close(fd);
+
+	typedef PmsHistoryWriter<PmsHistoryFile, 64> writer_t;
+	FILE* file = fopen(path, "wb");
+	TEST_CHECK(file != nullptr);
+	{
+		PmsHistoryFile sink(file);
+		writer_t writer(sink);
+		TEST_CHECK(writer.begin());
+		bool appended = true;
+		for (const auto& sample : samples) {
+			appended = appended && writer.append(sample.timestamp, sample.data);
+		}
+		TEST_CHECK(appended);
+		TEST_CHECK(writer.flush());
+		TEST_CHECK(writer.getBlocksWritten() > 100);
+	}
+	fclose(file);
+
+	PmsHistoryReader reader;
+	TEST_CHECK(reader.open(path));
+	TEST_CHECK(reader.getBlockCount() > 100);
+
+	// Every block on its own, all of them in order: the source samples
+	size_t index = 0;
+	bool ok = true;
+	uint32_t blockSamples = 0;
+	for (size_t block = 0; block < reader.getBlockCount(); ++block) {
+		const auto first = index;
+		const auto decoded = reader.decodeBlock(block, [&](const uint32_t timestamp, const PmsData& data) {
+			ok = ok && index < samples.size() && equal(samples[index], timestamp, data);
+			++index;
+		});
+		ok = ok && decoded == reader.getBlockSamples(block) && reader.getBlockFirst(block) == samples[first].timestamp
+			&& reader.getBlockLast(block) == samples[index - 1].timestamp;
+		blockSamples += reader.getBlockSamples(block);
+	}
+	TEST_CHECK(ok);
+	TEST_CHECK(index == samples.size());
+	TEST_CHECK(blockSamples == samples.size());
+
+	// findBlock(): the first block with a sample not older than timestamp
+	bool found = true;
+	for (size_t i = 0; i < samples.size(); i += 7) {
+		for (const uint32_t timestamp : { samples[i].timestamp - 1, samples[i].timestamp, samples[i].timestamp + 1 }) {
+			size_t expected = 0;
+			while (expected < reader.getBlockCount() && reader.getBlockLast(expected) < timestamp) {
+				++expected;
+			}
+			found = found && reader.findBlock(timestamp) == expected;
+		}
+	}
+	TEST_CHECK(found);
+	TEST_CHECK(reader.findBlock(0) == 0);
+	TEST_CHECK(reader.findBlock(samples.back().timestamp + 1) == reader.getBlockCount());
+
+	// Seek reads: block boundaries, gaps, single timestamps, the whole history
+	testRange(reader, samples, 0, UINT32_MAX);
+	testRange(reader, samples, samples[150].timestamp, samples[151].timestamp);
+	testRange(reader, samples, samples[2000].timestamp, samples[2000].timestamp);
+	testRange(reader, samples, samples[499].timestamp + 1, samples[500].timestamp); // the gap
+	testRange(reader, samples, samples.back().timestamp + 1, UINT32_MAX);
+	uint32_t seed = 5;
+	for (int i = 0; i < 200; ++i) {
+		const auto a = samples[nextRandom(seed) % samples.size()].timestamp;
+		const auto b = samples[nextRandom(seed) % samples.size()].timestamp;
+		testRange(reader, samples, min(a, b), max(a, b));
+	}
+	reader.close();
+
+	// Not a history
+	file = fopen(path, "wb");
+	const uint8_t garbage[64]{ 'P', 'M', 'S', 'X' };
+	TEST_CHECK(fwrite(garbage, 1, sizeof garbage, file) == sizeof garbage);
+	fclose(file);
+	TEST_CHECK(!reader.open(path));
+	unlink(path);
+
+	return test::finish("pmsTestHistory");
+}
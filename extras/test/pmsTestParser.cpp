@@ -0,0 +1,187 @@
+// Parser outcomes for every kind of injected fault
+//
+//   PmsParser: a fault followed by a good frame, fed in chunks of every size: outcomes do not depend on chunking
+//   Pms::read() (and available()) with faults injected by the simulator: the same outcomes, the good frame is never lost
+//   PmsCaptureDecoder: the same frames, errors, responses and skipped bytes as PmsParser
+
+#include <pms.h>
+#include <pmsCapture.h>
+#include <pmsSerialSimulator.h>
+#include "test.h"
+
+#include <vector>
+
+using namespace pmsx;
+
+namespace {
+
+	typedef std::vector<uint8_t> bytes_t;
+	typedef std::vector<uint8_t> outcomes_t; // PmsStatus values
+
+	struct Fault {
+		const char* name;
+		void (*inject)(PmsSimSerial& sim);
+		outcomes_t outcomes; // of the fault, the good frame behind it is OK
+		unsigned long responses;
+	};
+
+	PmsData sampleData() {
+		PmsData data{};
+		for (PmsData::pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+			data.raw[i] = static_cast<pmsData_t>(1000 + 37 * i);
+		}
+		return data;
+	}
+
+	// Garbage without a signature: a lone 0x42, 0x42 0x42, a lone 0x4D
+	void injectGarbage(PmsSimSerial& sim) {
+		const uint8_t garbage[]{ 0x00, 0x42, 0x13, 0xFF, 0x42, 0x42, 0x00, 0x4D };
+		sim.injectBytes(garbage, sizeof garbage);
+	}
+
+	void injectResponse(PmsSimSerial& sim) {
+		const uint8_t response[]{ 0x42, 0x4D, 0x00, 0x04, 0xE1, 0x00, 0x01, 0x74 };
+		sim.injectBytes(response, sizeof response);
+	}
+
+	void injectBadResponse(PmsSimSerial& sim) {
+		const uint8_t response[]{ 0x42, 0x4D, 0x00, 0x04, 0xE1, 0x00, 0x01, 0x75 };
+		sim.injectBytes(response, sizeof response);
+	}
+
+	// Signature and length of a response frame: the rest is the beginning of the good frame
+	void injectResponseHeader(PmsSimSerial& sim) {
+		const uint8_t header[]{ 0x42, 0x4D, 0x00, 0x04 };
+		sim.injectBytes(header, sizeof header);
+	}
+
+	const Fault faults[]{
+		{ "none", [](PmsSimSerial&) {}, {}, 0 },
+		{ "garbage", injectGarbage, {}, 0 },
+		{ "truncated frame", [](PmsSimSerial& sim) { sim.injectTruncatedFrame(13); }, { PmsStatus::SUM_ERROR }, 0 },
+		{ "bad checksum", [](PmsSimSerial& sim) { sim.injectBadChecksum(); }, { PmsStatus::SUM_ERROR }, 0 },
+		{ "wrong frame length", [](PmsSimSerial& sim) { sim.injectBadLength(); }, { PmsStatus::FRAME_LENGTH_MISMATCH }, 0 },
+		{ "response frame", injectResponse, {}, 1 },
+		{ "bad response frame", injectBadResponse, {}, 0 },
+		{ "response header", injectResponseHeader, {}, 0 },
+	};
+
+	bytes_t drain(PmsSimSerial& sim) {
+		bytes_t result(sim.available());
+		result.resize(sim.read(result.data(), result.size()));
+		return result;
+	}
+
+	void testParser(const Fault& fault) {
+		PmsSimSerial sim;
+		sim.setInterval(0);
+		sim.setData(sampleData());
+		fault.inject(sim);
+		sim.emitFrame();
+		const auto stream = drain(sim);
+
+		outcomes_t expected = fault.outcomes;
+		expected.push_back(static_cast<uint8_t>(PmsStatus::OK));
+		for (size_t chunk = 1; chunk <= stream.size(); ++chunk) {
+			PmsParser parser;
+			outcomes_t outcomes;
+			PmsData last{};
+			for (size_t i = 0; i < stream.size(); i += chunk) {
+				parser.feed(stream.data() + i, min(chunk, stream.size() - i), [&](const PmsStatus status, const PmsData& data) {
+					outcomes.push_back(status);
+					if (status == PmsStatus::OK) {
+						last = data;
+					}
+				});
+			}
+			const auto sample = sampleData();
+			const bool ok = TEST_CHECK(outcomes == expected) && TEST_CHECK(memcmp(&last, &sample, sizeof last) == 0)
+				&& TEST_CHECK(parser.getResponseCount() == fault.responses) && TEST_CHECK(parser.isIdle());
+			if (!ok) {
+				printf("  PmsParser, %s, chunk %zu\n", fault.name, chunk);
+				return;
+			}
+		}
+	}
+
+	unsigned long count(const outcomes_t& outcomes, const uint8_t status) {
+		unsigned long result = 0;
+		for (const auto outcome : outcomes) {
+			result += outcome == status;
+		}
+		return result;
+	}
+
+	void testCapture(const Fault& fault) {
+		PmsSimSerial sim;
+		sim.setInterval(0);
+		sim.setData(sampleData());
+		fault.inject(sim);
+		sim.emitFrame();
+		const auto stream = drain(sim);
+
+		PmsParser parser;
+		outcomes_t outcomes;
+		parser.feed(stream.data(), stream.size(), [&](const PmsStatus status, const PmsData&) {
+			outcomes.push_back(status);
+		});
+
+		pmsData_t values[PmsData::DATA_SIZE][4];
+		pmsData_t* columns[PmsData::DATA_SIZE];
+		for (pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+			columns[i] = values[i];
+		}
+		PmsCaptureDecoder decoder(columns, nullptr, 4);
+		TEST_CHECK(decoder.decode(stream.data(), stream.size()) == stream.size());
+		decoder.finish();
+		const auto& counters = decoder.getCounters();
+		const auto sample = sampleData();
+		const bool ok = TEST_CHECK(counters.frames == count(outcomes, PmsStatus::OK)) && TEST_CHECK(decoder.getFrames() == 1)
+			&& TEST_CHECK(values[PmsData::DATA_SIZE - 1][0] == sample.raw.getValue(PmsData::DATA_SIZE - 1))
+			&& TEST_CHECK(counters.sumErrors == count(outcomes, PmsStatus::SUM_ERROR))
+			&& TEST_CHECK(counters.lengthMismatches == count(outcomes, PmsStatus::FRAME_LENGTH_MISMATCH))
+			&& TEST_CHECK(counters.responses == parser.getResponseCount()) && TEST_CHECK(counters.skipped == parser.getSkipped());
+		if (!ok) {
+			printf("  PmsCaptureDecoder, %s\n", fault.name);
+		}
+	}
+
+	void testRead(const Fault& fault, const bool polled) {
+		PmsSimSerial sim;
+		sim.setInterval(0);
+		sim.setData(sampleData());
+		Pms pms(&sim);
+		pms.begin();
+
+		outcomes_t expected;
+		outcomes_t outcomes;
+		for (int round = 0; round < 3; ++round) {
+			expected.insert(expected.end(), fault.outcomes.begin(), fault.outcomes.end());
+			expected.push_back(static_cast<uint8_t>(PmsStatus::OK));
+			fault.inject(sim);
+			sim.emitFrame();
+			// polled: available() first, as loop() of a sketch does
+			while (!polled || pms.available() > 0) {
+				PmsData data;
+				const auto status = pms.read(data);
+				if (status == PmsStatus::NO_DATA) {
+					break;
+				}
+				outcomes.push_back(status);
+			}
+		}
+		if (!TEST_CHECK(outcomes == expected)) {
+			printf("  Pms::read(), %s%s\n", fault.name, polled ? ", available()" : "");
+		}
+	}
+}
+
+int main() {
+	for (const auto& fault : faults) {
+		testParser(fault);
+		testCapture(fault);
+		testRead(fault, false);
+		testRead(fault, true);
+	}
+	return test::finish("pmsTestParser");
+}
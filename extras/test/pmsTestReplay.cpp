@@ -0,0 +1,112 @@
+// Recording and replay of the byte stream: the replayed Pms returns the same outcomes as the live one
+//
+//   faults injected by the simulator, bytes dropped by flushInput() (mode commands wait for their response frames)
+//   damaged captures: truncated in the middle of a record, not a capture at all
+
+#include <pms.h>
+#include <pmsSerialSimulator.h>
+#include <pmsSerialRecorder.h>
+#include "test.h"
+
+#include <vector>
+
+using namespace pmsx;
+
+namespace {
+
+	typedef std::vector<uint8_t> bytes_t;
+	typedef std::vector<uint8_t> outcomes_t; // PmsStatus values
+
+	class MemorySink {
+		bytes_t& bytes;
+	public:
+		explicit MemorySink(bytes_t& bytes) : bytes(bytes) {}
+
+		size_t write(const uint8_t* buffer, const size_t size) {
+			bytes.insert(bytes.end(), buffer, buffer + size);
+			return size;
+		}
+	};
+
+	typedef PmsRecorderSerial<MemorySink, PmsSimSerial> recorder_t;
+
+	template <typename SerialT>
+	void readAll(BasicPms<Pms5003, SerialT>& pms, outcomes_t& outcomes) {
+		PmsData data;
+		for (PmsStatus status = pms.read(data); status != PmsStatus::NO_DATA; status = pms.read(data)) {
+			outcomes.push_back(status);
+		}
+	}
+
+	// Returns the outcomes of the live Pms, dropped: bytes dropped by flushInput()
+	outcomes_t record(bytes_t& capture, unsigned long& dropped) {
+		PmsSimSerial sim;
+		sim.setInterval(0);
+		MemorySink sink(capture);
+		recorder_t recorder(sim, sink);
+		BasicPms<Pms5003, recorder_t> pms(&recorder);
+		pms.begin();
+
+		outcomes_t outcomes;
+		dropped = 0;
+		for (unsigned i = 0; i < 1000; ++i) {
+			switch (i % 100) {
+			case 10: sim.injectGarbage(7); break;
+			case 20: sim.injectTruncatedFrame(13); break;
+			case 30: sim.injectBadChecksum(); break;
+			case 40: sim.injectBadLength(); break;
+			default: break;
+			}
+			sim.emitFrame();
+			if (i % 50 == 25) {
+				// Frames waiting in the buffer are dropped before the response frame
+				sim.emitFrame();
+				dropped += sim.available();
+				pms.writeAsync(PmsCmd::CMD_MODE_PASSIVE);
+				pms.writeAsync(PmsCmd::CMD_MODE_ACTIVE);
+				while (pms.tick()) {
+				}
+			}
+			readAll(pms, outcomes);
+		}
+		TEST_CHECK(recorder.flush());
+		return outcomes;
+	}
+}
+
+int main() {
+	bytes_t capture;
+	unsigned long dropped;
+	const auto recorded = record(capture, dropped);
+	TEST_CHECK(dropped > 0);
+
+	PmsReplaySerial replay(capture.data(), capture.size(), 0);
+	BasicPms<Pms5003, PmsReplaySerial> pms(&replay);
+	TEST_CHECK(pms.begin());
+	outcomes_t replayed;
+	while (!replay.isFinished()) {
+		readAll(pms, replayed);
+	}
+	readAll(pms, replayed);
+	TEST_CHECK(replayed.size() == recorded.size());
+	TEST_CHECK(replayed == recorded);
+	TEST_CHECK(replay.getDiscarded() == dropped);
+	TEST_CHECK(!replay.isTruncated());
+
+	// Truncated capture: everything before the damaged record is replayed
+	PmsReplaySerial truncated(capture.data(), capture.size() - 1, 0);
+	BasicPms<Pms5003, PmsReplaySerial> truncatedPms(&truncated);
+	TEST_CHECK(truncatedPms.begin());
+	outcomes_t partial;
+	while (!truncated.isFinished()) {
+		readAll(truncatedPms, partial);
+	}
+	TEST_CHECK(truncated.isTruncated());
+	TEST_CHECK(partial.size() + 1 >= recorded.size() && partial.size() <= recorded.size());
+
+	const uint8_t notCapture[PmsRecordFormat::FILE_HEADER_SIZE]{ 'P', 'M', 'S', 'X' };
+	PmsReplaySerial invalid(notCapture, sizeof notCapture, 0);
+	TEST_CHECK(!invalid.begin(0));
+
+	return test::finish("pmsTestReplay");
+}
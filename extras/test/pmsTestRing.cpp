@@ -0,0 +1,132 @@
+// spsc_ring: both overflow policies, single threaded and with a producer thread racing the consumer
+//
+//   drop_newest: a full ring rejects new values, drop_oldest: a full ring keeps the newest Capacity values; overflows() counts both
+//   wrap-around: many more values than slots pass through in order
+//   producer thread: values come out in order, no value is duplicated or torn, received + overflows == sent
+
+#include <pms.h>
+#include <spsc_ring.h>
+#include "test.h"
+
+#include <atomic>
+#include <thread>
+
+using namespace jb::threads;
+
+namespace {
+
+	// Both halves are written together: a torn copy does not pass check()
+	struct Item {
+		uint32_t sequence;
+		uint32_t inverted;
+
+		static Item of(const uint32_t sequence) {
+			return Item{ sequence, ~sequence };
+		}
+
+		bool check() const {
+			return inverted == ~sequence;
+		}
+	};
+
+	template <overflow_policy Policy>
+	void testSingle() {
+		const bool oldest = Policy == overflow_policy::drop_oldest;
+		spsc_ring<uint32_t, 8, Policy> ring;
+		uint32_t value;
+		TEST_CHECK(ring.empty());
+		TEST_CHECK(!ring.pop(value));
+
+		for (uint32_t i = 0; i < 8; ++i) {
+			TEST_CHECK(ring.push(i));
+		}
+		TEST_CHECK(ring.size() == 8);
+		// Three values too many
+		for (uint32_t i = 8; i < 11; ++i) {
+			TEST_CHECK(!ring.push(i));
+		}
+		TEST_CHECK(ring.size() == 8);
+		TEST_CHECK(ring.overflows() == 3);
+		for (uint32_t i = 0; i < 8; ++i) {
+			const bool ok = TEST_CHECK(ring.pop(value)) && TEST_CHECK(value == (oldest ? i + 3 : i));
+			if (!ok) {
+				printf("  %s, item %u: %u\n", oldest ? "drop_oldest" : "drop_newest", i, value);
+				break;
+			}
+		}
+		TEST_CHECK(!ring.pop(value));
+
+		// Wrap-around: the ring never holds more than 5 values
+		bool ordered = true;
+		uint32_t expected = 0;
+		for (uint32_t i = 0; i < 1000; ++i) {
+			ordered = ring.push(i) && ordered;
+			if (i % 5 == 4) {
+				while (ring.pop(value)) {
+					ordered = ordered && value == expected++;
+				}
+			}
+		}
+		TEST_CHECK(ordered);
+		TEST_CHECK(expected == 1000);
+		TEST_CHECK(ring.overflows() == 3);
+
+		// The same after the wrap-around: oldest dropped, or newest rejected
+		for (uint32_t i = 0; i < 9; ++i) {
+			ring.push(100 + i);
+		}
+		TEST_CHECK(ring.pop(value) && value == (oldest ? 101U : 100U));
+		TEST_CHECK(ring.overflows() == 4);
+	}
+
+	template <overflow_policy Policy>
+	void testThreads() {
+		static constexpr uint32_t COUNT = 200000;
+		spsc_ring<Item, 64, Policy> ring;
+		std::atomic<bool> done{ false };
+		uint32_t rejected = 0; // read after join()
+		std::thread producer([&ring, &done, &rejected]() {
+			for (uint32_t i = 1; i <= COUNT; ++i) {
+				if (!ring.push(Item::of(i))) {
+					++rejected;
+				}
+				if (i % 256 == 0) {
+					// Let the consumer catch up: both a full and a draining ring
+					std::this_thread::yield();
+				}
+			}
+			done.store(true);
+		});
+
+		uint32_t received = 0;
+		uint32_t last = 0;
+		bool ok = true;
+		Item item;
+		for (;;) {
+			const bool finished = done.load();
+			if (ring.pop(item)) {
+				ok = ok && item.check() && item.sequence > last;
+				last = item.sequence;
+				++received;
+			} else if (finished) {
+				break;
+			}
+		}
+		producer.join();
+		const char* name = Policy == overflow_policy::drop_oldest ? "drop_oldest" : "drop_newest";
+		if (!TEST_CHECK(ok) || !TEST_CHECK(received + ring.overflows() == COUNT) || !TEST_CHECK(rejected == ring.overflows()) || !TEST_CHECK(received > 0)) {
+			printf("  %s: received %u, overflows %u, rejected %u\n", name, received, ring.overflows(), rejected);
+		}
+	}
+}
+
+int main() {
+	testSingle<overflow_policy::drop_newest>();
+	testSingle<overflow_policy::drop_oldest>();
+	testThreads<overflow_policy::drop_newest>();
+	testThreads<overflow_policy::drop_oldest>();
+	// The element type suggested by pms.h
+	spsc_ring<pmsx::PmsSample, 16, overflow_policy::drop_oldest> samples;
+	TEST_CHECK(samples.capacity() == 16);
+	return test::finish("pmsTestRing");
+}
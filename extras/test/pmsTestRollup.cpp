@@ -0,0 +1,134 @@
+// Rollup aggregates against direct computation from the same frames
+//
+//   three days of frames (one per 7 s), a gap of two hours, unaligned start
+//   every minute and hour: count, min, max, sum of every channel; tiers are ordered and aligned
+//   query(from, to, resolution): tier selection, fallback to a coarser tier, open periods
+
+#include <pmsRollup.h>
+#include "test.h"
+
+#include <map>
+
+using namespace pmsx;
+
+namespace {
+
+	typedef PmsRollup<60, 1500, 100> rollup_t;
+
+	struct Expected {
+		uint32_t count;
+		pmsData_t minimum[PmsData::DATA_SIZE];
+		pmsData_t maximum[PmsData::DATA_SIZE];
+		uint32_t sum[PmsData::DATA_SIZE];
+	};
+
+	typedef std::map<uint32_t, Expected> periods_t;
+
+	void add(periods_t& periods, const uint32_t start, const PmsData& data) {
+		auto& period = periods[start];
+		for (pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+			const auto value = data.raw.getValue(i);
+			period.minimum[i] = period.count == 0 ? value : min(period.minimum[i], value);
+			period.maximum[i] = period.count == 0 ? value : max(period.maximum[i], value);
+			period.sum[i] = (period.count == 0 ? 0 : period.sum[i]) + value;
+		}
+		++period.count;
+	}
+
+	bool equal(const PmsAggregate& entry, const Expected& period) {
+		if (entry.count != period.count) {
+			return false;
+		}
+		for (pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+			if (entry.getMin(i) != period.minimum[i] || entry.getMax(i) != period.maximum[i] || entry.sum[i] != period.sum[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Entries of the tier overlapping [from, to] are exactly the expected periods
+	void checkTier(const rollup_t& rollup, const PmsRollupTier tier, const periods_t& periods, const uint32_t from, const uint32_t to) {
+		const uint32_t duration = rollup_t::getDuration(tier);
+		auto expected = periods.lower_bound(from - from % duration);
+		bool ok = true;
+		const auto entries = rollup.query(tier, from, to, [&](const PmsAggregate& entry) {
+			ok = ok && expected != periods.end() && entry.start == expected->first && entry.start % duration == 0 && equal(entry, expected->second);
+			if (expected != periods.end()) {
+				++expected;
+			}
+		});
+		if (!TEST_CHECK(ok) || !TEST_CHECK(expected == periods.upper_bound(to)) || !TEST_CHECK(entries > 0)) {
+			printf("  tier %u, from %u, to %u\n", static_cast<unsigned>(tier), from, to);
+		}
+	}
+}
+
+int main() {
+	static rollup_t rollup;
+	periods_t minutes;
+	periods_t hours;
+	periods_t frames;
+
+	const uint32_t start = 1700000000UL + 17; // not aligned
+	const uint32_t end = start + 3 * 24 * 3600UL;
+	uint32_t seed = 12345;
+	uint32_t last = 0;
+	for (uint32_t timestamp = start; timestamp < end; timestamp += 7) {
+		if (timestamp >= start + 5 * 3600UL && timestamp < start + 7 * 3600UL) {
+			continue;
+		}
+		PmsData data{};
+		for (pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+			seed = seed * 1103515245UL + 12345UL;
+			data.raw[i] = static_cast<pmsData_t>((seed >> 8) % 5000);
+		}
+		rollup.update(timestamp, data);
+		add(minutes, timestamp - timestamp % 60, data);
+		add(hours, timestamp - timestamp % 3600, data);
+		add(frames, timestamp, data);
+		last = timestamp;
+	}
+
+	TEST_CHECK(rollup.getUpdates() == frames.size());
+	TEST_CHECK(rollup.getCount(PmsRollupTier::RAW) == 60);
+	TEST_CHECK(rollup.getCount(PmsRollupTier::MINUTE) == 1500);
+	TEST_CHECK(rollup.getCount(PmsRollupTier::HOUR) == hours.size() - 1); // the last one is open
+	TEST_CHECK(rollup.getOldest(PmsRollupTier::HOUR) == hours.begin()->first);
+
+	// Whole history of hours, the gap is missing (not empty aggregates)
+	checkTier(rollup, PmsRollupTier::HOUR, hours, 0, last);
+	checkTier(rollup, PmsRollupTier::HOUR, hours, start + 6 * 3600UL, start + 9 * 3600UL);
+	// The last day of minutes (kept: 1500 minutes, the open one is the last entry)
+	checkTier(rollup, PmsRollupTier::MINUTE, minutes, last - 24 * 3600UL, last);
+	checkTier(rollup, PmsRollupTier::RAW, frames, last - 5 * 60, last);
+
+	// Tier selection: resolution, then coarser tiers if the selected one does not keep from
+	TEST_CHECK(rollup.getTier(last - 60, 1) == PmsRollupTier::RAW);
+	TEST_CHECK(rollup.getTier(last - 3600, 1) == PmsRollupTier::MINUTE);
+	TEST_CHECK(rollup.getTier(last - 3600, 60) == PmsRollupTier::MINUTE);
+	TEST_CHECK(rollup.getTier(last - 2 * 24 * 3600UL, 1) == PmsRollupTier::HOUR);
+	TEST_CHECK(rollup.getTier(0, 3600) == PmsRollupTier::HOUR);
+	size_t counted = 0;
+	rollup.query(last - 2 * 24 * 3600UL, last, 1, [&](const PmsAggregate& entry) {
+		counted += entry.count;
+	});
+	size_t direct = 0;
+	for (auto hour = hours.lower_bound(last - 2 * 24 * 3600UL - (last - 2 * 24 * 3600UL) % 3600); hour != hours.end(); ++hour) {
+		direct += hour->second.count;
+	}
+	TEST_CHECK(counted == direct);
+
+	// Clock going backwards: the frame is taken as the latest one
+	PmsRollup<4, 4, 4> small;
+	PmsData data{};
+	small.update(1000, data);
+	small.update(900, data);
+	TEST_CHECK(small.getOldest(PmsRollupTier::RAW) == 1000);
+	TEST_CHECK(small.query(PmsRollupTier::RAW, 1000, 1000, [](const PmsAggregate&) {}) == 2);
+	TEST_CHECK(small.query(PmsRollupTier::MINUTE, 0, 2000, [](const PmsAggregate& minute) {
+		TEST_CHECK(minute.count == 2 && minute.start == 960);
+	}) == 1);
+
+	return test::finish("pmsTestRollup");
+}
@@ -0,0 +1,144 @@
+// seqlock: single threaded store/load, and a writer thread racing reader threads
+//
+//   single threaded: version 0 before the first store, version counts stores, load_changed() copies only a new version
+//   writer thread: every value returned by a reader is a complete stored value (no torn read), its version matches the value,
+//   versions seen by a reader never decrease
+
+#include <pms.h>
+#include <seqlock.h>
+#include "test.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace jb::threads;
+
+namespace {
+
+	// Spans several words: a torn copy mixes words of two stores and does not pass check()
+	struct Item {
+		static constexpr size_t SIZE = 15;
+		uint32_t sequence[SIZE];
+		uint32_t inverted;
+
+		static Item of(const uint32_t sequence) {
+			Item item;
+			for (auto& value : item.sequence) {
+				value = sequence;
+			}
+			item.inverted = ~sequence;
+			return item;
+		}
+
+		bool check() const {
+			for (const auto value : sequence) {
+				if (value != sequence[0]) {
+					return false;
+				}
+			}
+			return inverted == ~sequence[0];
+		}
+	};
+
+	void testSingle() {
+		seqlock<Item> slot;
+		Item item = Item::of(77);
+		TEST_CHECK(slot.version() == 0);
+		// Nothing stored yet: zero value
+		TEST_CHECK(slot.load(item) == 0);
+		TEST_CHECK(item.sequence[0] == 0 && item.sequence[Item::SIZE - 1] == 0);
+
+		uint32_t version = 0;
+		TEST_CHECK(!slot.load_changed(item, version));
+		for (uint32_t i = 1; i <= 5; ++i) {
+			slot.store(Item::of(i * 10));
+		}
+		TEST_CHECK(slot.version() == 5);
+		TEST_CHECK(slot.load(item) == 5);
+		TEST_CHECK(item.check() && item.sequence[0] == 50);
+
+		TEST_CHECK(slot.load_changed(item, version));
+		TEST_CHECK(version == 5);
+		item = Item::of(1);
+		TEST_CHECK(!slot.load_changed(item, version));
+		TEST_CHECK(item.sequence[0] == 1); // not modified
+
+		slot.store(Item::of(60));
+		TEST_CHECK(slot.try_load(item, version));
+		TEST_CHECK(version == 6 && item.check() && item.sequence[0] == 60);
+
+		// A value that does not fill the last word
+		seqlock<uint8_t[5]> bytes;
+		const uint8_t stored[5]{ 1, 2, 3, 4, 5 };
+		uint8_t loaded[5]{};
+		bytes.store(stored);
+		TEST_CHECK(bytes.load(loaded) == 1);
+		TEST_CHECK(memcmp(stored, loaded, sizeof stored) == 0);
+	}
+
+	// Store number n is Item::of(n): the version of a value is its sequence
+	void testThreads() {
+		static constexpr uint32_t COUNT = 200000;
+		static constexpr int READERS = 2;
+		seqlock<Item> slot;
+		std::atomic<bool> done{ false };
+		std::thread writer([&slot, &done]() {
+			for (uint32_t i = 1; i <= COUNT; ++i) {
+				slot.store(Item::of(i));
+				if (i % 256 == 0) {
+					std::this_thread::yield();
+				}
+			}
+			done.store(true);
+		});
+
+		struct Result {
+			bool ok = true;
+			uint32_t reads = 0;
+			uint32_t torn = 0;
+			uint32_t last = 0;
+		};
+		std::vector<Result> results(READERS);
+		std::vector<std::thread> readers;
+		for (int r = 0; r < READERS; ++r) {
+			readers.emplace_back([&slot, &done, &results, r]() {
+				Result& result = results[r];
+				Item item;
+				uint32_t version = 0;
+				for (;;) {
+					const bool finished = done.load();
+					// Both reader entry points: load() and load_changed()
+					const bool loaded = r == 0 ? (version = slot.load(item), true) : slot.load_changed(item, version);
+					if (loaded) {
+						++result.reads;
+						if (!item.check()) {
+							++result.torn;
+						}
+						result.ok = result.ok && item.sequence[0] == version && version >= result.last;
+						result.last = version;
+					}
+					if (finished) {
+						break;
+					}
+				}
+			});
+		}
+		writer.join();
+		for (auto& reader : readers) {
+			reader.join();
+		}
+		for (int r = 0; r < READERS; ++r) {
+			const auto& result = results[r];
+			if (!TEST_CHECK(result.torn == 0) || !TEST_CHECK(result.ok) || !TEST_CHECK(result.last == COUNT)) {
+				printf("  reader %d: %u reads, %u torn, last version %u\n", r, result.reads, result.torn, result.last);
+			}
+		}
+	}
+}
+
+int main() {
+	testSingle();
+	testThreads();
+	return test::finish("pmsTestSeqlock");
+}
@@ -0,0 +1,156 @@
+// Streaming statistics against direct computation
+//
+//   PmsRollingWindow: count, mean, min, max of the last Window values, recomputed from the values for every update
+//   PmsEwma: against a floating point EWMA, within the 8 bit fraction of the state
+//   PmsP2Quantile: uniform and skewed (log-normal, like particle counts) distributions, estimates against exact quantiles of the same samples
+//     tolerance: the rank of the estimate is within 1 percentile (0.01) of the requested quantile; fewer than 5 samples: exact
+//   PmsStatistics, PmsQuantiles: every channel
+
+#include <pmsStatistics.h>
+#include "test.h"
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+using namespace pmsx;
+
+namespace {
+
+	constexpr double RANK_TOLERANCE = 0.01;
+
+	uint32_t nextRandom(uint32_t& seed) {
+		seed = seed * 1103515245UL + 12345UL;
+		return seed >> 8;
+	}
+
+	// (0, 1)
+	double uniform(uint32_t& seed) {
+		return (nextRandom(seed) % 0xfffffeU + 1) / static_cast<double>(0xffffffU);
+	}
+
+	template <uint8_t Window>
+	void testWindow(const uint32_t range) {
+		PmsRollingWindow<Window> window;
+		std::vector<pmsData_t> values;
+		uint32_t seed = range;
+		for (unsigned i = 0; i < 2000; ++i) {
+			const auto value = static_cast<pmsData_t>(nextRandom(seed) % range);
+			window.update(value);
+			values.push_back(value);
+			const size_t count = min(values.size(), static_cast<size_t>(Window));
+			const auto first = values.end() - static_cast<long>(count);
+			uint32_t sum = 0;
+			for (auto it = first; it != values.end(); ++it) {
+				sum += *it;
+			}
+			const bool ok = TEST_CHECK(window.getCount() == count) && TEST_CHECK(window.getMin() == *std::min_element(first, values.end()))
+				&& TEST_CHECK(window.getMax() == *std::max_element(first, values.end()))
+				&& TEST_CHECK(fabs(window.getMean() - static_cast<double>(sum) / count) <= 1e-3);
+			if (!ok) {
+				printf("  Window %u, range %u, value %u\n", Window, range, i);
+				return;
+			}
+		}
+	}
+
+	void testEwma() {
+		PmsEwma<3> ewma;
+		TEST_CHECK(isnan(ewma.get()));
+		double reference = 0;
+		double maxError = 0;
+		uint32_t seed = 3;
+		for (unsigned i = 0; i < 5000; ++i) {
+			const auto value = static_cast<pmsData_t>(1000 + nextRandom(seed) % 500);
+			ewma.update(value);
+			reference = i == 0 ? value : reference + (value - reference) / 8;
+			maxError = max(maxError, fabs(ewma.get() - reference));
+		}
+		// Every update truncates below 1/256: the error stays below 8 / 256
+		if (!TEST_CHECK(maxError < 8.0 / 256)) {
+			printf("  EWMA max error %.4f\n", maxError);
+		}
+	}
+
+	// Rank of the estimate among sorted samples, compared to the quantile
+	void checkQuantile(const char* name, std::vector<float> samples, const float quantile) {
+		PmsP2Quantile estimator(quantile);
+		for (const auto value : samples) {
+			estimator.update(value);
+		}
+		std::sort(samples.begin(), samples.end());
+		const float estimate = estimator.get();
+		const auto below = std::lower_bound(samples.begin(), samples.end(), estimate) - samples.begin();
+		const auto notAbove = std::upper_bound(samples.begin(), samples.end(), estimate) - samples.begin();
+		const double n = static_cast<double>(samples.size());
+		// Equal values: any rank between below and notAbove
+		const double error = quantile * n < below ? below / n - quantile : quantile * n > notAbove ? quantile - notAbove / n : 0.0;
+		const float exact = samples[static_cast<size_t>(quantile * (n - 1) + 0.5)];
+		if (!TEST_CHECK(error <= RANK_TOLERANCE) || !TEST_CHECK(estimator.getCount() == samples.size())) {
+			printf("  %s, quantile %.2f: estimate %.2f, exact %.2f, rank error %.4f\n", name, quantile, estimate, exact, error);
+		}
+	}
+
+	void testP2() {
+		std::vector<float> uniformSamples;
+		std::vector<float> skewedSamples;
+		uint32_t seed = 11;
+		for (unsigned i = 0; i < 100000; ++i) {
+			uniformSamples.push_back(static_cast<float>(uniform(seed) * 1000));
+			// Box-Muller: log-normal, median 20, long tail
+			const double normal = sqrt(-2 * log(uniform(seed))) * cos(2 * M_PI * uniform(seed));
+			skewedSamples.push_back(static_cast<float>(20 * exp(normal)));
+		}
+		for (const float quantile : { 0.1f, 0.5f, 0.9f, 0.99f }) {
+			checkQuantile("uniform", uniformSamples, quantile);
+			checkQuantile("log-normal", skewedSamples, quantile);
+		}
+
+		// Fewer than 5 samples: exact, nearest rank
+		PmsP2Quantile median;
+		TEST_CHECK(isnan(median.get()));
+		for (const float value : { 7.0f, 1.0f, 5.0f }) {
+			median.update(value);
+		}
+		TEST_CHECK(median.get() == 5.0f);
+		median.reset();
+		TEST_CHECK(median.getCount() == 0);
+	}
+
+	void testChannels() {
+		PmsStatistics<4> statistics;
+		PmsQuantiles quantiles;
+		for (pmsData_t value = 1; value <= 10; ++value) {
+			PmsData data{};
+			for (pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+				data.raw[i] = static_cast<pmsData_t>(value * (i + 1));
+			}
+			statistics.update(data);
+			quantiles.update(data);
+		}
+		TEST_CHECK(statistics.getCount() == 4);
+		bool ok = true;
+		for (pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+			// Window: 7, 8, 9, 10 times (i + 1)
+			ok = ok && statistics.getMin(i) == 7 * (i + 1) && statistics.getMax(i) == 10 * (i + 1) && fabs(statistics.getMean(i) - 8.5f * (i + 1)) < 1e-3f;
+			ok = ok && statistics.getEwma(i) > statistics.getMin(i) - 7 * (i + 1) && statistics.getEwma(i) < statistics.getMax(i);
+			ok = ok && quantiles.get(i) >= 4.0f * (i + 1) && quantiles.get(i) <= 7.0f * (i + 1);
+		}
+		TEST_CHECK(ok);
+		statistics.reset();
+		TEST_CHECK(statistics.getCount() == 0);
+		TEST_CHECK(isnan(statistics.getMean(0)));
+	}
+}
+
+int main() {
+	testWindow<1>(100);
+	testWindow<5>(3);
+	testWindow<8>(1000);
+	testWindow<64>(65536);
+	testWindow<255>(50);
+	testEwma();
+	testP2();
+	testChannels();
+	return test::finish("pmsTestStatistics");
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// Tiny helpers shared by host tests: checks and the exit status (ctest: any failed check fails the test)
+
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace test {
+
+	struct Totals {
+		unsigned long checks;
+		unsigned long failures;
+	};
+
+	inline Totals& totals() {
+		static Totals result{ 0, 0 };
+		return result;
+	}
+
+	inline bool check(const bool ok, const char* expression, const char* file, const int line) {
+		++totals().checks;
+		if (!ok) {
+			++totals().failures;
+			printf("%s:%d: check failed: %s\n", file, line, expression);
+		}
+		return ok;
+	}
+
+	// Prints the summary, returns the exit status of main()
+	inline int finish(const char* name) {
+		printf("%s: %lu checks, %lu failed\n", name, totals().checks, totals().failures);
+		return totals().failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+}
+
+// Evaluates to the result: if (!TEST_CHECK(...)) { print details }
+#define TEST_CHECK(expression) test::check(static_cast<bool>(expression), #expression, __FILE__, __LINE__)
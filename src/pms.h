@@ -2,6 +2,7 @@
 
 #include <Arduino.h>
 #include <stdint.h>
+#include <string.h>
 #include <tribool.h>
 #include <compact_optional.h>
 #include <pmsConfig.h>
@@ -71,152 +72,454 @@ namespace pmsx {
 		}
 	};
 
-	class PmsData {
+	typedef uint8_t pmsIdx_t;
+
+	// Sensor models
+	//
+	// Model describes the frame layout at compile time: DATA_SIZE (number of data words), channel tables and "views" (Layout)
+	// Every model gets its own BasicPmsData<Model>, BasicPmsParser<Model> and BasicPms<Model>: exactly sized buffers, no runtime dispatch
+	// PmsData, PmsParser, Pms, PmsSample: PMS5003
+
+	template <typename Model, pmsIdx_t Ofset>
+	class PmsNames {
 	public:
-		typedef uint8_t pmsIdx_t;
-		static constexpr pmsIdx_t DATA_SIZE = 13;
-	private:
-		static const float DIAMETERS[DATA_SIZE];
-		static const char* const METRICS[DATA_SIZE];
+		const char* operator[](pmsIdx_t index) const {
+			return Ofset + index < Model::DATA_SIZE ? Model::names()[Ofset + index] : "???";
+		}
+	};
+
+	template <typename Model, pmsIdx_t Ofset>
+	class PmsMetrics {
 	public:
-		static constexpr size_t RESPONSE_FRAME_SIZE = (1 + 3) * sizeof(pmsData_t); // Frame size for single pmsData_t response (after write command)
-		static constexpr size_t FRAME_SIZE = (DATA_SIZE + 3) * sizeof(pmsData_t); // useful for waitForData()
-		static constexpr size_t getFrameSize() {
-			return FRAME_SIZE;
-		} // useful for waitForData()
-	private:
-		template <pmsIdx_t Ofset>
-		class Names_ {
-		public:
-			const char* & operator[](pmsIdx_t index) {
-				static const char* NAMES[]{
-					"PM1.0, CF=1",
-					"PM2.5, CF=1",
-					"PM10.  CF=1",
-					"PM1.0",
-					"PM2.5",
-					"PM10.",
-					"Particles > 0.3 micron",
-					"Particles > 0.5 micron",
-					"Particles > 1.0 micron",
-					"Particles > 2.5 micron",
-					"Particles > 5.0 micron",
-					"Particles > 10. micron",
-					"Reserved_0"
-				};
-				return NAMES[min(Ofset + index, static_cast<decltype(Ofset + index)>(_countof(NAMES)))];
-			}
+		const char* operator[](pmsIdx_t index) const {
+			return Ofset + index < Model::DATA_SIZE ? Model::metrics()[Ofset + index] : "???";
+		}
+	};
+
+	template <typename Model, pmsIdx_t Ofset>
+	class PmsDiameters {
+	public:
+		float operator[](pmsIdx_t index) const {
+			return Ofset + index < Model::DATA_SIZE ? Model::diameters()[Ofset + index] : NAN;
+		}
+	};
+
+	// Consecutive channels of a frame ("view")
+	template <typename Model, pmsIdx_t Size, pmsIdx_t Ofset>
+	class PmsConcentrationData {
+		pmsData_t data[Size];
+	public:
+
+		static constexpr pmsIdx_t SIZE = Size;
+		static PmsNames<Model, Ofset> names;
+		static PmsMetrics<Model, Ofset> metrics;
+		static PmsDiameters<Model, Ofset> diameters;
+
+		static constexpr pmsIdx_t getSize() {
+			return SIZE;
 		};
 
-		template <pmsIdx_t Ofset>
-		class Metrics_ {
-		public:
-			const char* & operator[](pmsIdx_t index) {
-				static const char* METRICS[]{
-					"micro g/m3",
-					"micro g/m3",
-					"micro g/m3",
-
-					"micro g/m3",
-					"micro g/m3",
-					"micro g/m3",
-
-					"/0.1L",
-					"/0.1L",
-					"/0.1L",
-					"/0.1L",
-					"/0.1L",
-					"/0.1L",
-
-					"???"
-				};
-				return METRICS[min(Ofset + index, static_cast<decltype(Ofset + index)>(_countof(METRICS)))];
+		pmsData_t& operator[](pmsIdx_t index) {
+			return data[index];
+		}
+
+		pmsData_t getValue(pmsIdx_t index) const {
+			return data[index];
+		}
+
+		static const char* getName(pmsIdx_t index) {
+			return names[index];
+		}
+
+		static const char* getMetric(pmsIdx_t index) {
+			return metrics[index];
+		}
+
+		static float getDiameter(pmsIdx_t index) {
+			return diameters[index];
+		}
+	};
+
+	template <typename Model, pmsIdx_t Size, pmsIdx_t Ofset>
+	PmsNames<Model, Ofset> PmsConcentrationData<Model, Size, Ofset>::names;
+
+	template <typename Model, pmsIdx_t Size, pmsIdx_t Ofset>
+	PmsMetrics<Model, Ofset> PmsConcentrationData<Model, Size, Ofset>::metrics;
+
+	template <typename Model, pmsIdx_t Size, pmsIdx_t Ofset>
+	PmsDiameters<Model, Ofset> PmsConcentrationData<Model, Size, Ofset>::diameters;
+
+	// ISO 14644-1 level without floating point (FPU-less AVR, reprocessing of history)
+	//   level = 4 + log10(value * (10 * diameter) ^ 2.08) = offset(diameter) + log10(value)
+	//   offset: per channel constant, Model::levelOffsets()
+	//   log10: normalization (exponent) and interpolated table (mantissa), error below 0.001
+	class PmsIsoLevel {
+	public:
+		static constexpr uint16_t SCALE = 1000U; // levels are returned in thousandths
+
+		// log10(value) * 65536, value > 0
+		static uint32_t log10Q16(uint16_t value) {
+			// log10(1 + i / 32) * 65536
+			static const uint16_t MANTISSA[33]{
+				0, 876, 1725, 2551, 3352, 4132, 4891, 5631, 6351, 7054, 7740, 8409, 9064, 9703, 10329, 10941,
+				11540, 12127, 12702, 13266, 13818, 14361, 14893, 15415, 15928, 16432, 16927, 17413, 17891, 18362, 18825, 19280,
+				19728
+			};
+			uint8_t exponent = 15;
+			while ((value & 0x8000U) == 0) {
+				value <<= 1;
+				--exponent;
 			}
-		};
+			const uint8_t i = (value >> 10) & 0x1fU;
+			const uint16_t fraction = value & 0x3ffU;
+			const uint16_t low = MANTISSA[i];
+			const uint32_t interpolated = (static_cast<uint32_t>(MANTISSA[i + 1] - low) * fraction) >> 10;
+			// log10(2) * 2^22 = 1262611
+			return ((exponent * 1262611UL) >> 6) + low + interpolated;
+		}
 
-		template <pmsIdx_t Ofset>
-		class Diameters_ {
-		public:
-			const float& operator[](pmsIdx_t index) {
-				static const float DIAMETERS[]{
-					1.0f,
-					2.5f,
-					10.0f,
-
-					1.0f,
-					2.5f,
-					10.0f,
-
-					0.3f,
-					0.5f,
-					1.0f,
-					2.5f,
-					5.0f,
-					10.0f,
-
-					NAN
-				};
-				return DIAMETERS[min(Ofset + index, static_cast<decltype(Ofset + index)>(_countof(DIAMETERS)))];
+		// offset: 4 + 2.08 * log10(10 * diameter), * 65536
+		static uint16_t getLevel(pmsData_t value, uint32_t offset) {
+			return (value == 0) ? 0 : static_cast<uint16_t>(((offset + log10Q16(value)) * SCALE + 0x8000UL) >> 16);
+		}
+	};
+
+	template <typename Model, pmsIdx_t Size, pmsIdx_t Ofset>
+	class PmsCleanliness : public PmsConcentrationData<Model, Size, Ofset> {
+	public:
+		static constexpr uint16_t LEVEL_SCALE = PmsIsoLevel::SCALE;
+
+		// according to ISO 14644-1:2002 http://www.instalacje-sanitarne.waw.pl/poradnik.html
+		float getLevel(pmsIdx_t index) const {
+			return (this->getValue(index) == 0) ? 0.0 : 4.0 + log10(this->getValue(index) * pow(this->getDiameter(index) * 10.0, 2.08));
+		}
+
+		// Same as getLevel(), integer arithmetic only, in LEVEL_SCALE units (thousandths)
+		uint16_t getLevelFixed(pmsIdx_t index) const {
+			return PmsIsoLevel::getLevel(this->getValue(index), Model::levelOffsets()[Ofset + index]);
+		}
+
+		// All channels of the view: levels[Size], in LEVEL_SCALE units
+		void getLevels(uint16_t* levels) const {
+			const uint32_t* offsets = Model::levelOffsets() + Ofset;
+			for (pmsIdx_t i = 0; i < Size; ++i) {
+				levels[i] = PmsIsoLevel::getLevel(this->getValue(i), offsets[i]);
 			}
-		};
+		}
+	};
+
+	template <typename Model, pmsIdx_t Size, pmsIdx_t Ofset>
+	constexpr uint16_t PmsCleanliness<Model, Size, Ofset>::LEVEL_SCALE;
 
+	// PMS5003T, PMS5003ST: temperature (signed, 0.1 deg C) and relative humidity (0.1 %)
+	template <typename Model, pmsIdx_t Ofset>
+	class PmsClimate : public PmsConcentrationData<Model, 2, Ofset> {
 	public:
-		template <pmsIdx_t Size, pmsIdx_t Ofset>
-		class PmsConcentrationData {
-			pmsData_t data[Size];
+		float getTemperature() const {
+			return static_cast<int16_t>(this->getValue(0)) / 10.0f;
+		}
+
+		float getHumidity() const {
+			return this->getValue(1) / 10.0f;
+		}
+	};
+
+	struct Pms5003 {
+		static constexpr pmsIdx_t DATA_SIZE = 13;
+
+		static const char* const* names() {
+			static const char* const NAMES[DATA_SIZE]{
+				"PM1.0, CF=1", "PM2.5, CF=1", "PM10.  CF=1",
+				"PM1.0", "PM2.5", "PM10.",
+				"Particles > 0.3 micron", "Particles > 0.5 micron", "Particles > 1.0 micron", "Particles > 2.5 micron", "Particles > 5.0 micron", "Particles > 10. micron",
+				"Reserved_0"
+			};
+			return NAMES;
+		}
+
+		static const char* const* metrics() {
+			static const char* const METRICS[DATA_SIZE]{
+				"micro g/m3", "micro g/m3", "micro g/m3",
+				"micro g/m3", "micro g/m3", "micro g/m3",
+				"/0.1L", "/0.1L", "/0.1L", "/0.1L", "/0.1L", "/0.1L",
+				"???"
+			};
+			return METRICS;
+		}
+
+		static const float* diameters() {
+			static const float DIAMETERS[DATA_SIZE]{
+				1.0f, 2.5f, 10.0f,
+				1.0f, 2.5f, 10.0f,
+				0.3f, 0.5f, 1.0f, 2.5f, 5.0f, 10.0f,
+				NAN
+			};
+			return DIAMETERS;
+		}
+
+		// PmsIsoLevel: 4 + 2.08 * log10(10 * diameter), * 65536
+		static const uint32_t* levelOffsets() {
+			static const uint32_t LEVEL_OFFSETS[DATA_SIZE]{
+				0, 0, 0,
+				0, 0, 0,
+				327183, 357424, 398459, 452704, 493739, 534774,
+				0
+			};
+			return LEVEL_OFFSETS;
+		}
+
+		class Layout {
 		public:
+			typedef PmsCleanliness<Pms5003, 6, 6> Cleanliness;
 
-			static constexpr pmsIdx_t SIZE = Size;
-			static Names_<Ofset> names;
-			static Metrics_<Ofset> metrics;
-			static Diameters_<Ofset> diameters;
+			union {
+				PmsConcentrationData<Pms5003, 13, 0> raw;
 
-			static constexpr pmsIdx_t getSize() {
-				return SIZE;
+				struct {
+					PmsConcentrationData<Pms5003, 3, 0> concentrationCf;
+					PmsConcentrationData<Pms5003, 3, 3> concentration;
+					Cleanliness particles;
+					PmsConcentrationData<Pms5003, 1, 12> reserved;
+				};
 			};
+		};
+	};
 
-			pmsData_t& operator[](pmsIdx_t index) {
-				return data[index];
-			}
+	// Shorter frame: no particle counts
+	struct Pms3003 {
+		static constexpr pmsIdx_t DATA_SIZE = 9;
 
-			pmsData_t getValue(pmsIdx_t index) const {
-				return data[index];
-			}
+		static const char* const* names() {
+			static const char* const NAMES[DATA_SIZE]{
+				"PM1.0, CF=1", "PM2.5, CF=1", "PM10.  CF=1",
+				"PM1.0", "PM2.5", "PM10.",
+				"Reserved_0", "Reserved_1", "Reserved_2"
+			};
+			return NAMES;
+		}
 
-			static const char* getName(pmsIdx_t index) {
-				return names[index];
-			}
+		static const char* const* metrics() {
+			static const char* const METRICS[DATA_SIZE]{
+				"micro g/m3", "micro g/m3", "micro g/m3",
+				"micro g/m3", "micro g/m3", "micro g/m3",
+				"???", "???", "???"
+			};
+			return METRICS;
+		}
 
-			static const char* getMetric(pmsIdx_t index) {
-				return metrics[index];
-			}
+		static const float* diameters() {
+			static const float DIAMETERS[DATA_SIZE]{
+				1.0f, 2.5f, 10.0f,
+				1.0f, 2.5f, 10.0f,
+				NAN, NAN, NAN
+			};
+			return DIAMETERS;
+		}
 
-			static float getDiameter(pmsIdx_t index) {
-				return diameters[index];
-			}
+		class Layout {
+		public:
+			union {
+				PmsConcentrationData<Pms3003, 9, 0> raw;
+
+				struct {
+					PmsConcentrationData<Pms3003, 3, 0> concentrationCf;
+					PmsConcentrationData<Pms3003, 3, 3> concentration;
+					PmsConcentrationData<Pms3003, 3, 6> reserved;
+				};
+			};
 		};
+	};
+
+	// The same frame length as PMS5003: 4 particle counts, temperature and humidity
+	struct Pms5003T {
+		static constexpr pmsIdx_t DATA_SIZE = 13;
+
+		static const char* const* names() {
+			static const char* const NAMES[DATA_SIZE]{
+				"PM1.0, CF=1", "PM2.5, CF=1", "PM10.  CF=1",
+				"PM1.0", "PM2.5", "PM10.",
+				"Particles > 0.3 micron", "Particles > 0.5 micron", "Particles > 1.0 micron", "Particles > 2.5 micron",
+				"Temperature", "Humidity",
+				"Reserved_0"
+			};
+			return NAMES;
+		}
+
+		static const char* const* metrics() {
+			static const char* const METRICS[DATA_SIZE]{
+				"micro g/m3", "micro g/m3", "micro g/m3",
+				"micro g/m3", "micro g/m3", "micro g/m3",
+				"/0.1L", "/0.1L", "/0.1L", "/0.1L",
+				"0.1 deg C", "0.1 %",
+				"???"
+			};
+			return METRICS;
+		}
 
-		class Cleanliness : public PmsConcentrationData<6, 6> {
+		static const float* diameters() {
+			static const float DIAMETERS[DATA_SIZE]{
+				1.0f, 2.5f, 10.0f,
+				1.0f, 2.5f, 10.0f,
+				0.3f, 0.5f, 1.0f, 2.5f,
+				NAN, NAN,
+				NAN
+			};
+			return DIAMETERS;
+		}
+
+		static const uint32_t* levelOffsets() {
+			static const uint32_t LEVEL_OFFSETS[DATA_SIZE]{
+				0, 0, 0,
+				0, 0, 0,
+				327183, 357424, 398459, 452704,
+				0, 0,
+				0
+			};
+			return LEVEL_OFFSETS;
+		}
+
+		class Layout {
 		public:
-			// according to ISO 14644-1:2002 http://www.instalacje-sanitarne.waw.pl/poradnik.html
-			float getLevel(pmsIdx_t index) const {
-				return (getValue(index) == 0) ? 0.0 : 4.0 + log10(getValue(index) * pow(getDiameter(index) * 10.0, 2.08));
-			}
+			typedef PmsCleanliness<Pms5003T, 4, 6> Cleanliness;
+
+			union {
+				PmsConcentrationData<Pms5003T, 13, 0> raw;
+
+				struct {
+					PmsConcentrationData<Pms5003T, 3, 0> concentrationCf;
+					PmsConcentrationData<Pms5003T, 3, 3> concentration;
+					Cleanliness particles;
+					PmsClimate<Pms5003T, 10> climate;
+					PmsConcentrationData<Pms5003T, 1, 12> reserved;
+				};
+			};
 		};
+	};
+
+	// Longer frame: PMS5003 channels, formaldehyde, temperature and humidity
+	struct Pms5003ST {
+		static constexpr pmsIdx_t DATA_SIZE = 17;
+
+		static const char* const* names() {
+			static const char* const NAMES[DATA_SIZE]{
+				"PM1.0, CF=1", "PM2.5, CF=1", "PM10.  CF=1",
+				"PM1.0", "PM2.5", "PM10.",
+				"Particles > 0.3 micron", "Particles > 0.5 micron", "Particles > 1.0 micron", "Particles > 2.5 micron", "Particles > 5.0 micron", "Particles > 10. micron",
+				"Formaldehyde",
+				"Temperature", "Humidity",
+				"Reserved_0", "Version, error code"
+			};
+			return NAMES;
+		}
+
+		static const char* const* metrics() {
+			static const char* const METRICS[DATA_SIZE]{
+				"micro g/m3", "micro g/m3", "micro g/m3",
+				"micro g/m3", "micro g/m3", "micro g/m3",
+				"/0.1L", "/0.1L", "/0.1L", "/0.1L", "/0.1L", "/0.1L",
+				"micro g/m3",
+				"0.1 deg C", "0.1 %",
+				"???", "???"
+			};
+			return METRICS;
+		}
+
+		static const float* diameters() {
+			static const float DIAMETERS[DATA_SIZE]{
+				1.0f, 2.5f, 10.0f,
+				1.0f, 2.5f, 10.0f,
+				0.3f, 0.5f, 1.0f, 2.5f, 5.0f, 10.0f,
+				NAN,
+				NAN, NAN,
+				NAN, NAN
+			};
+			return DIAMETERS;
+		}
 
-		union {
-			PmsConcentrationData<13, 0> raw;
+		static const uint32_t* levelOffsets() {
+			static const uint32_t LEVEL_OFFSETS[DATA_SIZE]{
+				0, 0, 0,
+				0, 0, 0,
+				327183, 357424, 398459, 452704, 493739, 534774,
+				0,
+				0, 0,
+				0, 0
+			};
+			return LEVEL_OFFSETS;
+		}
 
-			struct {
-				PmsConcentrationData<3, 0> concentrationCf;
-				PmsConcentrationData<3, 3> concentration;
-				Cleanliness particles;
-				PmsConcentrationData<1, 12> reserved;
+		class Layout {
+		public:
+			typedef PmsCleanliness<Pms5003ST, 6, 6> Cleanliness;
+
+			union {
+				PmsConcentrationData<Pms5003ST, 17, 0> raw;
+
+				struct {
+					PmsConcentrationData<Pms5003ST, 3, 0> concentrationCf;
+					PmsConcentrationData<Pms5003ST, 3, 3> concentration;
+					Cleanliness particles;
+					PmsConcentrationData<Pms5003ST, 1, 12> formaldehyde;
+					PmsClimate<Pms5003ST, 13> climate;
+					PmsConcentrationData<Pms5003ST, 2, 15> reserved;
+				};
 			};
 		};
 	};
 
-	static_assert(sizeof(PmsData) == PmsData::DATA_SIZE * sizeof(pmsData_t), "PmsData: wrong sizeof()");
+	////////////////////////////////////////
+
+	template <typename Model>
+	class BasicPmsData : public Model::Layout {
+	public:
+		typedef Model model_t;
+		typedef pmsx::pmsIdx_t pmsIdx_t;
+		static constexpr pmsIdx_t DATA_SIZE = Model::DATA_SIZE;
+		static constexpr size_t RESPONSE_FRAME_SIZE = (1 + 3) * sizeof(pmsData_t); // Frame size for single pmsData_t response (after write command)
+		static constexpr size_t FRAME_SIZE = (DATA_SIZE + 3) * sizeof(pmsData_t); // useful for waitForData()
+		static constexpr size_t getFrameSize() {
+			return FRAME_SIZE;
+		} // useful for waitForData()
+
+		template <pmsIdx_t Size, pmsIdx_t Ofset>
+		using PmsConcentrationData = pmsx::PmsConcentrationData<Model, Size, Ofset>;
+	};
+
+	template <typename Model>
+	constexpr pmsIdx_t BasicPmsData<Model>::DATA_SIZE;
+
+	template <typename Model>
+	constexpr size_t BasicPmsData<Model>::RESPONSE_FRAME_SIZE;
+
+	template <typename Model>
+	constexpr size_t BasicPmsData<Model>::FRAME_SIZE;
+
+	typedef BasicPmsData<Pms5003> PmsData;
+
+	// ISO 14644-1 levels of many frames at once (history, statistics): levels[count * Cleanliness::SIZE], frame by frame, in PmsIsoLevel::SCALE units
+	template <typename Model>
+	void getCleanlinessLevels(const BasicPmsData<Model>* frames, size_t count, uint16_t* levels) {
+		constexpr pmsIdx_t size = BasicPmsData<Model>::Cleanliness::SIZE;
+		for (size_t i = 0; i < count; ++i) {
+			frames[i].particles.getLevels(levels);
+			levels += size;
+		}
+	}
+
+	static_assert(sizeof(BasicPmsData<Pms5003>) == Pms5003::DATA_SIZE * sizeof(pmsData_t), "PmsData: wrong sizeof()");
+	static_assert(sizeof(BasicPmsData<Pms3003>) == Pms3003::DATA_SIZE * sizeof(pmsData_t), "PmsData<Pms3003>: wrong sizeof()");
+	static_assert(sizeof(BasicPmsData<Pms5003T>) == Pms5003T::DATA_SIZE * sizeof(pmsData_t), "PmsData<Pms5003T>: wrong sizeof()");
+	static_assert(sizeof(BasicPmsData<Pms5003ST>) == Pms5003ST::DATA_SIZE * sizeof(pmsData_t), "PmsData<Pms5003ST>: wrong sizeof()");
+
+	// Data frame and time of its reception (millis())
+	// Handy element type for queues: jb::threads::spsc_ring<pmsx::PmsSample, 16> (spsc_ring.h)
+	template <typename Model>
+	struct BasicPmsSample {
+		unsigned long timestamp;
+		BasicPmsData<Model> data;
+	};
+
+	typedef BasicPmsSample<Pms5003> PmsSample;
 
 	enum class PmsCmd : __uint24 {
 		CMD_READ_DATA = __uint24{ 0x0000e2 },
@@ -227,7 +530,401 @@ namespace pmsx {
 		CMD_RESET = __uint24{ 0xffffff },
 	};
 
-	class Pms {
+	// State of a command queued by Pms::writeAsync()
+	enum class PmsCmdState : uint8_t {
+		UNKNOWN,
+		QUEUED,
+		BUSY,
+		DONE,
+		FAILED // not executed, or the sensor did not confirm it (no response frame)
+	};
+
+	// Compile time loop: body(0), body(1), ... body(Count - 1)
+	template <pmsIdx_t Index, pmsIdx_t Count>
+	struct PmsUnroll {
+		template <typename Body>
+		static void __attribute__((always_inline)) apply(Body&& body) {
+			body(Index);
+			PmsUnroll<Index + 1, Count>::apply(body);
+		}
+	};
+
+	template <pmsIdx_t Count>
+	struct PmsUnroll<Count, Count> {
+		template <typename Body>
+		static void __attribute__((always_inline)) apply(Body&&) {}
+	};
+
+	// Resumable frame parser: bytes are pushed in chunks of any size (single byte from ISR, whole buffer from epoll loop)
+	// Signature, length and partial payload are kept between calls, parser never waits for data
+	//
+	// Usage:
+	//   parser.feed(buffer, length, [](pmsx::PmsStatus status, const pmsx::PmsData& data) { ... });
+	//   handler is called once for every complete frame: OK, SUM_ERROR, FRAME_LENGTH_MISMATCH
+	//   data is valid only if status == PmsStatus::OK
+	//
+	// Resync: garbage is skipped using memchr(), the header (signature + length) is verified before payload is collected
+	//   response frames (after write command) are verified and kept as getResponse(), they are not passed to handler
+	//   after SUM_ERROR the frame (or bad response frame) is scanned again for the next signature
+	//   getSkipped() counts bytes which did not belong to any data frame
+	//
+	// PmsParser: PMS5003, other models: BasicPmsParser<Model>
+	template <typename Model>
+	class BasicPmsParser {
+	public:
+		static constexpr uint8_t SIG0 = 0x42;
+		static constexpr uint8_t SIG1 = 0x4D;
+		static constexpr size_t HEADER_SIZE = 2 + sizeof(pmsData_t); // signature + frame length
+		typedef BasicPmsData<Model> data_t;
+	private:
+		static constexpr size_t RESPONSE_LENGTH = data_t::RESPONSE_FRAME_SIZE - HEADER_SIZE;
+
+		uint8_t frame[data_t::FRAME_SIZE];
+		uint8_t received;
+		uint8_t expected; // size of the frame being collected: data frame or response frame
+		unsigned long skipped;
+		PmsCmd response; // echoed command of the last valid response frame
+		unsigned long responses;
+
+		void restartFromLength() {
+			// Length field could be a beginning of the next frame
+			if (frame[3] == SIG0) {
+				frame[0] = SIG0;
+				received = 1;
+			} else if (frame[2] == SIG0 && frame[3] == SIG1) {
+				frame[0] = SIG0;
+				frame[1] = SIG1;
+				received = 2;
+			} else {
+				received = 0;
+			}
+			skipped += HEADER_SIZE - received;
+		}
+
+		template <typename Handler>
+		void pushHeader(const uint8_t value, Handler& handler) {
+			switch (received) {
+			case 0:
+				if (value != SIG0) {
+					++skipped;
+					return;
+				}
+				break;
+			case 1:
+				if (value == SIG0) {
+					++skipped;
+					return;
+				}
+				if (value != SIG1) {
+					received = 0;
+					skipped += 2;
+					return;
+				}
+				break;
+			default:
+				break;
+			}
+			frame[received++] = value;
+
+			if (received < HEADER_SIZE) {
+				return;
+			}
+			const auto length = getFrameLength(frame);
+			if (length == RESPONSE_LENGTH) {
+				expected = data_t::RESPONSE_FRAME_SIZE;
+			} else if (length != data_t::FRAME_SIZE - HEADER_SIZE) {
+				data_t data{};
+				handler(PmsStatus{ PmsStatus::FRAME_LENGTH_MISMATCH }, static_cast<const data_t&>(data));
+				restartFromLength();
+			}
+		}
+
+		static pmsData_t getFrameLength(const uint8_t* frame) {
+			return static_cast<pmsData_t>((frame[2] << 8) | frame[3]);
+		}
+
+		// Response frame: signature, length, command byte, command data (low byte), checksum
+		template <typename Handler>
+		void completeResponse(Handler& handler) {
+			uint16_t sum = 0;
+			for (size_t i = 0; i < data_t::RESPONSE_FRAME_SIZE - sizeof(pmsData_t); ++i) {
+				sum += frame[i];
+			}
+			if (sum == static_cast<uint16_t>((frame[6] << 8) | frame[7])) {
+				response = static_cast<PmsCmd>(static_cast<__uint24>(frame[4]) | static_cast<__uint24>(frame[5]) << 16);
+				++responses;
+				skipped += data_t::RESPONSE_FRAME_SIZE;
+				return;
+			}
+			// Rescan: shorter than a response frame, the nested call completes no frame and does not recurse further
+			uint8_t rest[data_t::RESPONSE_FRAME_SIZE - 1];
+			memcpy(rest, frame + 1, sizeof rest);
+			++skipped;
+			feed(rest, sizeof rest, handler);
+		}
+
+	public:
+		// Decodes the whole frame (data_t::FRAME_SIZE bytes, starting with signature)
+		// Checksum and big endian conversion of all data words are done in a single pass, unrolled for Model::DATA_SIZE words
+		static PmsStatus decode(const uint8_t* frame, data_t& data) {
+			if (frame[0] != SIG0 || frame[1] != SIG1) {
+				return PmsStatus{ PmsStatus::READ_ERROR };
+			}
+			if (getFrameLength(frame) != data_t::FRAME_SIZE - HEADER_SIZE) {
+				return PmsStatus{ PmsStatus::FRAME_LENGTH_MISMATCH };
+			}
+
+			uint16_t sum = frame[0] + frame[1] + frame[2] + frame[3];
+			PmsUnroll<0, data_t::DATA_SIZE>::apply([frame, &sum, &data](const pmsIdx_t i) {
+				const uint8_t* word = frame + HEADER_SIZE + i * sizeof(pmsData_t);
+				sum += word[0] + word[1];
+				data.raw[i] = static_cast<pmsData_t>((word[0] << 8) | word[1]);
+			});
+			const uint8_t* word = frame + HEADER_SIZE + data_t::DATA_SIZE * sizeof(pmsData_t);
+			const pmsData_t crc = static_cast<pmsData_t>((word[0] << 8) | word[1]);
+
+			return PmsStatus{ sum == crc ? PmsStatus::OK : PmsStatus::SUM_ERROR };
+		}
+
+	public:
+		BasicPmsParser() : received(0), expected(data_t::FRAME_SIZE), skipped(0), response(PmsCmd::CMD_RESET), responses(0) {}
+
+		void reset() {
+			received = 0;
+			expected = data_t::FRAME_SIZE;
+		}
+
+		// Number of bytes skipped while looking for data frames: garbage, response frames, headers and rejected frames
+		unsigned long getSkipped() const {
+			return skipped;
+		}
+
+		// true if there is no partial frame waiting for the rest of bytes
+		bool isIdle() const {
+			return received == 0;
+		}
+
+		// number of bytes of the partial frame kept by the parser
+		size_t pending() const {
+			return received;
+		}
+
+		// Number of valid response frames, compare it to detect a new one
+		unsigned long getResponseCount() const {
+			return responses;
+		}
+
+		// Command echoed by the last valid response frame (CMD_MODE_PASSIVE, CMD_MODE_ACTIVE, CMD_SLEEP), CMD_RESET if there was none
+		PmsCmd getResponse() const {
+			return response;
+		}
+
+		template <typename Handler>
+		void feed(const uint8_t* data, size_t length, Handler&& handler) {
+			while (length > 0) {
+				if (received == 0) {
+					const auto found = static_cast<const uint8_t*>(memchr(data, SIG0, length));
+					const size_t garbage = found == nullptr ? length : static_cast<size_t>(found - data);
+					skipped += garbage;
+					data += garbage;
+					length -= garbage;
+					if (length == 0) {
+						break;
+					}
+				}
+
+				if (received < HEADER_SIZE) {
+					pushHeader(*data++, handler);
+					--length;
+					continue;
+				}
+
+				const auto toCopy = min(length, static_cast<size_t>(expected - received));
+				memcpy(frame + received, data, toCopy);
+				data += toCopy;
+				length -= toCopy;
+				received += toCopy;
+
+				if (received == data_t::RESPONSE_FRAME_SIZE && expected == data_t::RESPONSE_FRAME_SIZE) {
+					received = 0;
+					expected = data_t::FRAME_SIZE;
+					completeResponse(handler);
+				} else if (received == data_t::FRAME_SIZE) {
+					received = 0;
+					data_t decoded;
+					const auto status = decode(frame, decoded);
+					handler(status, static_cast<const data_t&>(decoded));
+					if (status == PmsStatus::SUM_ERROR) {
+						// Bad frame could hide the beginning of the next one (truncated frame followed by a good one)
+						// Recursion depth is bounded: the re-fed span is shorter than a frame, the nested call can not complete a data frame.
+						// It may complete a response frame: the rescan of a bad response (completeResponse()) re-feeds RESPONSE_FRAME_SIZE - 1 bytes,
+						// shorter than a response frame, which complete nothing. At most two nested levels
+						uint8_t rest[data_t::FRAME_SIZE - 1];
+						memcpy(rest, frame + 1, sizeof rest);
+						++skipped;
+						feed(rest, sizeof rest, handler);
+					}
+				}
+			}
+		}
+	};
+
+	template <typename Model>
+	constexpr uint8_t BasicPmsParser<Model>::SIG0;
+
+	template <typename Model>
+	constexpr uint8_t BasicPmsParser<Model>::SIG1;
+
+	template <typename Model>
+	constexpr size_t BasicPmsParser<Model>::HEADER_SIZE;
+
+	typedef BasicPmsParser<Pms5003> PmsParser;
+
+	// Instrumentation of Pms (#define PMS_INSTRUMENTATION in pmsConfig.h)
+	//   counters: every PmsStatus returned by read(), complete frames, skipped bytes, commands sent and failed
+	//   histograms: interval between frames, latency from CMD_READ_DATA to the frame
+	// Without PMS_INSTRUMENTATION Pms derives from empty PmsNoInstrumentation: no RAM, no code
+
+	// Fixed buckets, bucket i counts values (ms) in range [2^(i-1), 2^i), bucket 0: value 0, the last bucket: everything above
+	class PmsHistogram {
+	public:
+		static constexpr uint8_t BUCKETS = 16;
+	private:
+		uint32_t counts[BUCKETS];
+	public:
+		PmsHistogram() : counts{} {}
+
+		void add(unsigned long value) {
+			uint8_t bucket = 0;
+			for (; value != 0 && bucket < BUCKETS - 1; value >>= 1) {
+				++bucket;
+			}
+			++counts[bucket];
+		}
+
+		uint32_t getCount(const uint8_t bucket) const {
+			return counts[bucket];
+		}
+
+		// Values in the bucket are lower than the limit (the last bucket: no limit)
+		static unsigned long getLimit(const uint8_t bucket) {
+			return 1UL << bucket;
+		}
+
+		uint32_t getTotal() const {
+			uint32_t result = 0;
+			for (const auto count : counts) {
+				result += count;
+			}
+			return result;
+		}
+	};
+
+	struct PmsCounters {
+		uint32_t statuses[PmsStatus::NO_SERIAL + 1]; // indexed by PmsStatus, read() results
+		uint32_t frames; // complete frames: OK, SUM_ERROR, FRAME_LENGTH_MISMATCH
+		uint32_t skipped; // bytes dropped while looking for frames
+		uint32_t commandsSent;
+		uint32_t commandsFailed;
+		PmsHistogram frameInterval; // ms between consecutive OK frames (frame timestamps)
+		PmsHistogram readLatency; // ms from CMD_READ_DATA to completion of the frame (see Pms::getReadLatency())
+
+		PmsCounters() : statuses{}, frames(0), skipped(0), commandsSent(0), commandsFailed(0) {}
+	};
+
+	class PmsInstrumentation {
+		PmsCounters counters;
+		unsigned long lastFrame;
+		bool frameSeen;
+
+	protected:
+		PmsInstrumentation() : lastFrame(0), frameSeen(false) {}
+
+		void onStatus(const PmsStatus status) {
+			++counters.statuses[min(static_cast<uint8_t>(status), static_cast<uint8_t>(PmsStatus::NO_SERIAL))];
+		}
+
+		// timestamp: arrival of the first byte of the frame
+		void onFrame(const PmsStatus status, const unsigned long timestamp) {
+			++counters.frames;
+			if (status != PmsStatus::OK) {
+				return;
+			}
+			if (frameSeen) {
+				counters.frameInterval.add(timestamp - lastFrame);
+			}
+			lastFrame = timestamp;
+			frameSeen = true;
+		}
+
+		void onReadLatency(const unsigned long latency) {
+			counters.readLatency.add(latency);
+		}
+
+		void onSkipped(const unsigned long count) {
+			counters.skipped += count;
+		}
+
+		void onCommand(const PmsCmd, const bool success) {
+			++(success ? counters.commandsSent : counters.commandsFailed);
+		}
+
+	public:
+		static constexpr bool INSTRUMENTATION = true;
+
+		PmsCounters getCounters() const {
+			return counters;
+		}
+
+		void resetCounters() {
+			counters = PmsCounters();
+		}
+	};
+
+	class PmsNoInstrumentation {
+	protected:
+		void onStatus(const PmsStatus) {}
+
+		void onFrame(const PmsStatus, const unsigned long) {}
+
+		void onReadLatency(const unsigned long) {}
+
+		void onSkipped(const unsigned long) {}
+
+		void onCommand(const PmsCmd, const bool) {}
+
+	public:
+		static constexpr bool INSTRUMENTATION = false;
+
+		PmsCounters getCounters() const {
+			return PmsCounters();
+		}
+
+		void resetCounters() {}
+	};
+
+#if defined PMS_INSTRUMENTATION
+	typedef PmsInstrumentation PmsInstrumentationBase;
+#else
+	typedef PmsNoInstrumentation PmsInstrumentationBase;
+#endif
+
+	// PMS5003 sensor: Pms, other models: BasicPms<Model>
+	// SerialT: IPmsSerial (default) - any driver, virtual calls
+	//   concrete driver (for example BasicPms<Pms5003, PmsPosixSerial>): direct calls, inlined into read()
+	//   the driver does not need IPmsSerial at all: available(), peek(), read(), write(), ... are enough. See also PmsSerialAdapter
+	template <typename Model, typename SerialT = IPmsSerial>
+	class BasicPms : public PmsInstrumentationBase {
+	public:
+		typedef SerialT serial_t;
+		typedef BasicPmsData<Model> data_t;
+		typedef BasicPmsSample<Model> sample_t;
+		typedef BasicPmsParser<Model> parser_t;
+
+		typedef uint8_t cmdTicket_t;
+		typedef void (*cmdCallback_t)(PmsCmd cmd, PmsCmdState state, void* context);
+		static constexpr uint8_t CMD_QUEUE_SIZE = 4;
+
 	private:
 
 		bool dataReceived;
@@ -243,6 +940,7 @@ namespace pmsx {
 			modeSleep = jb::logic::tribool(jb::logic::unknown);
 			pinSleepMode.unSet();
 			pinReset.unSet();
+			parser.reset();
 		}
 
 	public:
@@ -289,35 +987,57 @@ namespace pmsx {
 	private:
 		const uint8_t sig[2]{ 0x42, 0x4D };
 		unsigned long timeout;
-		static constexpr auto TIMEOUT_ACK = 30U;  // Time to complete response after write command
+		static constexpr auto TIMEOUT_ACK = 30U;  // Limit of waiting for response frame after write command, the wait is over as soon as the response is parsed
 		static constexpr auto BAUD_RATE = 9600U; // used during begin()
 		static constexpr unsigned long RESET_DURATION = 33U; // See doHwReset()
 
-		jb::logic::compact_optional<IPmsSerial*, nullptr> pmsSerial;
+		jb::logic::compact_optional<SerialT*, nullptr> pmsSerial;
+		parser_t parser;
+		PmsStatus parsed; // outcome of a frame header parsed by available(), returned by the next read()
+		bool externalInput; // bytes come from receive(), the serial port is used only for writing
+		unsigned long inputReceived; // bytes passed to receive()
+
+		// Frame timing, see observeFrame()
+		unsigned long frameStart; // the earliest estimate of arrival of the first byte of the frame being received
+		unsigned long frameStartSkipped; // getSkipped() at the time of estimate: skipped bytes invalidate it
+		bool frameStartKnown;
+		bool readPending; // CMD_READ_DATA was sent, no frame completed since
+		unsigned long frameTimestamp;
+		unsigned long readRequested;
+		long readLatency;
+
+		// Passive timeout follows read latency, as TCP retransmission timeout (RFC 6298): smoothed latency + 4 * mean deviation
+		uint16_t latencyAverage; // * 8, 0: no measurement yet
+		uint16_t latencyDeviation; // * 4
+		uint16_t passiveTimeout;
 
 	public:
 		static constexpr decltype(timeout) TIMEOUT_PASSIVE = 68U;  // Transfer time of 1start + 32data + 1stop using 9600bps is 33 usec. TIMEOUT_PASSIVE could be at least 34, Value of 68 is an arbitrary doubled
+		static constexpr unsigned long TIMEOUT_PASSIVE_MAX = 1000U; // Limit of getPassiveTimeout()
 		static constexpr auto WAKEUP_TIME = 2500U; // Experimentally, time to get ready after reset/wakeup
 
-		Pms() : modeActive(jb::logic::tribool(jb::logic::unknown)), modeSleep(jb::logic::tribool(jb::logic::unknown)), timeout(TIMEOUT_PASSIVE) {
+		BasicPms() : modeActive(jb::logic::tribool(jb::logic::unknown)), modeSleep(jb::logic::tribool(jb::logic::unknown)), timeout(TIMEOUT_PASSIVE), parsed{ PmsStatus::NO_DATA }, externalInput(false), inputReceived(0),
+			frameStart(0), frameStartSkipped(0), frameStartKnown(false), readPending(false), frameTimestamp(0), readRequested(0), readLatency(-1),
+			latencyAverage(0), latencyDeviation(0), passiveTimeout(TIMEOUT_PASSIVE),
+			cmdQueue{}, cmdFirst(0), cmdCount(0), cmdTicket(0), cmdStep(CmdStep::START), cmdStarted(0), cmdDuration(0), cmdNeeded(0), cmdAcked(false), responsesSeen(0), cmdInputStart(0), cmdCallback(nullptr), cmdContext(nullptr) {
 			addSerial(nullptr);
 		};
 
-		explicit Pms(IPmsSerial* pmsSerial) : Pms() {
+		explicit BasicPms(SerialT* pmsSerial) : BasicPms() {
 			addSerial(pmsSerial);
 #if defined PMS_DYNAMIC
 			begin();
 #endif
 		}
 
-		~Pms() {
+		~BasicPms() {
 #if defined PMS_DYNAMIC
 			end();
 #endif
 			pmsSerial.unSet();
 		}
 
-		void addSerial(IPmsSerial* pmsSerial) {
+		void addSerial(SerialT* pmsSerial) {
 			clrState();
 			this->pmsSerial = pmsSerial;
 		}
@@ -372,10 +1092,6 @@ namespace pmsx {
 			}
 		}
 
-		static void sumBuffer(uint16_t* sum, const uint16_t data) {
-			*sum += (data & 0xFF) + (data >> 8);
-		}
-
 		////////////////////////////////////////
 
 	public:
@@ -390,111 +1106,290 @@ namespace pmsx {
 			return timeout;
 		}
 
+		// Bytes of the next frame: already collected by the parser and waiting in the serial buffer
+		// Garbage in front of the frame is dropped: bytes are passed to the parser till it finds the signature and a valid frame length
 		size_t available(void) {
 			if (!pmsSerial) {
 				return 0;
 			}
-			skipGarbage();
-			return pmsSerial->available();
+			if (externalInput) {
+				return parser.pending();
+			}
+			if (parser.isIdle()) {
+				prefetch();
+			}
+			const auto result = parser.pending() + pmsSerial->available();
+			observeFrame(result);
+			return result;
+		}
+
+		// Time of sending bytes at BAUD_RATE (start + 8 data + stop bits), ms, rounded down
+		static constexpr unsigned long getTransferTime(const size_t bytes) {
+			return bytes * 10000UL / BAUD_RATE;
+		}
+
+		// millis() at arrival of the first byte (signature) of the last frame returned by read() with PmsStatus::OK
+		// Estimated: when bytes of a frame are seen (available(), read()), the first one arrived at least transfer time of the bytes behind it ago
+		// The earliest estimate wins, delays of the loop do not matter as long as bytes keep coming (call available() or waitForData() often enough in passive mode)
+		unsigned long getFrameTimestamp() const {
+			return frameTimestamp;
+		}
+
+		// Milliseconds from sending CMD_READ_DATA to the last byte of the frame, -1 if not measured yet
+		// Compare with getPassiveTimeout()
+		long getReadLatency() const {
+			return readLatency;
+		}
+
+		// Time to wait for the frame after CMD_READ_DATA: waitForData(pms.getPassiveTimeout(), PmsData::FRAME_SIZE)
+		// TIMEOUT_PASSIVE till the first read latency is measured, then smoothed latency + 4 * its mean deviation (at least transfer time of a frame)
+		// Doubled (up to TIMEOUT_PASSIVE_MAX) by every CMD_READ_DATA sent while the previous one is still without a frame
+		decltype(timeout) getPassiveTimeout() const {
+			return passiveTimeout;
 		}
 
+		// Number of bytes dropped while looking for data frames (line noise, response frames, rejected frames)
+		unsigned long getSkipped() const {
+			return parser.getSkipped();
+		}
+
+		// Waits up to maxTime ms till available() >= nData (nData == 0: anything in the serial buffer)
+		// Sleeps in the serial driver (IPmsSerial::waitForInput()) till the first byte, then for the transfer time of the missing bytes
 		bool waitForData(unsigned int maxTime, size_t nData = 0) {
 			if (!pmsSerial) {
 				return false;
 			}
 
 			const auto t0 = millis();
-			if (nData == 0) {
-				for (; millis() - t0 < maxTime; delay(1)) {
-					if (pmsSerial->available()) {
-						return true;
-					}
-				}
-				return pmsSerial->available();
-			}
-
-			for (; millis() - t0 < maxTime; delay(1)) {
-				if (available() >= nData) {
+			for (;;) {
+				const size_t got = nData == 0 ? pmsSerial->available() : available();
+				if (got > 0 && got >= nData) {
 					return true;
 				}
+				const auto elapsed = millis() - t0;
+				if (elapsed >= maxTime) {
+					return false;
+				}
+				const auto left = maxTime - elapsed;
+				if (got == 0) {
+					if (!pmsSerial->waitForInput(left)) {
+						return false;
+					}
+				} else {
+					delay(min(left, getTransferTime(nData - got) + 1));
+				}
 			}
-			return available() >= nData;
 		}
 
-	private:
-		PmsStatus read(pmsData_t* data, size_t nData) {
+	public:
+		PmsStatus read(data_t& data) {
 			if (!pmsSerial) {
+				onStatus(PmsStatus{ PmsStatus::NO_SERIAL });
 				return PmsStatus{ PmsStatus::NO_SERIAL };
 			}
-
-			skipGarbage();
-
-			if (available() < (nData + 2) * sizeof*data + sizeof(sig)) {
+			if (externalInput) {
+				// Frames are delivered by receive()
 				return PmsStatus{ PmsStatus::NO_DATA };
 			}
 
-			pmsSerial->read(); // Due to previous skipGarbage(): value is equal to sig[0]. There is no need to check the value
-
-			if (pmsSerial->read() != sig[1]) {
-				return PmsStatus{ PmsStatus::READ_ERROR }; // The rest of the buffer will be invalidated during the next read attempt
+			// Chunks never exceed the rest of the current frame: at most one frame is completed, bytes of the next one stay in the serial buffer
+			// Bad frame header found by available() is reported first
+			PmsStatus result = parsed;
+			parsed = PmsStatus{ PmsStatus::NO_DATA };
+			bool completed = result != PmsStatus::NO_DATA;
+			const auto skippedBefore = parser.getSkipped();
+			if (!parser.isIdle()) {
+				observeFrame(parser.pending() + pmsSerial->available());
+			}
+			uint8_t chunk[data_t::FRAME_SIZE];
+			while (!completed) {
+				const auto toRead = min(pmsSerial->available(), data_t::FRAME_SIZE - parser.pending());
+				if (toRead == 0) {
+					break;
+				}
+				const auto done = pmsSerial->read(chunk, toRead);
+				parse(chunk, done, pmsSerial->available(), [&](const PmsStatus status, const data_t& decoded) {
+					result = status;
+					completed = true;
+					if (status == PmsStatus::OK) {
+						data = decoded;
+					}
+				});
+				if (done != toRead) {
+					if (!completed) {
+						result = PmsStatus{ PmsStatus::READ_ERROR };
+					}
+					break;
+				}
 			}
 
-			uint16_t sum{ 0 };
-			sumBuffer(&sum, (uint8_t *)&sig, sizeof(sig));
-
-			pmsData_t thisFrameLen{ 0 };
+			onSkipped(parser.getSkipped() - skippedBefore);
+			onStatus(result);
+			return result;
+		}
 
-			if (pmsSerial->read((uint8_t*)&thisFrameLen, sizeof thisFrameLen) != sizeof thisFrameLen) {
-				return PmsStatus{ PmsStatus::READ_ERROR };
+		// sample.timestamp: getFrameTimestamp()
+		PmsStatus read(sample_t& sample) {
+			const auto status = read(sample.data);
+			if (status == PmsStatus::OK) {
+				sample.timestamp = frameTimestamp;
 			}
+			return status;
+		}
 
-			sumBuffer(&sum, thisFrameLen);
-			swapEndianBig16(&thisFrameLen);
+		// The serial port is read by someone else (PmsGroup: one epoll loop for many sensors), bytes are passed to receive()
+		// Pms writes commands, but it never reads the port: read() returns NO_DATA, available() counts bytes kept by the parser,
+		// tick() takes response frames and the end of warm-up from receive()
+		void setExternalInput(const bool external) {
+			externalInput = external;
+			parsed = PmsStatus{ PmsStatus::NO_DATA };
+			parser.reset();
+			frameStartKnown = false;
+		}
 
-			size_t toRead{ thisFrameLen - sizeof thisFrameLen };
-			if (toRead > nData * sizeof*data) {
-				return PmsStatus{ PmsStatus::FRAME_LENGTH_MISMATCH };
+		bool hasExternalInput() const {
+			return externalInput;
+		}
+
+		// Bytes read from the serial port of the sensor (see setExternalInput()), parsed as by read():
+		// handler(PmsStatus status, const data_t& data) for every complete frame (data is valid only if status == PmsStatus::OK),
+		// frames are timed (getFrameTimestamp(), read latency) and counted, response frames go to the command pipeline
+		// Returns number of complete frames
+		template <typename Handler>
+		size_t receive(const uint8_t* bytes, size_t length, Handler&& handler) {
+			size_t frames = 0;
+			const auto skippedBefore = parser.getSkipped();
+			inputReceived += length;
+			if (!parser.isIdle()) {
+				observeFrame(parser.pending() + length);
 			}
+			// As read(): pieces never exceed the rest of the current frame, bytes behind the completed one are known
+			while (length > 0) {
+				const auto size = min(length, data_t::FRAME_SIZE - parser.pending());
+				length -= size;
+				parse(bytes, size, length, [&](const PmsStatus status, const data_t& data) {
+					++frames;
+					onStatus(status);
+					handler(status, data);
+				});
+				bytes += size;
+			}
+			onSkipped(parser.getSkipped() - skippedBefore);
+			return frames;
+		}
 
-			if (data != nullptr) {
-				if (pmsSerial->read((uint8_t*)data, toRead) != toRead) {
-					return PmsStatus{ PmsStatus::READ_ERROR };
+	private:
+		// Parses bytes of at most one frame, behind: bytes received after them
+		// handler(status, data) for every complete frame, the frame is timed and counted first; response frames go to the command pipeline
+		template <typename Handler>
+		void parse(const uint8_t* bytes, const size_t size, const size_t behind, Handler&& handler) {
+			parser.feed(bytes, size, [&](const PmsStatus status, const data_t& decoded) {
+				completeFrame(status, behind);
+				onFrame(status, frameTimestamp);
+				if (status == PmsStatus::OK) {
+					dataReceived = true;
 				}
-				sumBuffer(&sum, (uint8_t*)data, toRead);
+				handler(status, decoded);
+			});
+			takeResponse();
+		}
 
-				for (size_t i = 0; i < nData; ++i) {
-					swapEndianBig16(&data[i]);
+		// Resync of available(): bytes are passed to the parser (memchr() for the signature, frame length) till a frame starts
+		// A chunk is shorter than a frame, no data frame is completed here. Bad frame length is kept for read()
+		void prefetch() {
+			const auto skippedBefore = parser.getSkipped();
+			uint8_t chunk[data_t::FRAME_SIZE - 1];
+			while (parser.isIdle()) {
+				const auto toRead = min(pmsSerial->available(), sizeof chunk);
+				if (toRead == 0) {
+					break;
+				}
+				const auto done = pmsSerial->read(chunk, toRead);
+				// Only a rejected header completes here, it is not timed: bytes behind do not matter
+				parse(chunk, done, 0, [this](const PmsStatus status, const data_t&) {
+					parsed = status;
+				});
+				if (done != toRead) {
+					break;
 				}
 			}
+			onSkipped(parser.getSkipped() - skippedBefore);
+		}
 
-			pmsData_t crc;
-			for (; toRead < thisFrameLen; toRead += 2) {
-
-				if (pmsSerial->read((uint8_t*)&crc, sizeof crc) != sizeof crc) {
-					return PmsStatus{ PmsStatus::READ_ERROR };
-				}
+		// bytes: of the frame being received (parser and serial buffer) and all bytes behind it, the first one is the signature
+		// Bytes come back to back: the first one arrived at least getTransferTime(bytes - 1) ago
+		void observeFrame(const size_t bytes) {
+			if (bytes == 0) {
+				return;
+			}
+			const auto estimate = millis() - getTransferTime(bytes - 1);
+			const auto skippedNow = getSkipped();
+			if (!frameStartKnown || frameStartSkipped != skippedNow || static_cast<long>(estimate - frameStart) < 0) {
+				frameStart = estimate;
+				frameStartSkipped = skippedNow;
+				frameStartKnown = true;
+			}
+		}
 
-				if (toRead < thisFrameLen - 2) {
-					sumBuffer(&sum, crc);
+		// Called by the parser handler: the frame ends with the last byte parsed, behind: bytes received after it
+		void completeFrame(const PmsStatus status, const size_t behind) {
+			observeFrame(data_t::FRAME_SIZE + behind);
+			frameStartKnown = false;
+			if (status != PmsStatus::OK) {
+				return;
+			}
+			frameTimestamp = frameStart;
+			if (readPending) {
+				const auto received = frameTimestamp + getTransferTime(data_t::FRAME_SIZE - 1);
+				const auto latency = static_cast<long>(received - readRequested);
+				if (latency >= 0) {
+					readLatency = latency;
+					readPending = false;
+					updatePassiveTimeout(static_cast<unsigned long>(latency));
+					onReadLatency(static_cast<unsigned long>(latency));
 				}
 			}
+		}
 
-			swapEndianBig16(&crc);
-
-			if (sum != crc) {
-				return PmsStatus{ PmsStatus::SUM_ERROR };
+		// Integer version of RFC 6298: average += error / 8, deviation += (|error| - deviation) / 4
+		void updatePassiveTimeout(const unsigned long latency) {
+			const long sample = static_cast<long>(min(latency, TIMEOUT_PASSIVE_MAX));
+			if (latencyAverage == 0) {
+				latencyAverage = static_cast<uint16_t>(sample * 8);
+				latencyDeviation = static_cast<uint16_t>(sample * 2);
+			} else {
+				const long error = sample - latencyAverage / 8;
+				latencyAverage = static_cast<uint16_t>(latencyAverage + error);
+				latencyDeviation = static_cast<uint16_t>(latencyDeviation + (error < 0 ? -error : error) - latencyDeviation / 4);
 			}
+			const unsigned long result = latencyAverage / 8 + max(latencyDeviation, static_cast<uint16_t>(getTransferTime(1) + 1));
+			passiveTimeout = static_cast<uint16_t>(min(max(result, getTransferTime(data_t::FRAME_SIZE) + 1), TIMEOUT_PASSIVE_MAX));
+		}
 
-			dataReceived = true;
-			return PmsStatus{ PmsStatus::OK };
+		// Mode follows response frames: the echoed command is confirmed, also if its response comes late (parsed by read())
+		void applyResponse(const PmsCmd cmd) {
+			switch (cmd) {
+			case PmsCmd::CMD_MODE_PASSIVE:
+			case PmsCmd::CMD_MODE_ACTIVE:
+			case PmsCmd::CMD_SLEEP:
+				setNewMode(cmd);
+				break;
+			default:
+				return;
+			}
+			if (cmdStep == CmdStep::ACK && cmdCount > 0 && cmdQueue[cmdFirst].cmd == cmd) {
+				cmdAcked = true;
+			}
 		}
 
-	public:
-		PmsStatus read(PmsData& data) {
-			return read(reinterpret_cast<pmsData_t *>(&data.raw), data.raw.getSize());
+		// Applies a response frame completed by the parser since the previous call
+		void takeResponse() {
+			if (parser.getResponseCount() != responsesSeen) {
+				responsesSeen = parser.getResponseCount();
+				applyResponse(parser.getResponse());
+			}
 		}
 
-	private:
 		void setNewMode(const PmsCmd cmd) {
 			switch (cmd) {
 			case PmsCmd::CMD_MODE_PASSIVE:
@@ -516,56 +1411,75 @@ namespace pmsx {
 			}
 		}
 
-		bool doHwReset(const unsigned int wakeupTime) {
-			if (!pinReset) {
-				return false;
-			}
-			digitalWrite(pinReset, LOW);
-			delay(RESET_DURATION);
-			pmsSerial->flushInput();
-			digitalWrite(pinReset, HIGH);
-			setNewMode(PmsCmd::CMD_RESET);
-			dataReceived = false;
-			dataSent = false;
-			if (wakeupTime > 0) {
-				waitForData(wakeupTime, wakeupTime);
-				skipGarbage();
-			}
-			return true;
-		}
+		// Command pipeline: write() and writeAsync() share it, tick() moves it forward
+		// Steps: START -> PULSE (hardware pin) or ACK (serial command, response frame) -> WARMUP (after wakeup / reset) -> done
+		// ACK: bytes are parsed till the response frame echoing the command (data frames received meanwhile are dropped),
+		//   the mode is taken from the response. No response within TIMEOUT_ACK: the mode is unknown, the command FAILED
+		enum class CmdStep : uint8_t {
+			START,
+			PULSE,
+			ACK,
+			WARMUP
+		};
 
-		bool doHwSleep(const PmsCmd cmd, const unsigned int wakeupTime) {
-			if (!pinSleepMode) {
-				return false;
-			}
+		struct CmdSlot {
+			PmsCmd cmd;
+			unsigned int wakeupTime;
+			cmdTicket_t ticket;
+			PmsCmdState state;
+		};
 
-			digitalWrite(pinSleepMode, cmd == PmsCmd::CMD_SLEEP ? LOW : HIGH);
-			delay(RESET_DURATION);
-			pmsSerial->flushInput();
-			setNewMode(cmd);
-			if (cmd == PmsCmd::CMD_WAKEUP  && wakeupTime > 0) {
-				waitForData(wakeupTime, wakeupTime);
-				skipGarbage();
-			}
-			return true;
+		CmdSlot cmdQueue[CMD_QUEUE_SIZE];
+		uint8_t cmdFirst;
+		uint8_t cmdCount;
+		cmdTicket_t cmdTicket;
+		CmdStep cmdStep;
+		unsigned long cmdStarted;
+		unsigned long cmdDuration;
+		size_t cmdNeeded; // WARMUP: step is over when so many bytes are available
+		bool cmdAcked; // ACK: response frame to the command was parsed
+		unsigned long responsesSeen; // parser.getResponseCount() of the last applied response
+		unsigned long cmdInputStart; // inputReceived at the start of the step (external input)
+		cmdCallback_t cmdCallback;
+		void* cmdContext;
+
+		// Commands confirmed by a response frame. CMD_MODE_ACTIVE is answered as well, but data frames follow: its response is not waited for,
+		// read() confirms the mode when the response arrives
+		static bool needsAck(const PmsCmd cmd) {
+			return cmd == PmsCmd::CMD_MODE_PASSIVE || cmd == PmsCmd::CMD_SLEEP;
 		}
 
-	public:
-		bool write(PmsCmd cmd, unsigned int wakeupTime = WAKEUP_TIME) {
-			static_assert(sizeof cmd >= 3, "Wrong definition of PmsCmd (too short)");
+		void cmdWait(const CmdStep step, const unsigned long duration, const size_t needed = 0) {
+			cmdStep = step;
+			cmdStarted = millis();
+			cmdDuration = duration;
+			cmdNeeded = needed;
+			cmdInputStart = inputReceived;
+		}
 
-			if (cmd == PmsCmd::CMD_RESET) {
-				return doHwReset(wakeupTime);
+		bool cmdWaiting() {
+			if (millis() - cmdStarted >= cmdDuration) {
+				return false;
 			}
-
-			if ((cmd == PmsCmd::CMD_SLEEP || cmd == PmsCmd::CMD_WAKEUP) && doHwSleep(cmd, wakeupTime)) {
+			if (cmdNeeded == 0) {
 				return true;
 			}
+			return (externalInput ? inputReceived - cmdInputStart : available()) < cmdNeeded;
+		}
 
-			if (!pmsSerial) {
-				return false;
+		void cmdFinish(const PmsCmdState state) {
+			auto& slot = cmdQueue[cmdFirst];
+			slot.state = state;
+			cmdFirst = (cmdFirst + 1) % CMD_QUEUE_SIZE;
+			--cmdCount;
+			cmdStep = CmdStep::START;
+			onCommand(slot.cmd, state == PmsCmdState::DONE);
+			if (cmdCallback != nullptr) {
+				cmdCallback(slot.cmd, state, cmdContext);
 			}
+		}
 
+		bool sendCommand(const PmsCmd cmd) {
 			if (pmsSerial->write(sig, sizeof(sig)) != sizeof(sig)) {
 				return false;
 			}
@@ -579,37 +1493,238 @@ namespace pmsx {
 			sumBuffer(&sum, (uint8_t*)&cmd, cmdSize);
 			swapEndianBig16(&sum);
 
-			if (cmd != PmsCmd::CMD_READ_DATA && cmd != PmsCmd::CMD_MODE_ACTIVE) {
-				pmsSerial->flushInput();
+			if (needsAck(cmd)) {
+				flushInput();
 			}
 
-			if (pmsSerial->write((uint8_t*)&sum, sizeof sum) != sizeof sum) {
-				return false;
+			return pmsSerial->write((uint8_t*)&sum, sizeof sum) == sizeof sum;
+		}
+
+		// Returns false if the command can not be executed
+		bool cmdStart(const CmdSlot& slot) {
+			const auto cmd = slot.cmd;
+			if (cmd == PmsCmd::CMD_RESET) {
+				if (!pinReset || !pmsSerial) {
+					return false;
+				}
+				digitalWrite(pinReset, LOW);
+				cmdWait(CmdStep::PULSE, RESET_DURATION);
+				return true;
 			}
 
-			if (cmd != PmsCmd::CMD_READ_DATA && cmd != PmsCmd::CMD_MODE_ACTIVE) {
-				// sensor sometimes tries to send response frame, containing original command (2 bytes)
-				skipGarbage();
-				waitForData(TIMEOUT_ACK, PmsData::RESPONSE_FRAME_SIZE);
-				pmsSerial->flushInput();
+			if ((cmd == PmsCmd::CMD_SLEEP || cmd == PmsCmd::CMD_WAKEUP) && pinSleepMode && pmsSerial) {
+				digitalWrite(pinSleepMode, cmd == PmsCmd::CMD_SLEEP ? LOW : HIGH);
+				cmdWait(CmdStep::PULSE, RESET_DURATION);
+				return true;
+			}
+
+			if (!pmsSerial || !sendCommand(cmd)) {
+				return false;
+			}
+			if (cmd == PmsCmd::CMD_READ_DATA) {
+				if (readPending) {
+					// The previous request is still without a frame: back off
+					passiveTimeout = static_cast<uint16_t>(min(2UL * passiveTimeout, TIMEOUT_PASSIVE_MAX));
+				}
+				readRequested = millis();
+				readPending = true;
+			}
+			if (needsAck(cmd)) {
+				cmdAcked = false;
+				cmdWait(CmdStep::ACK, TIMEOUT_ACK);
+			} else {
+				cmdAfterAck(slot);
 			}
+			return true;
+		}
 
-			if ((cmd == PmsCmd::CMD_WAKEUP) && (wakeupTime > 0)) {
-				waitForData(wakeupTime, PmsData::RESPONSE_FRAME_SIZE);
-				skipGarbage();
+		void cmdAfterPulse(const CmdSlot& slot) {
+			flushInput();
+			if (slot.cmd == PmsCmd::CMD_RESET) {
+				digitalWrite(pinReset, HIGH);
+				dataReceived = false;
+				dataSent = false;
 			}
+			setNewMode(slot.cmd);
+			if (slot.cmd != PmsCmd::CMD_SLEEP && slot.wakeupTime > 0) {
+				// Warm-up is over when the first data frame arrives
+				cmdWait(CmdStep::WARMUP, slot.wakeupTime, data_t::FRAME_SIZE);
+			} else {
+				cmdFinish(PmsCmdState::DONE);
+			}
+		}
 
-			setNewMode(cmd);
+		// Parses available bytes till the response to the command, returns true if it was received
+		// External input: the response is taken by receive()
+		bool cmdReceiveAck() {
+			if (externalInput) {
+				return cmdAcked;
+			}
+			uint8_t chunk[data_t::RESPONSE_FRAME_SIZE];
+			const auto skippedBefore = parser.getSkipped();
+			while (!cmdAcked) {
+				const auto toRead = min(pmsSerial->available(), sizeof chunk);
+				if (toRead == 0) {
+					break;
+				}
+				const auto done = pmsSerial->read(chunk, toRead);
+				parser.feed(chunk, done, [](const PmsStatus, const data_t&) {});
+				takeResponse();
+				if (done != toRead) {
+					break;
+				}
+			}
+			onSkipped(parser.getSkipped() - skippedBefore);
+			return cmdAcked;
+		}
 
+		void cmdAfterAck(const CmdSlot& slot) {
+			if (slot.cmd == PmsCmd::CMD_MODE_ACTIVE) {
+				// Confirmed by its response (read())
+				modeActive = jb::logic::tribool(jb::logic::unknown);
+			} else if (!needsAck(slot.cmd)) {
+				setNewMode(slot.cmd);
+			}
 			dataSent = true;
-			return true;
+			if (slot.cmd == PmsCmd::CMD_WAKEUP && slot.wakeupTime > 0) {
+				cmdWait(CmdStep::WARMUP, slot.wakeupTime, data_t::RESPONSE_FRAME_SIZE);
+			} else {
+				cmdFinish(PmsCmdState::DONE);
+			}
+		}
+
+	public:
+		// Queues the command and returns immediately, tick() executes it
+		// Returns ticket (see getCmdState()), 0 if the queue is full
+		cmdTicket_t writeAsync(const PmsCmd cmd, const unsigned int wakeupTime = WAKEUP_TIME) {
+			static_assert(sizeof cmd >= 3, "Wrong definition of PmsCmd (too short)");
+
+			if (cmdCount == CMD_QUEUE_SIZE) {
+				return 0;
+			}
+			if (++cmdTicket == 0) {
+				++cmdTicket;
+			}
+			auto& slot = cmdQueue[(cmdFirst + cmdCount) % CMD_QUEUE_SIZE];
+			slot.cmd = cmd;
+			slot.wakeupTime = wakeupTime;
+			slot.ticket = cmdTicket;
+			slot.state = PmsCmdState::QUEUED;
+			++cmdCount;
+			return cmdTicket;
+		}
+
+		// Moves queued commands forward: toggles pins, sends command bytes, waits for response frame and warm-up without blocking
+		// Returns true while there are commands to complete
+		bool tick() {
+			while (cmdCount > 0) {
+				auto& slot = cmdQueue[cmdFirst];
+				switch (cmdStep) {
+				case CmdStep::START:
+					slot.state = PmsCmdState::BUSY;
+					if (!cmdStart(slot)) {
+						cmdFinish(PmsCmdState::FAILED);
+					}
+					break;
+				case CmdStep::PULSE:
+					if (millis() - cmdStarted < cmdDuration) {
+						return true;
+					}
+					cmdAfterPulse(slot);
+					break;
+				case CmdStep::ACK:
+					if (cmdReceiveAck()) {
+						cmdAfterAck(slot);
+						break;
+					}
+					if (millis() - cmdStarted < cmdDuration) {
+						return true;
+					}
+					// Do not assume the mode: a late response is applied by read()
+					if (slot.cmd == PmsCmd::CMD_SLEEP) {
+						modeSleep = jb::logic::tribool(jb::logic::unknown);
+					} else {
+						modeActive = jb::logic::tribool(jb::logic::unknown);
+					}
+					dataSent = true;
+					cmdFinish(PmsCmdState::FAILED);
+					break;
+				case CmdStep::WARMUP:
+					if (cmdWaiting()) {
+						return true;
+					}
+					cmdFinish(PmsCmdState::DONE);
+					break;
+				}
+			}
+			return false;
+		}
+
+		// QUEUED, BUSY, DONE, FAILED; UNKNOWN if the ticket is too old (its slot was reused)
+		PmsCmdState getCmdState(const cmdTicket_t ticket) const {
+			for (const auto& slot : cmdQueue) {
+				if (ticket != 0 && slot.ticket == ticket) {
+					return slot.state;
+				}
+			}
+			return PmsCmdState::UNKNOWN;
+		}
+
+		bool isCmdBusy() const {
+			return cmdCount > 0;
+		}
+
+		// Free slots of the command queue: writeAsync() returns 0 if there is none
+		uint8_t getCmdFree() const {
+			return static_cast<uint8_t>(CMD_QUEUE_SIZE - cmdCount);
+		}
+
+		// Milliseconds till tick() has something to do: 0 - now, -1 - command queue is empty
+		// ACK, WARMUP: upper limit, the step is over as soon as the expected bytes arrive
+		long getCmdWaitTime() const {
+			if (cmdCount == 0) {
+				return -1;
+			}
+			if (cmdStep == CmdStep::START || (cmdStep == CmdStep::ACK && cmdAcked)) {
+				return 0;
+			}
+			const auto elapsed = millis() - cmdStarted;
+			return elapsed >= cmdDuration ? 0 : static_cast<long>(cmdDuration - elapsed);
+		}
+
+		// Response frame parsed outside of Pms (by an own parser; bytes passed to receive() need no call): confirms the mode and the command waiting for it
+		void receiveResponse(const PmsCmd cmd) {
+			applyResponse(cmd);
+		}
+
+		// Called when a command is completed: callback(cmd, state, context), state is DONE or FAILED
+		void setCmdCallback(const cmdCallback_t callback, void* context = nullptr) {
+			cmdCallback = callback;
+			cmdContext = context;
+		}
+
+		// Blocking: waits till the command (and all queued before it) is completed
+		bool write(PmsCmd cmd, unsigned int wakeupTime = WAKEUP_TIME) {
+			while (cmdCount == CMD_QUEUE_SIZE && tick()) {
+				delay(1);
+			}
+			const auto ticket = writeAsync(cmd, wakeupTime);
+			if (ticket == 0) {
+				return false;
+			}
+			while (tick()) {
+				delay(1);
+			}
+			return getCmdState(ticket) == PmsCmdState::DONE;
 		}
 
 	private:
-		void skipGarbage() {
-			while ((pmsSerial->available()) && (pmsSerial->peek() != sig[0])) {
-				pmsSerial->read();
+		void flushInput() {
+			if (!externalInput) {
+				pmsSerial->flushInput();
 			}
+			parser.reset();
+			frameStartKnown = false;
 		}
 
 		void serialMonitor(unsigned long int duration) {
@@ -632,4 +1747,9 @@ namespace pmsx {
 		}
 
 	};
+
+	template <typename Model, typename SerialT>
+	constexpr unsigned long BasicPms<Model, SerialT>::TIMEOUT_PASSIVE_MAX;
+
+	typedef BasicPms<Pms5003> Pms;
 }
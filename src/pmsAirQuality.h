@@ -0,0 +1,308 @@
+#pragma once
+
+// Air quality indexes from PmsData::concentration (atmospheric PM2.5, PM10)
+//
+//   US EPA AQI (2024 breakpoints) of the 12-hour NowCast
+//   EU CAQI (hourly, background grid) of the last complete hour
+//
+// Frames are accumulated into the current hour (O(1) per frame, sums only). When the hour is over,
+// its average is pushed into a ring of 12 hourly averages and both indexes are computed once (12 steps).
+// Hours without frames are missing. NowCast needs 2 of the 3 most recent hours.
+// Hours are counted from the first update(), millis() rollover is handled.
+//
+// Usage:
+//   pmsx::PmsAirQuality airQuality;
+//   if (pms.read(data) == pmsx::PmsStatus::OK) {
+//       airQuality.update(data);
+//   }
+//   const auto aqi = airQuality.getAqi();
+//   if (aqi.isValid()) {
+//       Serial.print(aqi.index); Serial.print(pmsx::PmsAirQuality::getCategoryName(aqi.category));
+//   }
+//
+// RAM (AVR): about 70 bytes, integer arithmetic only
+
+#include <pms.h>
+
+namespace pmsx {
+
+	enum class PmsPollutant : uint8_t {
+		NONE, // not enough data
+		PM25,
+		PM10
+	};
+
+	// US EPA
+	enum class PmsAqiCategory : uint8_t {
+		AQI_GOOD,
+		AQI_MODERATE,
+		AQI_UNHEALTHY_FOR_SENSITIVE,
+		AQI_UNHEALTHY,
+		AQI_VERY_UNHEALTHY,
+		AQI_HAZARDOUS
+	};
+
+	// EU CAQI
+	enum class PmsCaqiCategory : uint8_t {
+		CAQI_VERY_LOW,
+		CAQI_LOW,
+		CAQI_MEDIUM,
+		CAQI_HIGH,
+		CAQI_VERY_HIGH
+	};
+
+	template <typename Category>
+	struct PmsAirIndex {
+		uint16_t index;
+		Category category;
+		PmsPollutant dominant; // pollutant with the highest sub-index, NONE: index is not available
+
+		bool isValid() const {
+			return dominant != PmsPollutant::NONE;
+		}
+	};
+
+	class PmsAirQuality {
+	public:
+		static constexpr unsigned long HOUR = 3600UL * 1000UL; // ms
+		static constexpr uint8_t HOURS = 12; // NowCast window
+		static constexpr uint16_t MISSING = 0xffffU; // concentration is not available
+
+	private:
+		// Concentrations in 0.1 micro g/m3, linear between (cLow, iLow) and (cHigh, iHigh)
+		struct Breakpoint {
+			uint16_t cLow;
+			uint16_t cHigh;
+			uint16_t iLow;
+			uint16_t iHigh;
+		};
+
+		// Row: first breakpoint with concentration <= cHigh, size if above the table (last row is extrapolated)
+		static uint16_t getSubIndex(const Breakpoint* table, const uint8_t size, const uint16_t concentration, uint8_t& row) {
+			row = 0;
+			while (row < size - 1 && concentration > table[row].cHigh) {
+				++row;
+			}
+			const Breakpoint& bp = table[row];
+			if (concentration > bp.cHigh) {
+				row = size;
+			}
+			const uint32_t cRange = bp.cHigh - bp.cLow;
+			const uint32_t delta = concentration > bp.cLow ? concentration - bp.cLow : 0;
+			const uint32_t index = bp.iLow + ((bp.iHigh - bp.iLow) * delta + cRange / 2) / cRange;
+			return index > 0xfffeU ? 0xfffeU : static_cast<uint16_t>(index);
+		}
+
+		// EPA: NowCast truncated to 0.1 (PM2.5) or 1 (PM10) micro g/m3
+		static uint16_t getAqiSubIndex(const PmsPollutant pollutant, const uint16_t concentration, uint8_t& row) {
+			static constexpr Breakpoint PM25[]{
+				{ 0, 90, 0, 50 }, { 91, 354, 51, 100 }, { 355, 554, 101, 150 },
+				{ 555, 1254, 151, 200 }, { 1255, 2254, 201, 300 }, { 2255, 3254, 301, 500 }
+			};
+			static constexpr Breakpoint PM10[]{
+				{ 0, 540, 0, 50 }, { 550, 1540, 51, 100 }, { 1550, 2540, 101, 150 },
+				{ 2550, 3540, 151, 200 }, { 3550, 4240, 201, 300 }, { 4250, 6040, 301, 500 }
+			};
+			if (pollutant == PmsPollutant::PM25) {
+				return getSubIndex(PM25, _countof(PM25), concentration, row);
+			}
+			return getSubIndex(PM10, _countof(PM10), concentration - concentration % 10, row);
+		}
+
+		// CAQI: hourly, background
+		static uint16_t getCaqiSubIndex(const PmsPollutant pollutant, const uint16_t concentration, uint8_t& row) {
+			static constexpr Breakpoint PM25[]{
+				{ 0, 150, 0, 25 }, { 150, 300, 25, 50 }, { 300, 550, 50, 75 }, { 550, 1100, 75, 100 }
+			};
+			static constexpr Breakpoint PM10[]{
+				{ 0, 250, 0, 25 }, { 250, 500, 25, 50 }, { 500, 900, 50, 75 }, { 900, 1800, 75, 100 }
+			};
+			if (pollutant == PmsPollutant::PM25) {
+				return getSubIndex(PM25, _countof(PM25), concentration, row);
+			}
+			return getSubIndex(PM10, _countof(PM10), concentration, row);
+		}
+
+		template <typename Category, typename SubIndex>
+		static PmsAirIndex<Category> getIndex(const uint16_t pm25, const uint16_t pm10, const uint8_t maxCategory, SubIndex subIndex) {
+			PmsAirIndex<Category> result{ 0, static_cast<Category>(0), PmsPollutant::NONE };
+			uint8_t row;
+			if (pm25 != MISSING) {
+				result.index = subIndex(PmsPollutant::PM25, pm25, row);
+				result.category = static_cast<Category>(min(row, maxCategory));
+				result.dominant = PmsPollutant::PM25;
+			}
+			if (pm10 != MISSING) {
+				const uint16_t index = subIndex(PmsPollutant::PM10, pm10, row);
+				if (result.dominant == PmsPollutant::NONE || index > result.index) {
+					result.index = index;
+					result.category = static_cast<Category>(min(row, maxCategory));
+					result.dominant = PmsPollutant::PM10;
+				}
+			}
+			return result;
+		}
+
+		// Hourly averages, 0.1 micro g/m3, [newest] is the last complete hour
+		uint16_t pm25[HOURS];
+		uint16_t pm10[HOURS];
+		uint8_t newest;
+
+		// Current hour
+		uint32_t sum25;
+		uint32_t sum10;
+		uint32_t count;
+		unsigned long hourStarted;
+		bool started;
+
+		uint16_t nowCast25;
+		uint16_t nowCast10;
+
+		static uint16_t getAverage(const uint32_t sum, const uint32_t count) {
+			if (count == 0) {
+				return MISSING;
+			}
+			const uint32_t average = (sum / count) * 10 + ((sum % count) * 10 + count / 2) / count;
+			return average >= MISSING ? MISSING - 1 : static_cast<uint16_t>(average);
+		}
+
+		void push(const uint16_t average25, const uint16_t average10) {
+			newest = (newest + 1) % HOURS;
+			pm25[newest] = average25;
+			pm10[newest] = average10;
+		}
+
+		// EPA NowCast: weight w = min / max (at least 1/2), c(i) weighted by w^i, i = 0: the newest hour
+		uint16_t getNowCast(const uint16_t* hours) const {
+			uint8_t recent = 0;
+			uint16_t minimum = MISSING;
+			uint16_t maximum = 0;
+			for (uint8_t i = 0; i < HOURS; ++i) {
+				const uint16_t value = hours[(newest + HOURS - i) % HOURS];
+				if (value == MISSING) {
+					continue;
+				}
+				recent += i < 3 ? 1 : 0;
+				minimum = min(minimum, value);
+				maximum = max(maximum, value);
+			}
+			if (recent < 2) {
+				return MISSING;
+			}
+			// 1/65536 units
+			uint32_t weight = maximum == 0 ? 0x10000UL : (static_cast<uint32_t>(minimum) << 16) / maximum;
+			weight = max(weight, static_cast<uint32_t>(0x8000UL));
+
+			uint64_t numerator = 0;
+			uint64_t denominator = 0;
+			uint32_t factor = 0x10000UL;
+			for (uint8_t i = 0; i < HOURS; ++i) {
+				const uint16_t value = hours[(newest + HOURS - i) % HOURS];
+				if (value != MISSING) {
+					numerator += static_cast<uint64_t>(factor) * value;
+					denominator += factor;
+				}
+				factor = static_cast<uint32_t>((static_cast<uint64_t>(factor) * weight) >> 16);
+			}
+			return static_cast<uint16_t>(numerator / denominator); // truncated, as EPA does
+		}
+
+		void closeHours(const unsigned long now) {
+			const unsigned long elapsed = (now - hourStarted) / HOUR;
+			if (elapsed == 0) {
+				return;
+			}
+			push(getAverage(sum25, count), getAverage(sum10, count));
+			for (unsigned long i = 1; i < elapsed && i < HOURS; ++i) {
+				push(MISSING, MISSING);
+			}
+			hourStarted += elapsed * HOUR;
+			sum25 = 0;
+			sum10 = 0;
+			count = 0;
+			nowCast25 = getNowCast(pm25);
+			nowCast10 = getNowCast(pm10);
+		}
+
+	public:
+		PmsAirQuality() {
+			reset();
+		}
+
+		void reset() {
+			for (uint8_t i = 0; i < HOURS; ++i) {
+				pm25[i] = MISSING;
+				pm10[i] = MISSING;
+			}
+			newest = 0;
+			sum25 = 0;
+			sum10 = 0;
+			count = 0;
+			hourStarted = 0;
+			started = false;
+			nowCast25 = MISSING;
+			nowCast10 = MISSING;
+		}
+
+		// Adds a frame (PmsStatus::OK) to the current hour
+		template <typename Model>
+		void update(const BasicPmsData<Model>& data, const unsigned long now = millis()) {
+			if (!started) {
+				started = true;
+				hourStarted = now;
+			}
+			closeHours(now);
+			sum25 += data.concentration.getValue(1);
+			sum10 += data.concentration.getValue(2);
+			++count;
+		}
+
+		// Closes hours without frames (sensor sleeps or fails), optional: update() does it as well
+		void advance(const unsigned long now = millis()) {
+			if (started) {
+				closeHours(now);
+			}
+		}
+
+		// 12-hour NowCast, 0.1 micro g/m3, MISSING if not available
+		uint16_t getNowCast(const PmsPollutant pollutant) const {
+			return pollutant == PmsPollutant::PM25 ? nowCast25 : pollutant == PmsPollutant::PM10 ? nowCast10 : MISSING;
+		}
+
+		// Average of the last complete hour, 0.1 micro g/m3, MISSING if not available
+		uint16_t getHourly(const PmsPollutant pollutant) const {
+			return pollutant == PmsPollutant::PM25 ? pm25[newest] : pollutant == PmsPollutant::PM10 ? pm10[newest] : MISSING;
+		}
+
+		// US EPA AQI (0..500, extrapolated above) of the NowCast
+		PmsAirIndex<PmsAqiCategory> getAqi() const {
+			return getIndex<PmsAqiCategory>(nowCast25, nowCast10, static_cast<uint8_t>(PmsAqiCategory::AQI_HAZARDOUS), getAqiSubIndex);
+		}
+
+		// EU CAQI (0..100, above 100: very high) of the last complete hour
+		PmsAirIndex<PmsCaqiCategory> getCaqi() const {
+			return getIndex<PmsCaqiCategory>(pm25[newest], pm10[newest], static_cast<uint8_t>(PmsCaqiCategory::CAQI_VERY_HIGH), getCaqiSubIndex);
+		}
+
+		static const char* getCategoryName(const PmsAqiCategory category) {
+			static const char* names[]{
+				"Good", "Moderate", "Unhealthy for Sensitive Groups", "Unhealthy", "Very Unhealthy", "Hazardous"
+			};
+			return names[min(static_cast<uint8_t>(category), static_cast<uint8_t>(_countof(names) - 1))];
+		}
+
+		static const char* getCategoryName(const PmsCaqiCategory category) {
+			static const char* names[]{
+				"Very low", "Low", "Medium", "High", "Very high"
+			};
+			return names[min(static_cast<uint8_t>(category), static_cast<uint8_t>(_countof(names) - 1))];
+		}
+
+		static const char* getPollutantName(const PmsPollutant pollutant) {
+			static const char* names[]{
+				"none", "PM2.5", "PM10"
+			};
+			return names[min(static_cast<uint8_t>(pollutant), static_cast<uint8_t>(_countof(names) - 1))];
+		}
+	};
+}
@@ -0,0 +1,315 @@
+#pragma once
+
+// Offline decoding of raw serial captures: byte buffer in, structure of arrays out
+//
+// BasicPmsCaptureDecoder<Model> finds every valid data frame of a buffer, the same frames PmsParser would find:
+//   signature is located using memchr(), header (signature + frame length) is verified, checksum is verified by a vectorized kernel
+//   (SSE2: sum of absolute differences against zero, scalar fallback elsewhere), a rejected frame is scanned again from its second byte
+//   response frames are verified by their checksum as well, a bad one is scanned again from its second byte
+//   decoded words are written into columns: one contiguous pmsData_t array per channel, plus byte offset of every frame
+//
+// Columns are owned by the caller, decoding stops when they are full. Inputs of any size are decoded in chunks:
+//   pmsx::PmsCaptureDecoder decoder(columns, offsets, capacity);
+//   for (size_t done = 0; done < size; ) {
+//       const size_t used = decoder.decode(data + done, size - done, done);
+//       ... use decoder.getFrames() rows of columns, then decoder.clear()
+//       if (used == 0) break; // the rest is shorter than a frame
+//       done += used;
+//   }
+//   decoder.finish(); // incomplete frame at the end of the capture is counted as skipped
+//
+// Columns should not be spaced by a power of two (capacity 65536 in one array): stores of a frame would fall into the same cache set
+//
+// Raw captures have no timestamps: offsets locate frames inside of the capture (time = offset / bytes per second, index of a recording)
+//
+// PmsCaptureFile: POSIX only (PMS_POSIX), capture file is memory mapped for a sequential scan
+
+#include <pms.h>
+
+#if defined __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if defined PMS_POSIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace pmsx {
+
+	// Outcome of decoding, bytes and frames since the last resetCounters()
+	struct PmsCaptureCounters {
+		uint64_t frames; // valid data frames
+		uint64_t sumErrors;
+		uint64_t lengthMismatches; // signature followed by unexpected frame length
+		uint64_t responses; // response frames (after write command)
+		uint64_t skipped; // bytes outside of valid data frames
+	};
+
+	template <typename Model>
+	class BasicPmsCaptureDecoder {
+	public:
+		typedef BasicPmsData<Model> data_t;
+		typedef BasicPmsParser<Model> parser_t;
+
+		static constexpr size_t FRAME_SIZE = data_t::FRAME_SIZE;
+		static constexpr size_t HEADER_SIZE = parser_t::HEADER_SIZE;
+		static constexpr size_t SUM_SIZE = FRAME_SIZE - sizeof(pmsData_t); // checksum covers everything but itself
+
+	private:
+		pmsData_t* const* columns;
+		uint64_t* offsets;
+		size_t capacity;
+		size_t frames;
+		size_t pending; // bytes left by the previous decode(), not counted yet
+		PmsCaptureCounters counters;
+
+		static uint16_t sumFrame(const uint8_t* frame) {
+#if defined __SSE2__
+			return sumVector(frame);
+#else
+			return sumScalar(frame);
+#endif
+		}
+
+		static pmsData_t getWord(const uint8_t* word) {
+			return static_cast<pmsData_t>((word[0] << 8) | word[1]);
+		}
+
+		// Checksum of a response frame (RESPONSE_FRAME_SIZE bytes are readable)
+		static bool isResponse(const uint8_t* frame) {
+			uint16_t sum = 0;
+			for (size_t i = 0; i < data_t::RESPONSE_FRAME_SIZE - sizeof(pmsData_t); ++i) {
+				sum += frame[i];
+			}
+			return sum == getWord(frame + data_t::RESPONSE_FRAME_SIZE - sizeof(pmsData_t));
+		}
+
+		void store(const uint8_t* frame, const uint64_t offset) {
+			const size_t row = frames++;
+			pmsData_t* const* const columns = this->columns;
+			PmsUnroll<0, data_t::DATA_SIZE>::apply([frame, row, columns](const pmsIdx_t i) {
+				columns[i][row] = getWord(frame + HEADER_SIZE + i * sizeof(pmsData_t));
+			});
+			if (offsets != nullptr) {
+				offsets[row] = offset;
+			}
+		}
+
+	public:
+		// Sum of SUM_SIZE bytes of a frame (FRAME_SIZE bytes are readable): the scalar kernel
+		static uint16_t sumScalar(const uint8_t* frame) {
+			uint16_t sum = 0;
+			for (size_t i = 0; i < SUM_SIZE; ++i) {
+				sum += frame[i];
+			}
+			return sum;
+		}
+
+#if defined __SSE2__
+		// The same sum by the SSE2 kernel, used by decode()
+		static uint16_t sumVector(const uint8_t* frame) {
+			// 16 x 0xff, 16 x 0: loaded from [16 - n], the first n bytes are kept
+			static const uint8_t MASK[32]{
+				0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+			};
+			const __m128i zero = _mm_setzero_si128();
+			__m128i total = zero;
+			size_t i = 0;
+			for (; i + 16 <= FRAME_SIZE; i += 16) {
+				__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(frame + i));
+				if (i + 16 > SUM_SIZE) {
+					bytes = _mm_and_si128(bytes, _mm_loadu_si128(reinterpret_cast<const __m128i*>(MASK + 16 - (SUM_SIZE - i))));
+				}
+				total = _mm_add_epi64(total, _mm_sad_epu8(bytes, zero));
+			}
+			uint32_t sum = static_cast<uint32_t>(_mm_cvtsi128_si32(total) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(total, total)));
+			for (; i < SUM_SIZE; ++i) {
+				sum += frame[i];
+			}
+			return static_cast<uint16_t>(sum);
+		}
+#endif
+
+		// columns: data_t::DATA_SIZE arrays, capacity items each (nullptr: frames are validated and counted only), offsets: capacity items (or nullptr)
+		BasicPmsCaptureDecoder(pmsData_t* const* columns, uint64_t* offsets, const size_t capacity) :
+			columns(columns), offsets(offsets), capacity(capacity), frames(0), pending(0), counters{} {
+		}
+
+		BasicPmsCaptureDecoder(const BasicPmsCaptureDecoder&) = delete;
+		BasicPmsCaptureDecoder& operator=(const BasicPmsCaptureDecoder&) = delete;
+
+		// Decodes frames from buffer till columns are full, returns the number of consumed bytes
+		// Less than length: columns are full, or the rest (shorter than a frame) should be passed again with more bytes
+		// base: offset of the buffer inside of the capture, added to frame offsets
+		size_t decode(const uint8_t* buffer, const size_t length, const uint64_t base = 0) {
+			const uint8_t* position = buffer;
+			const uint8_t* const end = buffer + length;
+			pending = 0;
+			while (frames < capacity) {
+				// Frames usually follow each other: memchr() only after garbage
+				const auto found = position < end && *position == parser_t::SIG0 ? position : static_cast<const uint8_t*>(memchr(position, parser_t::SIG0, static_cast<size_t>(end - position)));
+				if (found == nullptr) {
+					counters.skipped += static_cast<size_t>(end - position);
+					position = end;
+					break;
+				}
+				counters.skipped += static_cast<size_t>(found - position);
+				position = found;
+
+				const size_t left = static_cast<size_t>(end - position);
+				if (left < HEADER_SIZE) {
+					break;
+				}
+				if (position[1] != parser_t::SIG1) {
+					++counters.skipped;
+					++position;
+					continue;
+				}
+				const pmsData_t frameLength = getWord(position + 2);
+				if (frameLength == data_t::RESPONSE_FRAME_SIZE - HEADER_SIZE) {
+					if (left < data_t::RESPONSE_FRAME_SIZE) {
+						break;
+					}
+					if (!isResponse(position)) {
+						// As PmsParser: a false response header could hide the beginning of a data frame
+						++counters.skipped;
+						++position;
+						continue;
+					}
+					++counters.responses;
+					counters.skipped += data_t::RESPONSE_FRAME_SIZE;
+					position += data_t::RESPONSE_FRAME_SIZE;
+					continue;
+				}
+				if (frameLength != FRAME_SIZE - HEADER_SIZE) {
+					++counters.lengthMismatches;
+					++counters.skipped;
+					++position;
+					continue;
+				}
+				if (left < FRAME_SIZE) {
+					break;
+				}
+				if (sumFrame(position) != getWord(position + SUM_SIZE)) {
+					++counters.sumErrors;
+					++counters.skipped;
+					++position;
+					continue;
+				}
+				if (columns != nullptr) {
+					store(position, base + static_cast<uint64_t>(position - buffer));
+				} else {
+					++frames;
+				}
+				++counters.frames;
+				position += FRAME_SIZE;
+			}
+			pending = static_cast<size_t>(end - position);
+			return static_cast<size_t>(position - buffer);
+		}
+
+		// End of the capture: bytes left by the last decode() are skipped
+		void finish() {
+			counters.skipped += pending;
+			pending = 0;
+		}
+
+		// Rows of columns filled since the last clear()
+		size_t getFrames() const {
+			return frames;
+		}
+
+		bool isFull() const {
+			return frames >= capacity;
+		}
+
+		// Columns were consumed, counters are kept
+		void clear() {
+			frames = 0;
+		}
+
+		const PmsCaptureCounters& getCounters() const {
+			return counters;
+		}
+
+		void resetCounters() {
+			counters = PmsCaptureCounters{};
+		}
+	};
+
+	template <typename Model>
+	constexpr size_t BasicPmsCaptureDecoder<Model>::FRAME_SIZE;
+
+	template <typename Model>
+	constexpr size_t BasicPmsCaptureDecoder<Model>::HEADER_SIZE;
+
+	template <typename Model>
+	constexpr size_t BasicPmsCaptureDecoder<Model>::SUM_SIZE;
+
+	typedef BasicPmsCaptureDecoder<Pms5003> PmsCaptureDecoder;
+
+#if defined PMS_POSIX
+
+	// Read only memory mapped capture file, pages are read ahead for a sequential scan
+	class PmsCaptureFile {
+		const uint8_t* data;
+		size_t size;
+
+	public:
+		PmsCaptureFile() : data(nullptr), size(0) {}
+
+		~PmsCaptureFile() {
+			close();
+		}
+
+		PmsCaptureFile(const PmsCaptureFile&) = delete;
+		PmsCaptureFile& operator=(const PmsCaptureFile&) = delete;
+
+		bool open(const char* path) {
+			close();
+			const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+			if (fd < 0) {
+				return false;
+			}
+			struct stat info;
+			if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+				::close(fd);
+				return false;
+			}
+			void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			::close(fd);
+			if (mapped == MAP_FAILED) {
+				return false;
+			}
+			data = static_cast<const uint8_t*>(mapped);
+			size = static_cast<size_t>(info.st_size);
+			madvise(const_cast<uint8_t*>(data), size, MADV_SEQUENTIAL);
+			return true;
+		}
+
+		void close() {
+			if (data != nullptr) {
+				munmap(const_cast<uint8_t*>(data), size);
+			}
+			data = nullptr;
+			size = 0;
+		}
+
+		bool isOpen() const {
+			return data != nullptr;
+		}
+
+		const uint8_t* getData() const {
+			return data;
+		}
+
+		size_t getSize() const {
+			return size;
+		}
+	};
+
+#endif
+}
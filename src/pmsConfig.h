@@ -4,14 +4,20 @@
 
 // Use one of:
 // it depends on Serial Library (and serial pin connection)
+//   PMS_ALTSOFTSERIAL: Arduino boards
+//   PMS_POSIX: Linux/POSIX hosts (tty/pty), defined by CMakeLists.txt
 
+#if ! defined PMS_POSIX
 #define PMS_ALTSOFTSERIAL
+#endif
 
 #if defined PMS_ALTSOFTSERIAL
 // Install https://github.com/DrDiettrich/AltSoftSerial.git)
 #include <pmsSerialAltSoftSerial.h>
+#elif defined PMS_POSIX
+#include <pmsSerialPosix.h>
 #else
-#error "At least one of: [ PMS_ALTSOFTSERIAL ] have to be defined in pmsConfig.h"
+#error "At least one of: [ PMS_ALTSOFTSERIAL, PMS_POSIX ] have to be defined in pmsConfig.h"
 #endif
 
 ////////////////////////////////////////////
@@ -29,3 +35,13 @@
 // #define PMS_DYNAMIC
 
 ////////////////////////////////////////////
+
+// Use PMS_INSTRUMENTATION to collect counters and histograms inside Pms (see PmsCounters in pms.h)
+//   read() results (every PmsStatus), complete frames, skipped bytes, commands sent and failed
+//   histograms: interval between frames, CMD_READ_DATA to frame latency
+//   pms.getCounters() returns a snapshot, pms.resetCounters() starts from zero
+// Without PMS_INSTRUMENTATION: no code, no RAM (about 180 bytes with it)
+
+// #define PMS_INSTRUMENTATION
+
+////////////////////////////////////////////
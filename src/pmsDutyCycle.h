@@ -0,0 +1,289 @@
+#pragma once
+
+// Duty cycle sampling: sensor sleeps most of the time, one averaged reading per period
+//
+// Cycle:
+//   WAKING   - CMD_WAKEUP is sent (writeAsync(), hardware pin if configured)
+//   WARMUP   - frames are read and discarded till warmup milliseconds after the wakeup; passive mode: CMD_MODE_PASSIVE is sent again (wakeup restores active mode)
+//   SAMPLING - frames (PmsStatus::OK) are averaged, till the configured number of frames is collected; passive mode: every frame is requested by CMD_READ_DATA
+//   SLEEPING - CMD_SLEEP is sent, the next cycle starts period milliseconds after the previous one
+//
+// Mode: the sensor is sampled in the mode it was in when begin() was called (Pms::isModeActive() == false: passive)
+// Commands: a command is queued again if the queue of Pms was full, repeated (up to CMD_ATTEMPTS times) if it failed; failures are counted by getFailed()
+//
+// Usage:
+//   pmsx::PmsDutyCycle dutyCycle(pms, 5UL * 60 * 1000, 30000, 4); // every 5 minutes, 30 s warm-up, average of 4 frames
+//   dutyCycle.begin();
+//   void loop() {
+//       pmsx::PmsData data;
+//       if (dutyCycle.tick(data)) { ... }
+//       ... other work, tick() never blocks
+//   }
+
+#include <pms.h>
+
+namespace pmsx {
+
+	enum class PmsDutyState : uint8_t {
+		IDLE,
+		WAKING,
+		WARMUP,
+		SAMPLING,
+		SLEEPING
+	};
+
+	template <typename Model, typename SerialT = IPmsSerial>
+	class BasicPmsDutyCycle {
+	public:
+		typedef BasicPms<Model, SerialT> pms_t;
+		typedef BasicPmsData<Model> data_t;
+
+		static constexpr unsigned long DEFAULT_WARMUP = 30000U; // Plantower: stable readings 30 s after wakeup
+		static constexpr unsigned long FRAME_TIMEOUT = 3000U; // Sampling is abandoned if there is no frame for so long
+		static constexpr uint8_t CMD_ATTEMPTS = 3; // A command is given up after so many failures
+
+	private:
+		pms_t& pms;
+		unsigned long period;
+		unsigned long warmup;
+		uint8_t frames;
+		bool passive;
+
+		PmsDutyState state;
+		unsigned long cycleStarted;
+		unsigned long stateStarted;
+		uint8_t collected;
+		uint32_t sums[data_t::DATA_SIZE];
+		bool requesting; // CMD_READ_DATA was queued, no frame since
+		unsigned long requested;
+
+		// Command of the current step
+		PmsCmd cmd;
+		typename pms_t::cmdTicket_t ticket; // 0: not queued yet (the queue was full)
+		uint8_t attempts;
+		PmsCmdState cmdState; // QUEUED till DONE or FAILED (given up)
+
+		unsigned long cycles;
+		unsigned long discarded;
+		unsigned long missed;
+		unsigned long failed;
+
+		void enter(const PmsDutyState newState) {
+			state = newState;
+			stateStarted = millis();
+		}
+
+		// No wakeup time: warm-up is handled here, the command pipeline should not wait
+		void send(const PmsCmd newCmd) {
+			cmd = newCmd;
+			attempts = 0;
+			cmdState = PmsCmdState::QUEUED;
+			ticket = pms.writeAsync(cmd, 0);
+		}
+
+		// Follows the command of the current step: queues it if the queue was full, repeats it if it failed
+		void follow() {
+			if (cmdState != PmsCmdState::QUEUED) {
+				return;
+			}
+			if (ticket == 0) {
+				ticket = pms.writeAsync(cmd, 0);
+				return;
+			}
+			switch (pms.getCmdState(ticket)) {
+			case PmsCmdState::QUEUED:
+			case PmsCmdState::BUSY:
+				return;
+			case PmsCmdState::DONE:
+				cmdState = PmsCmdState::DONE;
+				return;
+			default: // FAILED, UNKNOWN (not confirmed)
+				++failed;
+				if (++attempts == CMD_ATTEMPTS) {
+					cmdState = PmsCmdState::FAILED;
+				} else {
+					ticket = pms.writeAsync(cmd, 0);
+				}
+				return;
+			}
+		}
+
+		void startCycle() {
+			cycleStarted = millis();
+			collected = 0;
+			memset(sums, 0, sizeof sums);
+			send(PmsCmd::CMD_WAKEUP);
+			enter(PmsDutyState::WAKING);
+		}
+
+		void finishCycle() {
+			++cycles;
+			send(PmsCmd::CMD_SLEEP);
+			enter(PmsDutyState::SLEEPING);
+		}
+
+		// Passive mode: the next frame is requested as soon as the previous one arrives, again after Pms::getPassiveTimeout()
+		void request() {
+			if (!passive || pms.isCmdBusy() || (requesting && millis() - requested < pms.getPassiveTimeout())) {
+				return;
+			}
+			if (pms.writeAsync(PmsCmd::CMD_READ_DATA) != 0) {
+				requesting = true;
+				requested = millis();
+			}
+		}
+
+		void average(data_t& result) const {
+			for (pmsIdx_t i = 0; i < data_t::DATA_SIZE; ++i) {
+				result.raw[i] = static_cast<pmsData_t>((sums[i] + collected / 2) / collected);
+			}
+		}
+
+	public:
+		// period: time between cycles (ms), warmup: frames received earlier after wakeup are discarded (ms), frames: number of averaged frames
+		BasicPmsDutyCycle(pms_t& pms, const unsigned long period, const unsigned long warmup = DEFAULT_WARMUP, const uint8_t frames = 4) :
+			pms(pms), period(period), warmup(warmup), frames(frames > 0 ? frames : 1), passive(false), state(PmsDutyState::IDLE), cycleStarted(0), stateStarted(0),
+			collected(0), sums{}, requesting(false), requested(0), cmd(PmsCmd::CMD_WAKEUP), ticket(0), attempts(0), cmdState(PmsCmdState::DONE),
+			cycles(0), discarded(0), missed(0), failed(0) {
+		}
+
+		BasicPmsDutyCycle(const BasicPmsDutyCycle&) = delete;
+		BasicPmsDutyCycle& operator=(const BasicPmsDutyCycle&) = delete;
+
+		// Starts the first cycle immediately, the current mode of the sensor is kept in every cycle
+		void begin() {
+			passive = pms.isModeActive() == false;
+			startCycle();
+		}
+
+		// Stops cycling, sensor is put to sleep
+		void end() {
+			if (state != PmsDutyState::IDLE && state != PmsDutyState::SLEEPING) {
+				pms.writeAsync(PmsCmd::CMD_SLEEP);
+			}
+			state = PmsDutyState::IDLE;
+		}
+
+		// Drives the cycle, never blocks. Returns true (once per cycle) if average is ready
+		bool tick(data_t& result) {
+			pms.tick();
+
+			switch (state) {
+			case PmsDutyState::IDLE:
+				return false;
+
+			case PmsDutyState::WAKING:
+				follow();
+				if (cmdState == PmsCmdState::DONE) {
+					enter(PmsDutyState::WARMUP);
+				} else if (cmdState == PmsCmdState::FAILED) {
+					++missed;
+					finishCycle();
+				}
+				return false;
+
+			case PmsDutyState::WARMUP: {
+				data_t data;
+				for (PmsStatus status = pms.read(data); status != PmsStatus::NO_DATA; status = pms.read(data)) {
+					// Checksum, length errors: not a frame
+					if (status == PmsStatus::OK) {
+						++discarded;
+					}
+				}
+				if (millis() - stateStarted < warmup) {
+					return false;
+				}
+				if (passive) {
+					// Given up: frames are requested anyway
+					if (cmd != PmsCmd::CMD_MODE_PASSIVE) {
+						send(PmsCmd::CMD_MODE_PASSIVE);
+					}
+					follow();
+					if (cmdState == PmsCmdState::QUEUED) {
+						return false;
+					}
+				}
+				requesting = false;
+				enter(PmsDutyState::SAMPLING);
+				return false;
+			}
+
+			case PmsDutyState::SAMPLING: {
+				data_t data;
+				for (PmsStatus status = pms.read(data); status != PmsStatus::NO_DATA; status = pms.read(data)) {
+					if (status != PmsStatus::OK) {
+						continue;
+					}
+					for (pmsIdx_t i = 0; i < data_t::DATA_SIZE; ++i) {
+						sums[i] += data.raw.getValue(i);
+					}
+					stateStarted = millis();
+					requesting = false;
+					if (++collected == frames) {
+						break;
+					}
+				}
+				if (collected == frames || millis() - stateStarted >= FRAME_TIMEOUT) {
+					const bool ready = collected > 0;
+					if (ready) {
+						average(result);
+					} else {
+						++missed;
+					}
+					finishCycle();
+					return ready;
+				}
+				request();
+				return false;
+			}
+
+			case PmsDutyState::SLEEPING:
+				follow();
+				if (millis() - cycleStarted >= period && cmdState != PmsCmdState::QUEUED && !pms.isCmdBusy()) {
+					startCycle();
+				}
+				return false;
+			}
+			return false;
+		}
+
+		PmsDutyState getState() const {
+			return state;
+		}
+
+		// Milliseconds till the next cycle starts (0 if the sensor is awake)
+		unsigned long getTimeToNextCycle() const {
+			if (state != PmsDutyState::SLEEPING) {
+				return 0;
+			}
+			const auto elapsed = millis() - cycleStarted;
+			return elapsed >= period ? 0 : period - elapsed;
+		}
+
+		// Number of averaged frames of the last reading (less than configured if the sensor stopped sending frames)
+		uint8_t getCollected() const {
+			return collected;
+		}
+
+		unsigned long getCycles() const {
+			return cycles;
+		}
+
+		// Frames received during warm-up (valid frames only)
+		unsigned long getDiscarded() const {
+			return discarded;
+		}
+
+		// Cycles without any frame
+		unsigned long getMissed() const {
+			return missed;
+		}
+
+		// Failed commands (CMD_WAKEUP, CMD_MODE_PASSIVE, CMD_SLEEP), repeated ones included
+		unsigned long getFailed() const {
+			return failed;
+		}
+	};
+
+	typedef BasicPmsDutyCycle<Pms5003> PmsDutyCycle;
+}
@@ -0,0 +1,328 @@
+#pragma once
+
+// Spike filter for PmsData channels, a stage after Pms::read()
+//
+// Per channel (PmsFilterConfig), applied in this order:
+//   MEDIAN     - output is the median of the last Window frames
+//   HAMPEL     - a frame farther than threshold * sigma from the median is replaced by the median (sigma = 1.4826 * MAD)
+//   RATE_LIMIT - output changes by at most rateLimit per frame
+// update() returns a mask of replaced channels (bit i: PmsData::raw index i), the frame is modified in place
+//
+// Running medians (of values and of absolute deviations) are two-heap "mediators": one array of ring slots,
+// max-heap below the median, min-heap above it. A frame replaces the oldest slot and is sifted in O(log Window).
+// MAD is streaming: deviations are measured against the median at arrival of their frames.
+// Memory is fixed, no allocation. RAM (AVR): about DATA_SIZE * (8 * Window + 12) bytes
+//
+//   pmsx::PmsFilter<5> filter;
+//   filter.setConfig(pmsx::PmsFilterConfig{ pmsx::PmsFilterConfig::HAMPEL | pmsx::PmsFilterConfig::RATE_LIMIT, 30, 5, 500 });
+//   if (pms.read(data) == pmsx::PmsStatus::OK) {
+//       const auto replaced = filter.update(data);
+//   }
+
+#include <pms.h>
+
+namespace pmsx {
+
+	struct PmsFilterConfig {
+		static constexpr uint8_t NONE = 0;
+		static constexpr uint8_t MEDIAN = 1;
+		static constexpr uint8_t HAMPEL = 2;
+		static constexpr uint8_t RATE_LIMIT = 4;
+
+		uint8_t mode; // NONE or a sum of MEDIAN, HAMPEL, RATE_LIMIT
+		uint8_t threshold; // HAMPEL: tenths of sigma, 30 - 3 sigma
+		pmsData_t minimum; // HAMPEL: a deviation from the median up to minimum is never an outlier (constant signals have MAD 0)
+		pmsData_t rateLimit; // RATE_LIMIT: the largest change between consecutive outputs
+	};
+
+	// Running median of the last Window values, O(log Window) per value
+	template <uint8_t Window>
+	class PmsRunningMedian {
+		static_assert(Window > 0, "PmsRunningMedian: Window should not be empty");
+
+		static constexpr int MAX_HEAP = Window / 2; // capacity of the max-heap (below the median)
+		static constexpr int MIN_HEAP = (Window - 1) / 2; // capacity of the min-heap (above the median)
+
+		pmsData_t values[Window]; // ring
+		int8_t positions[Window]; // heap index of a ring slot (heap indexes are computed as int: children of 127 are beyond int8_t)
+		uint8_t heapSlots[Window]; // ring slots: [MAX_HEAP + i], i < 0 - max-heap, 0 - median, i > 0 - min-heap
+		uint8_t next;
+		uint8_t count;
+
+		uint8_t& heap(const int i) {
+			return heapSlots[MAX_HEAP + i];
+		}
+
+		pmsData_t at(const int i) const {
+			return values[heapSlots[MAX_HEAP + i]];
+		}
+
+		// Capped by capacity: count never exceeds Window, the cap lets the compiler see that indexes stay inside of heapSlots
+		int minCount() const {
+			return count == 0 ? 0 : min((count - 1) / 2, MIN_HEAP);
+		}
+
+		int maxCount() const {
+			return min(count / 2, MAX_HEAP);
+		}
+
+		// Exchanges heap items i and j if item i is less than item j
+		bool exchangeIfLess(const int i, const int j) {
+			if (!(at(i) < at(j))) {
+				return false;
+			}
+			const uint8_t slot = heap(i);
+			heap(i) = heap(j);
+			heap(j) = slot;
+			positions[heap(i)] = static_cast<int8_t>(i);
+			positions[heap(j)] = static_cast<int8_t>(j);
+			return true;
+		}
+
+		// Sifts down the min-heap, i: child of the item to be checked (1: the median and the top of the min-heap)
+		void minSortDown(int i) {
+			for (; i <= minCount(); i *= 2) {
+				if (i > 1 && i < MIN_HEAP && i < minCount() && at(i + 1) < at(i)) {
+					++i;
+				}
+				if (!exchangeIfLess(i, i / 2)) {
+					break;
+				}
+			}
+		}
+
+		// Sifts down the max-heap (negative indexes), i: child of the item to be checked
+		void maxSortDown(int i) {
+			for (; i >= -maxCount(); i *= 2) {
+				if (i < -1 && i > -MAX_HEAP && i > -maxCount() && at(i) < at(i - 1)) {
+					--i;
+				}
+				if (!exchangeIfLess(i / 2, i)) {
+					break;
+				}
+			}
+		}
+
+		// Moves item i up the min-heap, returns true if it became the median
+		bool minSortUp(int i) {
+			while (i > 0 && exchangeIfLess(i, i / 2)) {
+				i /= 2;
+			}
+			return i == 0;
+		}
+
+		// Moves item i up the max-heap, returns true if it became the median
+		bool maxSortUp(int i) {
+			while (i < 0 && exchangeIfLess(i / 2, i)) {
+				i /= 2;
+			}
+			return i == 0;
+		}
+
+	public:
+		static constexpr uint8_t WINDOW = Window;
+
+		PmsRunningMedian() {
+			reset();
+		}
+
+		void reset() {
+			next = 0;
+			count = 0;
+			// Slots are filled in order: median, max-heap, min-heap, max-heap, ...
+			for (uint8_t slot = 0; slot < Window; ++slot) {
+				values[slot] = 0;
+				positions[slot] = static_cast<int8_t>(((slot + 1) / 2) * ((slot & 1) != 0 ? -1 : 1));
+				heap(positions[slot]) = slot;
+			}
+		}
+
+		void update(const pmsData_t value) {
+			const bool growing = count < Window;
+			const uint8_t slot = next;
+			const int8_t position = positions[slot];
+			const pmsData_t old = values[slot];
+			values[slot] = value;
+			next = static_cast<uint8_t>((slot + 1) % Window);
+			count = static_cast<uint8_t>(count + (growing ? 1 : 0));
+
+			// Constant tests: heaps of small windows may be empty
+			if (MIN_HEAP > 0 && position > 0) {
+				if (!growing && old < value) {
+					minSortDown(position * 2);
+				} else if (minSortUp(position)) {
+					maxSortDown(-1);
+				}
+			} else if (MAX_HEAP > 0 && position < 0) {
+				if (!growing && value < old) {
+					maxSortDown(position * 2);
+				} else if (maxSortUp(position)) {
+					minSortDown(1);
+				}
+			} else {
+				if (maxCount() > 0) {
+					maxSortDown(-1);
+				}
+				if (minCount() > 0) {
+					minSortDown(1);
+				}
+			}
+		}
+
+		uint8_t getCount() const {
+			return count;
+		}
+
+		// Even count: the lower median
+		pmsData_t get() const {
+			return count == 0 ? 0 : count % 2 == 0 ? at(-1) : at(0);
+		}
+	};
+
+	template <uint8_t Window>
+	constexpr int PmsRunningMedian<Window>::MAX_HEAP;
+	template <uint8_t Window>
+	constexpr int PmsRunningMedian<Window>::MIN_HEAP;
+
+	////////////////////////////////////////
+
+	template <uint8_t Window, typename Model = Pms5003>
+	class PmsFilter {
+	public:
+		typedef BasicPmsData<Model> data_t;
+		static constexpr pmsIdx_t DATA_SIZE = data_t::DATA_SIZE;
+		static_assert(DATA_SIZE <= 32, "PmsFilter: mask of replaced channels is 32 bits wide");
+
+	private:
+		struct Channel {
+			PmsRunningMedian<Window> values;
+			PmsRunningMedian<Window> deviations;
+			PmsFilterConfig config;
+			pmsData_t output;
+			bool started;
+			unsigned long replaced;
+		};
+
+		Channel channels[DATA_SIZE];
+		uint32_t lastReplaced;
+
+		// |deviation| > threshold / 10 * 1.4826 * mad, 1.4826 ~ 89 / 60
+		static bool isOutlier(const PmsFilterConfig& config, const pmsData_t deviation, const pmsData_t mad) {
+			if (deviation <= config.minimum) {
+				return false;
+			}
+			return static_cast<uint32_t>(deviation) * 600UL > static_cast<uint32_t>(config.threshold) * 89UL * mad;
+		}
+
+		static pmsData_t filter(Channel& channel, const pmsData_t value) {
+			const PmsFilterConfig& config = channel.config;
+			pmsData_t result = value;
+			if ((config.mode & (PmsFilterConfig::MEDIAN | PmsFilterConfig::HAMPEL)) != 0) {
+				channel.values.update(value);
+				const pmsData_t median = channel.values.get();
+				if ((config.mode & PmsFilterConfig::MEDIAN) != 0) {
+					result = median;
+				}
+				if ((config.mode & PmsFilterConfig::HAMPEL) != 0) {
+					const pmsData_t deviation = value > median ? value - median : median - value;
+					channel.deviations.update(deviation);
+					if (channel.values.getCount() >= 3 && isOutlier(config, deviation, channel.deviations.get())) {
+						result = median;
+					}
+				}
+			}
+			if ((config.mode & PmsFilterConfig::RATE_LIMIT) != 0 && channel.started) {
+				const pmsData_t previous = channel.output;
+				if (result > previous && result - previous > config.rateLimit) {
+					result = static_cast<pmsData_t>(previous + config.rateLimit);
+				} else if (result < previous && previous - result > config.rateLimit) {
+					result = static_cast<pmsData_t>(previous - config.rateLimit);
+				}
+			}
+			channel.output = result;
+			channel.started = true;
+			return result;
+		}
+
+	public:
+		PmsFilter() : lastReplaced(0) {
+			for (pmsIdx_t i = 0; i < DATA_SIZE; ++i) {
+				channels[i].config = PmsFilterConfig{ PmsFilterConfig::NONE, 0, 0, 0 };
+				channels[i].output = 0;
+				channels[i].started = false;
+				channels[i].replaced = 0;
+			}
+		}
+
+		// All channels
+		void setConfig(const PmsFilterConfig& config) {
+			for (pmsIdx_t i = 0; i < DATA_SIZE; ++i) {
+				setConfig(i, config);
+			}
+		}
+
+		// index: the same as PmsData::raw index, history of the channel is cleared
+		void setConfig(const pmsIdx_t index, const PmsFilterConfig& config) {
+			channels[index].config = config;
+			resetChannel(index);
+		}
+
+		const PmsFilterConfig& getConfig(const pmsIdx_t index) const {
+			return channels[index].config;
+		}
+
+		void reset() {
+			for (pmsIdx_t i = 0; i < DATA_SIZE; ++i) {
+				resetChannel(i);
+			}
+			lastReplaced = 0;
+		}
+
+		void resetChannel(const pmsIdx_t index) {
+			Channel& channel = channels[index];
+			channel.values.reset();
+			channel.deviations.reset();
+			channel.output = 0;
+			channel.started = false;
+		}
+
+		// Filters a frame (PmsStatus::OK) in place, returns mask of replaced channels
+		uint32_t update(data_t& data) {
+			uint32_t replaced = 0;
+			for (pmsIdx_t i = 0; i < DATA_SIZE; ++i) {
+				Channel& channel = channels[i];
+				if (channel.config.mode == PmsFilterConfig::NONE) {
+					continue;
+				}
+				const pmsData_t value = data.raw.getValue(i);
+				const pmsData_t result = filter(channel, value);
+				if (result != value) {
+					data.raw[i] = result;
+					replaced |= 1UL << i;
+					++channel.replaced;
+				}
+			}
+			lastReplaced = replaced;
+			return replaced;
+		}
+
+		// Mask of channels replaced by the last update()
+		uint32_t getReplaced() const {
+			return lastReplaced;
+		}
+
+		bool isReplaced(const pmsIdx_t index) const {
+			return (lastReplaced & (1UL << index)) != 0;
+		}
+
+		// Frames replaced since construction
+		unsigned long getReplacedCount(const pmsIdx_t index) const {
+			return channels[index].replaced;
+		}
+
+		// Median of the last Window frames of a channel (MEDIAN or HAMPEL mode)
+		pmsData_t getMedian(const pmsIdx_t index) const {
+			return channels[index].values.get();
+		}
+	};
+}
@@ -0,0 +1,247 @@
+#pragma once
+
+// Linux only: many sensors served by a single thread
+//
+// PmsGroup waits for all registered sensors using one epoll set:
+//   bytes are pushed into the parser of the sensor's Pms (Pms::receive()) as soon as they arrive, there is no busy wait
+//   Pms of a registered sensor never reads its serial port (Pms::setExternalInput()): every byte goes through one parser
+//   complete frames are dispatched to the handler passed to poll()
+//   sensors in passive mode get CMD_READ_DATA according to their own schedule (epoll timeout is shortened to the nearest request)
+//   a request which does not fit into a full command queue is not dropped: it is sent as soon as a queued command completes
+//   commands queued by pms.writeAsync() are driven by poll(): warm-ups of many sensors overlap
+//
+// Usage:
+//   PmsPosixSerial serial("/dev/ttyUSB0");
+//   pmsx::Pms pms(&serial);
+//   pms.begin();
+//   pmsx::PmsGroup<64> group;
+//   group.add(pms, serial);          // active mode
+//   group.add(pms2, serial2, 1000);  // passive mode, CMD_READ_DATA every 1000 ms
+//   pmsx::PmsGroup<8, pmsx::Pms5003ST> groupST; // other sensor models: separate group, pms has to be pmsx::BasicPms<Model>
+//   for (;;) {
+//       group.poll(-1, [](size_t sensor, pmsx::PmsStatus status, const pmsx::PmsData& data) { ... });
+//   }
+
+#include <pms.h>
+#include <pmsSerialPosix.h>
+
+#include <sys/epoll.h>
+
+namespace pmsx {
+
+	template <size_t Capacity, typename Model = Pms5003, typename SerialT = IPmsSerial>
+	class PmsGroup {
+	public:
+		typedef BasicPms<Model, SerialT> pms_t;
+		typedef BasicPmsData<Model> data_t;
+
+		static constexpr size_t CAPACITY = Capacity;
+		static constexpr size_t READ_CHUNK = 256;
+
+	private:
+		struct Sensor {
+			pms_t* pms;
+			PmsPosixSerial* serial;
+			unsigned long period;
+			unsigned long nextRequest;
+		};
+
+		int epollFd;
+		Sensor sensors[Capacity];
+		size_t size;
+
+		bool isUsed(const size_t index) const {
+			return index < size && sensors[index].pms != nullptr;
+		}
+
+		// Milliseconds till the nearest CMD_READ_DATA, limited by maxWait (-1: infinite)
+		int getWaitTime(const int maxWait, const unsigned long now) const {
+			long result = maxWait;
+			for (size_t i = 0; i < size; ++i) {
+				if (!isUsed(i)) {
+					continue;
+				}
+				const long toCommand = sensors[i].pms->getCmdWaitTime();
+				if (toCommand >= 0 && (result < 0 || toCommand < result)) {
+					result = toCommand;
+				}
+				if (sensors[i].period == 0) {
+					continue;
+				}
+				const long toRequest = static_cast<long>(sensors[i].nextRequest - now);
+				if (toRequest <= 0 && sensors[i].pms->getCmdFree() == 0) {
+					// Due, but the command queue is full: retried as soon as a command completes (toCommand)
+					continue;
+				}
+				const long wait = toRequest > 0 ? toRequest : 0;
+				if (result < 0 || wait < result) {
+					result = wait;
+				}
+			}
+			return static_cast<int>(result);
+		}
+
+		void sendRequests(const unsigned long now) {
+			for (size_t i = 0; i < size; ++i) {
+				auto& sensor = sensors[i];
+				if (!isUsed(i) || sensor.period == 0 || static_cast<long>(now - sensor.nextRequest) < 0) {
+					continue;
+				}
+				if (sensor.pms->writeAsync(PmsCmd::CMD_READ_DATA) == 0) {
+					// Command queue is full: the request stays due, the next call retries
+					continue;
+				}
+				sensor.nextRequest += sensor.period;
+				if (static_cast<long>(now - sensor.nextRequest) >= 0) {
+					// Too late (for example the thread was suspended): do not send a burst of requests
+					sensor.nextRequest = now + sensor.period;
+				}
+			}
+		}
+
+		void tick() {
+			for (size_t i = 0; i < size; ++i) {
+				if (isUsed(i)) {
+					sensors[i].pms->tick();
+				}
+			}
+		}
+
+		// Returns number of bytes read
+		template <typename Handler>
+		size_t drain(const size_t index, size_t& frames, Handler& handler) {
+			auto& sensor = sensors[index];
+			uint8_t buffer[READ_CHUNK];
+			size_t bytes = 0;
+			for (;;) {
+				const auto toRead = min(sensor.serial->available(), sizeof buffer);
+				if (toRead == 0) {
+					break;
+				}
+				const auto done = sensor.serial->read(buffer, toRead);
+				bytes += done;
+				// Response frames go to the command pipeline of Pms, read latency is measured
+				frames += sensor.pms->receive(buffer, done, [&](const PmsStatus status, const data_t& data) {
+					handler(index, status, data);
+				});
+				if (done < toRead) {
+					break;
+				}
+			}
+			return bytes;
+		}
+
+	public:
+		PmsGroup() : epollFd(epoll_create1(EPOLL_CLOEXEC)), sensors{}, size(0) {}
+
+		~PmsGroup() {
+			if (epollFd >= 0) {
+				close(epollFd);
+			}
+		}
+
+		PmsGroup(const PmsGroup&) = delete;
+		PmsGroup& operator=(const PmsGroup&) = delete;
+
+		bool initialized() const {
+			return epollFd >= 0;
+		}
+
+		// Registers sensor. pms has to use serial and it has to be initialized: begin()
+		// pms.read() returns NO_DATA till the sensor is removed: frames are dispatched by poll()
+		// passivePeriod == 0: sensor is expected to work in active mode
+		// passivePeriod > 0: sensor is switched to passive mode, CMD_READ_DATA is sent every passivePeriod milliseconds
+		// Returns index of the sensor (passed to the handler), -1 on failure
+		int add(pms_t& pms, PmsPosixSerial& serial, const unsigned long passivePeriod = 0) {
+			if (epollFd < 0 || serial.getFd() < 0) {
+				return -1;
+			}
+			size_t index = 0;
+			while (index < size && sensors[index].pms != nullptr) {
+				++index;
+			}
+			if (index == Capacity) {
+				return -1;
+			}
+
+			epoll_event event{};
+			event.events = EPOLLIN;
+			event.data.u64 = index;
+			if (epoll_ctl(epollFd, EPOLL_CTL_ADD, serial.getFd(), &event) != 0) {
+				return -1;
+			}
+
+			pms.setExternalInput(true);
+			if (passivePeriod > 0) {
+				pms.writeAsync(PmsCmd::CMD_MODE_PASSIVE);
+			}
+
+			auto& sensor = sensors[index];
+			sensor.pms = &pms;
+			sensor.serial = &serial;
+			sensor.period = passivePeriod;
+			sensor.nextRequest = millis();
+			if (index == size) {
+				++size;
+			}
+			return static_cast<int>(index);
+		}
+
+		bool remove(const size_t index) {
+			if (!isUsed(index)) {
+				return false;
+			}
+			epoll_ctl(epollFd, EPOLL_CTL_DEL, sensors[index].serial->getFd(), nullptr);
+			sensors[index].pms->setExternalInput(false);
+			sensors[index].pms = nullptr;
+			sensors[index].serial = nullptr;
+			while (size > 0 && sensors[size - 1].pms == nullptr) {
+				--size;
+			}
+			return true;
+		}
+
+		size_t getSize() const {
+			return size;
+		}
+
+		// false if sensor was removed, also after hangup of its serial port
+		bool contains(const size_t index) const {
+			return isUsed(index);
+		}
+
+		// Waits (not longer than maxWait milliseconds, -1: no limit) for data from any sensor, sends scheduled CMD_READ_DATA
+		// handler(size_t sensor, PmsStatus status, const data_t& data) is called for every complete frame
+		// Returns number of dispatched frames, -1 on epoll error
+		template <typename Handler>
+		int poll(const int maxWait, Handler&& handler) {
+			if (epollFd < 0) {
+				return -1;
+			}
+
+			sendRequests(millis());
+			tick();
+
+			epoll_event events[Capacity];
+			const auto ready = epoll_wait(epollFd, events, static_cast<int>(Capacity), getWaitTime(maxWait, millis()));
+			if (ready < 0) {
+				return errno == EINTR ? 0 : -1;
+			}
+
+			size_t frames = 0;
+			for (int i = 0; i < ready; ++i) {
+				const auto index = static_cast<size_t>(events[i].data.u64);
+				if (!isUsed(index)) {
+					continue;
+				}
+				if (drain(index, frames, handler) == 0 && (events[i].events & (EPOLLHUP | EPOLLERR))) {
+					remove(index);
+				}
+			}
+
+			sendRequests(millis());
+			tick();
+			return static_cast<int>(frames);
+		}
+	};
+}
@@ -0,0 +1,331 @@
+#pragma once
+
+// Sensor health watchdog: detects a wedged sensor and recovers it without blocking
+//
+// Outcomes of read() are observed (read() of the watchdog, or observe() if frames are read elsewhere). Problems:
+//   NO_FRAMES - no frame (PmsStatus::OK) for frameTimeout ms: sensor stopped streaming (or nobody sends CMD_READ_DATA in passive mode)
+//   STUCK     - stuckFrames identical frames in a row
+//   ERRORS    - smoothed ratio of bad frames (SUM_ERROR, FRAME_LENGTH_MISMATCH, READ_ERROR) is above errorPercent
+// Frame age and average interval between frames are tracked as well.
+//
+// Recovery escalates, every step is followed by a wait (backoff, doubled by every next step up to backoffMax):
+//   MODE         - the mode command (config.mode) is sent again
+//   SLEEP_WAKEUP - CMD_SLEEP, CMD_WAKEUP, the mode command
+//   RESET        - CMD_RESET (Pms::setPinReset() is required, otherwise SLEEP_WAKEUP again), the mode command; repeated till the sensor recovers
+// Commands are queued (writeAsync()), tick() never blocks. Commands of a step are queued together: if the queue of Pms has no room
+// for them, the step is taken by a later tick(). The check after the wait needs a frame received after the step
+// (STUCK: a different one), otherwise the next step is taken. Backoff starts over when the sensor stays healthy for backoff ms.
+//
+// Usage:
+//   pmsx::PmsHealth health(pms); // active mode, 10 s without a frame, 120 identical frames, 50% of bad frames
+//   health.begin();
+//   void loop() {
+//       health.tick();
+//       pmsx::PmsData data;
+//       if (health.read(data) == pmsx::PmsStatus::OK) { ... }
+//   }
+//
+// Sleeping sensor (PmsDutyCycle, CMD_SLEEP sent by the application) does not send frames: end() the watchdog, begin() it after wakeup.
+
+#include <pms.h>
+
+namespace pmsx {
+
+	enum class PmsHealthProblem : uint8_t {
+		NONE,
+		NO_FRAMES,
+		STUCK,
+		ERRORS
+	};
+
+	enum class PmsRecoveryStep : uint8_t {
+		NONE,
+		MODE,
+		SLEEP_WAKEUP,
+		RESET
+	};
+
+	struct PmsHealthConfig {
+		unsigned long frameTimeout; // ms without a frame: NO_FRAMES, 0 - not checked
+		uint16_t stuckFrames; // identical frames in a row: STUCK, 0 - not checked
+		uint8_t errorPercent; // smoothed ratio of bad frames: ERRORS, 0 - not checked
+		unsigned long backoff; // wait after the first recovery step (warm-up included), ms
+		unsigned long backoffMax; // limit of doubled waits, ms
+		PmsCmd mode; // CMD_MODE_ACTIVE or CMD_MODE_PASSIVE
+	};
+
+	template <typename Model, typename SerialT = IPmsSerial>
+	class BasicPmsHealth {
+	public:
+		typedef BasicPms<Model, SerialT> pms_t;
+		typedef BasicPmsData<Model> data_t;
+
+		static constexpr uint8_t ERROR_MIN_OUTCOMES = 16; // ERRORS is not reported before so many frames (good or bad) are observed
+		static constexpr uint8_t ERROR_SHIFT = 4; // ratio of bad frames: exponential average, alpha = 1 / 2^ERROR_SHIFT
+		static constexpr uint8_t INTERVAL_SHIFT = 3; // average interval between frames, alpha = 1 / 2^INTERVAL_SHIFT
+
+	private:
+		pms_t& pms;
+		PmsHealthConfig config;
+		bool running;
+
+		PmsHealthProblem problem;
+		PmsRecoveryStep step; // the last recovery step, NONE: sensor is healthy
+		uint8_t attempts; // recovery steps since the sensor was healthy for backoff ms
+		unsigned long waitStarted;
+		unsigned long waitDuration;
+		unsigned long healthySince; // millis() of the end of the last recovery
+		unsigned long framesAtStep; // frames at the last recovery step
+		typename pms_t::cmdTicket_t resetTicket; // CMD_RESET of the current step, 0 - none
+
+		unsigned long lastFrame; // millis() of the last frame (or of begin(), recovery)
+		unsigned long averageInterval; // * 2^INTERVAL_SHIFT, 0 - not measured yet
+		data_t lastData;
+		bool lastDataValid;
+		uint16_t identical; // frames equal to the previous one, in a row
+		uint16_t errorRatio; // * 65535
+		uint8_t outcomes; // observed since begin() or recovery, up to ERROR_MIN_OUTCOMES
+
+		unsigned long frames;
+		unsigned long errors;
+		unsigned long recoveries; // recovery steps
+		unsigned long recovered; // recoveries ended by a healthy check
+
+		PmsHealthProblem check(const unsigned long now) const {
+			if (config.frameTimeout > 0 && now - lastFrame >= config.frameTimeout) {
+				return PmsHealthProblem::NO_FRAMES;
+			}
+			if (config.stuckFrames > 0 && identical >= config.stuckFrames) {
+				return PmsHealthProblem::STUCK;
+			}
+			if (config.errorPercent > 0 && outcomes >= ERROR_MIN_OUTCOMES && static_cast<uint32_t>(errorRatio) * 100U > 65535UL * config.errorPercent) {
+				return PmsHealthProblem::ERRORS;
+			}
+			return PmsHealthProblem::NONE;
+		}
+
+		// Evidence collected before the recovery step is not used after it
+		void restartObservation() {
+			lastFrame = millis();
+			identical = 0;
+			errorRatio = 0;
+			outcomes = 0;
+		}
+
+		// Returns false if the queue has no room for all commands (a sensor put to sleep must be woken up)
+		bool sleepWakeup() {
+			if (pms.getCmdFree() < 3) {
+				return false;
+			}
+			pms.writeAsync(PmsCmd::CMD_SLEEP);
+			pms.writeAsync(PmsCmd::CMD_WAKEUP);
+			pms.writeAsync(config.mode);
+			return true;
+		}
+
+		// Returns false if the queue has no room for the commands of the step: nothing is queued or counted
+		bool recover() {
+			const auto next = attempts == 0 ? PmsRecoveryStep::MODE : attempts == 1 ? PmsRecoveryStep::SLEEP_WAKEUP : PmsRecoveryStep::RESET;
+			if (pms.getCmdFree() < (next == PmsRecoveryStep::MODE ? 1 : next == PmsRecoveryStep::RESET ? 2 : 3)) {
+				return false;
+			}
+			step = next;
+			resetTicket = 0;
+			switch (step) {
+			case PmsRecoveryStep::MODE:
+				pms.writeAsync(config.mode);
+				break;
+			case PmsRecoveryStep::SLEEP_WAKEUP:
+				sleepWakeup();
+				break;
+			default:
+				resetTicket = pms.writeAsync(PmsCmd::CMD_RESET);
+				pms.writeAsync(config.mode);
+				break;
+			}
+			unsigned long wait = config.backoff;
+			for (uint8_t i = 0; i < attempts && wait < config.backoffMax; ++i) {
+				wait *= 2;
+			}
+			waitDuration = min(wait, config.backoffMax);
+			waitStarted = millis();
+			framesAtStep = frames;
+			if (attempts < UINT8_MAX) {
+				++attempts;
+			}
+			++recoveries;
+			restartObservation();
+			return true;
+		}
+
+	public:
+		explicit BasicPmsHealth(pms_t& pms, const PmsHealthConfig& config = PmsHealthConfig{ 10000U, 120U, 50U, 30000U, 600000UL, PmsCmd::CMD_MODE_ACTIVE }) :
+			pms(pms), config(config), running(false), problem(PmsHealthProblem::NONE), step(PmsRecoveryStep::NONE), attempts(0), waitStarted(0), waitDuration(0), healthySince(0), framesAtStep(0), resetTicket(0),
+			lastFrame(0), averageInterval(0), lastData{}, lastDataValid(false), identical(0), errorRatio(0), outcomes(0),
+			frames(0), errors(0), recoveries(0), recovered(0) {
+		}
+
+		BasicPmsHealth(const BasicPmsHealth&) = delete;
+		BasicPmsHealth& operator=(const BasicPmsHealth&) = delete;
+
+		// Starts watching, the sensor has frameTimeout ms for the first frame
+		void begin() {
+			running = true;
+			problem = PmsHealthProblem::NONE;
+			step = PmsRecoveryStep::NONE;
+			attempts = 0;
+			resetTicket = 0;
+			lastDataValid = false;
+			restartObservation();
+		}
+
+		// Stops watching (sensor is put to sleep on purpose, ...), queued recovery commands are completed by pms.tick()
+		void end() {
+			running = false;
+		}
+
+		void setConfig(const PmsHealthConfig& newConfig) {
+			config = newConfig;
+		}
+
+		const PmsHealthConfig& getConfig() const {
+			return config;
+		}
+
+		// Outcome of pms.read() made elsewhere (NO_DATA is ignored)
+		void observe(const PmsStatus status, const data_t& data) {
+			if (status == PmsStatus::NO_DATA) {
+				return;
+			}
+			const bool good = status == PmsStatus::OK;
+			errorRatio = static_cast<uint16_t>(errorRatio + ((good ? 0L : 65535L) - errorRatio) / (1L << ERROR_SHIFT));
+			if (outcomes < ERROR_MIN_OUTCOMES) {
+				++outcomes;
+			}
+			if (!good) {
+				++errors;
+				return;
+			}
+
+			const auto now = millis();
+			if (frames > 0) {
+				const unsigned long interval = now - lastFrame;
+				averageInterval = averageInterval == 0 ? interval << INTERVAL_SHIFT : averageInterval + interval - (averageInterval >> INTERVAL_SHIFT);
+			}
+			lastFrame = now;
+			++frames;
+
+			if (lastDataValid && memcmp(&lastData, &data, sizeof data) == 0) {
+				if (identical < UINT16_MAX) {
+					++identical;
+				}
+			} else {
+				identical = 0;
+			}
+			lastData = data;
+			lastDataValid = true;
+		}
+
+		// pms.read() and observation of its outcome
+		PmsStatus read(data_t& data) {
+			const auto status = pms.read(data);
+			observe(status, data);
+			return status;
+		}
+
+		// Drives pms.tick(), checks health and escalates recovery, never blocks. Returns the current problem
+		PmsHealthProblem tick() {
+			pms.tick();
+			if (!running) {
+				return problem;
+			}
+			if (resetTicket != 0 && pms.getCmdState(resetTicket) == PmsCmdState::FAILED && sleepWakeup()) {
+				// No reset pin: the next best thing (as soon as the queue has room for it)
+				resetTicket = 0;
+			}
+			const auto now = millis();
+			if (pms.isCmdBusy() || (step != PmsRecoveryStep::NONE && now - waitStarted < waitDuration)) {
+				return problem;
+			}
+
+			if (step == PmsRecoveryStep::NONE) {
+				problem = check(now);
+			} else if (frames == framesAtStep) {
+				problem = PmsHealthProblem::NO_FRAMES;
+			} else if (problem == PmsHealthProblem::STUCK && identical >= frames - framesAtStep) {
+				// All frames after the step are equal to the one before it
+			} else {
+				problem = check(now);
+			}
+
+			if (problem != PmsHealthProblem::NONE) {
+				// Queue full: the next tick() tries again
+				recover();
+				return problem;
+			}
+			if (step != PmsRecoveryStep::NONE) {
+				++recovered;
+				step = PmsRecoveryStep::NONE;
+				healthySince = now;
+			}
+			if (attempts > 0 && now - healthySince >= config.backoff) {
+				attempts = 0;
+			}
+			return problem;
+		}
+
+		bool isHealthy() const {
+			return problem == PmsHealthProblem::NONE;
+		}
+
+		// The problem found by the last check of tick()
+		PmsHealthProblem getProblem() const {
+			return problem;
+		}
+
+		// The last recovery step, NONE if the sensor is healthy
+		PmsRecoveryStep getRecoveryStep() const {
+			return step;
+		}
+
+		// Milliseconds since the last frame (or begin(), or the last recovery step)
+		unsigned long getFrameAge() const {
+			return millis() - lastFrame;
+		}
+
+		// Average interval between frames, ms, 0 if not measured yet
+		unsigned long getAverageInterval() const {
+			return averageInterval >> INTERVAL_SHIFT;
+		}
+
+		// Frames equal to the previous one, in a row
+		uint16_t getIdenticalFrames() const {
+			return identical;
+		}
+
+		// Smoothed ratio of bad frames, %
+		uint8_t getErrorPercent() const {
+			return static_cast<uint8_t>((static_cast<uint32_t>(errorRatio) * 100U + 32767U) / 65535U);
+		}
+
+		unsigned long getFrames() const {
+			return frames;
+		}
+
+		unsigned long getErrors() const {
+			return errors;
+		}
+
+		// Recovery steps taken
+		unsigned long getRecoveries() const {
+			return recoveries;
+		}
+
+		// Recoveries ended by a healthy sensor
+		unsigned long getRecovered() const {
+			return recovered;
+		}
+	};
+
+	typedef BasicPmsHealth<Pms5003> PmsHealth;
+}
@@ -0,0 +1,373 @@
+#pragma once
+
+// Compact history of PmsData: delta + zigzag + varint, fixed size blocks
+//
+// File layout (all numbers little endian):
+//   header (16 bytes): "PMSH", version, channels, blockSize (2 bytes), 8 reserved bytes
+//   blocks: each block is exactly blockSize bytes long:
+//     block header (12 bytes): samples (2 bytes), payload size (2 bytes), first timestamp (4 bytes), last timestamp (4 bytes)
+//     payload, zero padding
+//
+// Payload: samples, every block can be decoded on its own
+//   the first sample: timestamp is taken from the block header, values are stored as varints
+//   next samples: varint(timestamp - previous timestamp), then for every channel zigzag varint of the residual:
+//     residual = (value - previous value) - (delta of the reference channel): PM2.5 follows PM1.0, PM10 follows PM2.5, atmospheric values follow CF=1 values
+//   usually a sample takes 1 byte per channel
+//
+// Timestamps are uint32_t, their unit is defined by the application (seconds since epoch, millis(), ...). They should not decrease.
+//
+// PmsHistoryWriter<Sink, BlockSize>: portable, Sink is anything with size_t write(const uint8_t*, size_t) (Arduino SD File, FILE* wrapper, ...)
+// PmsHistoryReader: POSIX only (PMS_POSIX), file is memory mapped, blocks are located using binary search
+
+#include <pms.h>
+
+#if defined PMS_POSIX
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace pmsx {
+
+	class PmsHistoryFormat {
+	public:
+		static constexpr uint8_t VERSION = 1;
+		static constexpr size_t FILE_HEADER_SIZE = 16;
+		static constexpr size_t BLOCK_HEADER_SIZE = 12;
+		static constexpr size_t MAX_SAMPLE_SIZE = 5 + PmsData::DATA_SIZE * 3; // varints: timestamp + channels (17 bits after zigzag)
+
+		// Residual reference channel, DATA_SIZE: no reference
+		static PmsData::pmsIdx_t getReference(const PmsData::pmsIdx_t channel) {
+			static const PmsData::pmsIdx_t REFERENCES[PmsData::DATA_SIZE]{
+				PmsData::DATA_SIZE, 0, 1,
+				0, 1, 2,
+				PmsData::DATA_SIZE, PmsData::DATA_SIZE, PmsData::DATA_SIZE, PmsData::DATA_SIZE, PmsData::DATA_SIZE, PmsData::DATA_SIZE,
+				PmsData::DATA_SIZE
+			};
+			return REFERENCES[channel];
+		}
+
+		static uint8_t* putVarint(uint8_t* where, uint32_t value) {
+			while (value >= 0x80) {
+				*where++ = static_cast<uint8_t>(value | 0x80);
+				value >>= 7;
+			}
+			*where++ = static_cast<uint8_t>(value);
+			return where;
+		}
+
+		// Returns nullptr if the varint does not end before end
+		static const uint8_t* getVarint(const uint8_t* where, const uint8_t* end, uint32_t& value) {
+			value = 0;
+			for (uint8_t shift = 0; where < end && shift < 35; shift += 7) {
+				const uint8_t byte = *where++;
+				value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+				if ((byte & 0x80) == 0) {
+					return where;
+				}
+			}
+			return nullptr;
+		}
+
+		static uint32_t zigzag(const int32_t value) {
+			return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+		}
+
+		static int32_t unzigzag(const uint32_t value) {
+			return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+		}
+
+		static void putLe(uint8_t* where, uint32_t value, const uint8_t size) {
+			for (uint8_t i = 0; i < size; ++i, value >>= 8) {
+				where[i] = static_cast<uint8_t>(value);
+			}
+		}
+
+		static uint32_t getLe(const uint8_t* where, const uint8_t size) {
+			uint32_t value = 0;
+			for (uint8_t i = size; i > 0; --i) {
+				value = (value << 8) | where[i - 1];
+			}
+			return value;
+		}
+
+		static void putFileHeader(uint8_t* header, const uint16_t blockSize) {
+			memset(header, 0, FILE_HEADER_SIZE);
+			memcpy(header, "PMSH", 4);
+			header[4] = VERSION;
+			header[5] = PmsData::DATA_SIZE;
+			putLe(header + 6, blockSize, 2);
+		}
+	};
+
+	////////////////////////////////////////
+
+	template <typename Sink, size_t BlockSize = 1024>
+	class PmsHistoryWriter {
+		static_assert(BlockSize >= PmsHistoryFormat::BLOCK_HEADER_SIZE + PmsHistoryFormat::MAX_SAMPLE_SIZE, "PmsHistoryWriter: BlockSize is too small");
+		static_assert(BlockSize <= UINT16_MAX, "PmsHistoryWriter: BlockSize is too big");
+
+		Sink& sink;
+		uint8_t block[BlockSize];
+		uint8_t* next;
+		uint16_t samples;
+		uint32_t first;
+		uint32_t last;
+		PmsData previous;
+		unsigned long blocksWritten;
+
+		uint8_t* payload() {
+			return block + PmsHistoryFormat::BLOCK_HEADER_SIZE;
+		}
+
+	public:
+		static constexpr size_t BLOCK_SIZE = BlockSize;
+
+		explicit PmsHistoryWriter(Sink& sink) : sink(sink), next(payload()), samples(0), first(0), last(0), previous{}, blocksWritten(0) {}
+
+		~PmsHistoryWriter() {
+			flush();
+		}
+
+		PmsHistoryWriter(const PmsHistoryWriter&) = delete;
+		PmsHistoryWriter& operator=(const PmsHistoryWriter&) = delete;
+
+		// Writes file header. Skip it if blocks are appended to an existing file
+		bool begin() {
+			uint8_t header[PmsHistoryFormat::FILE_HEADER_SIZE];
+			PmsHistoryFormat::putFileHeader(header, BlockSize);
+			return sink.write(header, sizeof header) == sizeof header;
+		}
+
+		bool append(const uint32_t timestamp, const PmsData& data) {
+			if (samples > 0 && (timestamp < last || samples == UINT16_MAX || static_cast<size_t>(block + BlockSize - next) < PmsHistoryFormat::MAX_SAMPLE_SIZE)) {
+				if (!flush()) {
+					return false;
+				}
+			}
+
+			if (samples == 0) {
+				first = timestamp;
+				for (PmsData::pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+					next = PmsHistoryFormat::putVarint(next, data.raw.getValue(i));
+				}
+			} else {
+				next = PmsHistoryFormat::putVarint(next, timestamp - last);
+				int32_t deltas[PmsData::DATA_SIZE];
+				for (PmsData::pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+					deltas[i] = static_cast<int32_t>(data.raw.getValue(i)) - previous.raw.getValue(i);
+					const auto reference = PmsHistoryFormat::getReference(i);
+					const int32_t residual = deltas[i] - (reference < PmsData::DATA_SIZE ? deltas[reference] : 0);
+					next = PmsHistoryFormat::putVarint(next, PmsHistoryFormat::zigzag(residual));
+				}
+			}
+			previous = data;
+			last = timestamp;
+			++samples;
+			return true;
+		}
+
+		// Writes current block (padded to BlockSize). Called automatically when the block is full
+		bool flush() {
+			if (samples == 0) {
+				return true;
+			}
+			PmsHistoryFormat::putLe(block, samples, 2);
+			PmsHistoryFormat::putLe(block + 2, static_cast<uint32_t>(next - payload()), 2);
+			PmsHistoryFormat::putLe(block + 4, first, 4);
+			PmsHistoryFormat::putLe(block + 8, last, 4);
+			memset(next, 0, static_cast<size_t>(block + BlockSize - next));
+
+			samples = 0;
+			next = payload();
+			if (sink.write(block, BlockSize) != BlockSize) {
+				return false;
+			}
+			++blocksWritten;
+			return true;
+		}
+
+		unsigned long getBlocksWritten() const {
+			return blocksWritten;
+		}
+	};
+
+	// Decodes a single block, handler(uint32_t timestamp, const PmsData& data) is called for every sample
+	// Returns number of decoded samples
+	template <typename Handler>
+	size_t decodeHistoryBlock(const uint8_t* block, const size_t blockSize, Handler&& handler) {
+		if (blockSize < PmsHistoryFormat::BLOCK_HEADER_SIZE) {
+			return 0;
+		}
+		const auto samples = PmsHistoryFormat::getLe(block, 2);
+		const auto used = PmsHistoryFormat::getLe(block + 2, 2);
+		uint32_t timestamp = PmsHistoryFormat::getLe(block + 4, 4);
+		const uint8_t* where = block + PmsHistoryFormat::BLOCK_HEADER_SIZE;
+		if (used > blockSize - PmsHistoryFormat::BLOCK_HEADER_SIZE) {
+			return 0;
+		}
+		const uint8_t* const end = where + used;
+
+		PmsData data{};
+		uint32_t value;
+		for (uint32_t sample = 0; sample < samples; ++sample) {
+			if (sample == 0) {
+				for (PmsData::pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+					if ((where = PmsHistoryFormat::getVarint(where, end, value)) == nullptr) {
+						return sample;
+					}
+					data.raw[i] = static_cast<pmsData_t>(value);
+				}
+			} else {
+				if ((where = PmsHistoryFormat::getVarint(where, end, value)) == nullptr) {
+					return sample;
+				}
+				timestamp += value;
+				int32_t deltas[PmsData::DATA_SIZE];
+				for (PmsData::pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+					if ((where = PmsHistoryFormat::getVarint(where, end, value)) == nullptr) {
+						return sample;
+					}
+					const auto reference = PmsHistoryFormat::getReference(i);
+					deltas[i] = PmsHistoryFormat::unzigzag(value) + (reference < PmsData::DATA_SIZE ? deltas[reference] : 0);
+					data.raw[i] = static_cast<pmsData_t>(data.raw.getValue(i) + deltas[i]);
+				}
+			}
+			handler(timestamp, static_cast<const PmsData&>(data));
+		}
+		return samples;
+	}
+
+#if defined PMS_POSIX
+
+	// Sink for PmsHistoryWriter: stdio file
+	class PmsHistoryFile {
+		FILE* file;
+	public:
+		explicit PmsHistoryFile(FILE* file) : file(file) {}
+
+		size_t write(const uint8_t* buffer, const size_t size) {
+			return file == nullptr ? 0 : fwrite(buffer, 1, size, file);
+		}
+	};
+
+	class PmsHistoryReader {
+		const uint8_t* data;
+		size_t size;
+		size_t blockSize;
+		size_t blockCount;
+
+		const uint8_t* getBlock(const size_t index) const {
+			return data + PmsHistoryFormat::FILE_HEADER_SIZE + index * blockSize;
+		}
+
+	public:
+		PmsHistoryReader() : data(nullptr), size(0), blockSize(0), blockCount(0) {}
+
+		~PmsHistoryReader() {
+			close();
+		}
+
+		PmsHistoryReader(const PmsHistoryReader&) = delete;
+		PmsHistoryReader& operator=(const PmsHistoryReader&) = delete;
+
+		bool open(const char* path) {
+			close();
+			const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+			if (fd < 0) {
+				return false;
+			}
+			struct stat info;
+			if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < PmsHistoryFormat::FILE_HEADER_SIZE) {
+				::close(fd);
+				return false;
+			}
+			void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			::close(fd);
+			if (mapped == MAP_FAILED) {
+				return false;
+			}
+			data = static_cast<const uint8_t*>(mapped);
+			size = static_cast<size_t>(info.st_size);
+
+			blockSize = PmsHistoryFormat::getLe(data + 6, 2);
+			if (memcmp(data, "PMSH", 4) != 0 || data[4] != PmsHistoryFormat::VERSION || data[5] != PmsData::DATA_SIZE || blockSize <= PmsHistoryFormat::BLOCK_HEADER_SIZE) {
+				close();
+				return false;
+			}
+			blockCount = (size - PmsHistoryFormat::FILE_HEADER_SIZE) / blockSize;
+			madvise(const_cast<uint8_t*>(data), size, MADV_RANDOM);
+			return true;
+		}
+
+		void close() {
+			if (data != nullptr) {
+				munmap(const_cast<uint8_t*>(data), size);
+			}
+			data = nullptr;
+			size = 0;
+			blockSize = 0;
+			blockCount = 0;
+		}
+
+		bool isOpen() const {
+			return data != nullptr;
+		}
+
+		size_t getBlockCount() const {
+			return blockCount;
+		}
+
+		uint32_t getBlockSamples(const size_t index) const {
+			return PmsHistoryFormat::getLe(getBlock(index), 2);
+		}
+
+		uint32_t getBlockFirst(const size_t index) const {
+			return PmsHistoryFormat::getLe(getBlock(index) + 4, 4);
+		}
+
+		uint32_t getBlockLast(const size_t index) const {
+			return PmsHistoryFormat::getLe(getBlock(index) + 8, 4);
+		}
+
+		// Index of the first block which can contain samples not older than timestamp, getBlockCount() if there is no such block
+		size_t findBlock(const uint32_t timestamp) const {
+			size_t low = 0;
+			size_t high = blockCount;
+			while (low < high) {
+				const size_t middle = low + (high - low) / 2;
+				if (getBlockLast(middle) < timestamp) {
+					low = middle + 1;
+				} else {
+					high = middle;
+				}
+			}
+			return low;
+		}
+
+		// handler(uint32_t timestamp, const PmsData& data)
+		template <typename Handler>
+		size_t decodeBlock(const size_t index, Handler&& handler) const {
+			return index < blockCount ? decodeHistoryBlock(getBlock(index), blockSize, handler) : 0;
+		}
+
+		// Decodes samples from range [from, to], only blocks overlapping the range are touched
+		template <typename Handler>
+		size_t read(const uint32_t from, const uint32_t to, Handler&& handler) const {
+			size_t result = 0;
+			for (size_t index = findBlock(from); index < blockCount && getBlockFirst(index) <= to; ++index) {
+				decodeBlock(index, [&](const uint32_t timestamp, const PmsData& data) {
+					if (timestamp >= from && timestamp <= to) {
+						++result;
+						handler(timestamp, data);
+					}
+				});
+			}
+			return result;
+		}
+	};
+
+#endif
+}
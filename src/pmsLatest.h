@@ -0,0 +1,92 @@
+#pragma once
+
+// The latest reading of a sensor shared with many readers (seqlock.h)
+//
+// The sampling thread (or loop()) owns Pms and publishes every outcome of read(). Readers (uploader, display, alarm logic, local API)
+// get a consistent copy of status, data and timestamp without locks: the sampling thread is never blocked by readers,
+// readers do not write shared memory. Version (number of publications) lets readers skip unchanged readings.
+//
+//   pmsx::PmsLatest latest;
+//   sampling thread:                        any other thread:
+//     pms.waitForData(...);                   pmsx::PmsReading reading;
+//     latest.read(pms);                       uint32_t version = 0;
+//                                             if (latest.getChanged(reading, version) && reading.isValid()) { ... }
+
+#include <pms.h>
+#include <seqlock.h>
+
+namespace pmsx {
+
+	template <typename Model>
+	struct BasicPmsReading {
+		unsigned long timestamp; // of status: getFrameTimestamp() if OK, millis() of detection otherwise
+		unsigned long dataTimestamp; // getFrameTimestamp() of data
+		PmsStatus status; // of the last read() that returned something (NO_DATA is not published)
+		BasicPmsData<Model> data; // the last frame with PmsStatus::OK, kept after errors
+
+		BasicPmsReading() : timestamp(0), dataTimestamp(0), status(PmsStatus::NO_DATA), data{} {}
+
+		// The last read() returned a frame: data are fresh
+		bool isValid() const {
+			return status == PmsStatus::OK;
+		}
+	};
+
+	template <typename Model>
+	class BasicPmsLatest {
+	public:
+		typedef BasicPmsReading<Model> reading_t;
+		typedef BasicPmsData<Model> data_t;
+
+	private:
+		jb::threads::seqlock<reading_t> slot;
+		reading_t last; // writer's copy: data survive errors
+
+	public:
+		BasicPmsLatest() = default;
+		BasicPmsLatest(const BasicPmsLatest&) = delete;
+		BasicPmsLatest& operator=(const BasicPmsLatest&) = delete;
+
+		// Writer side (single writer)
+		void publish(const PmsStatus status, const data_t& data, const unsigned long timestamp) {
+			last.status = status;
+			last.timestamp = timestamp;
+			if (status == PmsStatus::OK) {
+				last.data = data;
+				last.dataTimestamp = timestamp;
+			}
+			slot.store(last);
+		}
+
+		// Writer side: pms.read() and publication of its result (NO_DATA is returned, but not published)
+		template <typename SerialT>
+		PmsStatus read(BasicPms<Model, SerialT>& pms) {
+			data_t data;
+			const auto status = pms.read(data);
+			if (status == PmsStatus::OK) {
+				publish(status, data, pms.getFrameTimestamp());
+			} else if (status != PmsStatus::NO_DATA) {
+				publish(status, last.data, millis());
+			}
+			return status;
+		}
+
+		// Reader side: consistent copy of the latest reading, returns its version (0: nothing was published yet)
+		uint32_t get(reading_t& reading) const {
+			return slot.load(reading);
+		}
+
+		// Reader side: copies the reading only if it was published after the given version, version is updated
+		bool getChanged(reading_t& reading, uint32_t& version) const {
+			return slot.load_changed(reading, version);
+		}
+
+		// Number of publications
+		uint32_t getVersion() const {
+			return slot.version();
+		}
+	};
+
+	typedef BasicPmsReading<Pms5003> PmsReading;
+	typedef BasicPmsLatest<Pms5003> PmsLatest;
+}
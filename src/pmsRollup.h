@@ -0,0 +1,320 @@
+#pragma once
+
+// Multi-resolution history of PmsData in fixed memory: raw frames, minute and hour aggregates
+//
+// Every tier is a ring, the oldest entry is overwritten:
+//   RAW    - the last RawSize frames
+//   MINUTE - the last MinuteSize minutes: count, min, max, mean of every channel
+//   HOUR   - the last HourSize hours, the same aggregates
+// update() adds a frame to the raw ring and to the open minute and hour. A minute (hour) is closed by the first frame of a later one.
+// Periods without frames are missing, there are no empty aggregates.
+//
+// Timestamps are uint32_t seconds of a clock that does not wrap (epoch from RTC/NTP, PmsUptime), minutes and hours are aligned
+// to multiples of 60 and 3600. millis() / 1000 is not suitable: it wraps after 49.7 days, all later frames would be taken as
+// the latest one. Timestamps should not decrease: an older one is taken as the latest one.
+//
+// Queries select the coarsest tier with periods not longer than the requested resolution: a dashboard of a month
+// (resolution 3600) touches about 720 hour aggregates, never raw frames. If the tier does not keep the beginning of the range
+// any more, a coarser one is used. Entries are located using binary search.
+// Open (incomplete) minute and hour are reported as well, as the last entries.
+//
+//   pmsx::PmsRollup<60, 1440, 720> rollup; // a minute of frames, a day of minutes, 30 days of hours
+//   pmsx::PmsUptime uptime;
+//   if (pms.read(data) == pmsx::PmsStatus::OK) {
+//       rollup.update(uptime.getSeconds(), data);
+//   }
+//   rollup.query(now - 7 * 24 * 3600UL, now, 3600, [](const pmsx::PmsAggregate& hour) { ... hour.getMean(4) ... });
+//
+// RAM: RawSize * (4 + 2 * DATA_SIZE) + (MinuteSize + HourSize + 2) * (8 + 8 * DATA_SIZE) bytes, PmsRollup<60, 1440, 720>: about 240 KB
+
+#include <pms.h>
+
+namespace pmsx {
+
+	// Seconds since start, does not wrap with millis(): getSeconds() should be called at least once in 49 days
+	class PmsUptime {
+		unsigned long lastMillis;
+		unsigned long remainder; // ms not counted in seconds yet
+		uint32_t seconds;
+
+	public:
+		PmsUptime() : lastMillis(millis()), remainder(0), seconds(0) {}
+
+		uint32_t getSeconds() {
+			const auto now = millis();
+			remainder += now - lastMillis;
+			lastMillis = now;
+			seconds += static_cast<uint32_t>(remainder / 1000U);
+			remainder %= 1000U;
+			return seconds;
+		}
+	};
+
+	enum class PmsRollupTier : uint8_t {
+		RAW,
+		MINUTE,
+		HOUR
+	};
+
+	// Aggregate of frames from a period: count, min, max, sum of every channel
+	template <typename Model>
+	struct BasicPmsAggregate {
+		typedef BasicPmsData<Model> data_t;
+		static constexpr pmsIdx_t DATA_SIZE = data_t::DATA_SIZE;
+
+		uint32_t start; // beginning of the period (RAW: timestamp of the frame)
+		uint32_t count; // frames, 0 - empty
+		pmsData_t minimum[DATA_SIZE];
+		pmsData_t maximum[DATA_SIZE];
+		uint32_t sum[DATA_SIZE];
+
+		void reset(const uint32_t periodStart) {
+			start = periodStart;
+			count = 0;
+		}
+
+		void add(const data_t& data) {
+			for (pmsIdx_t i = 0; i < DATA_SIZE; ++i) {
+				const pmsData_t value = data.raw.getValue(i);
+				if (count == 0) {
+					minimum[i] = value;
+					maximum[i] = value;
+					sum[i] = value;
+				} else {
+					minimum[i] = min(minimum[i], value);
+					maximum[i] = max(maximum[i], value);
+					sum[i] += value;
+				}
+			}
+			++count;
+		}
+
+		// index: the same as PmsData::raw index
+		float getMean(const pmsIdx_t index) const {
+			return count == 0 ? NAN : static_cast<float>(sum[index]) / count;
+		}
+
+		pmsData_t getMin(const pmsIdx_t index) const {
+			return count == 0 ? 0 : minimum[index];
+		}
+
+		pmsData_t getMax(const pmsIdx_t index) const {
+			return count == 0 ? 0 : maximum[index];
+		}
+	};
+
+	typedef BasicPmsAggregate<Pms5003> PmsAggregate;
+
+	////////////////////////////////////////
+
+	// Ring of entries ordered by start, the oldest entry is overwritten
+	template <typename T, uint16_t Size>
+	class PmsRollupRing {
+		static_assert(Size > 0, "PmsRollupRing: Size should not be zero");
+
+		T entries[Size];
+		uint16_t first;
+		uint16_t count;
+
+	public:
+		PmsRollupRing() : first(0), count(0) {}
+
+		void clear() {
+			first = 0;
+			count = 0;
+		}
+
+		void push(const T& entry) {
+			if (count < Size) {
+				entries[(first + count) % Size] = entry;
+				++count;
+			} else {
+				entries[first] = entry;
+				first = static_cast<uint16_t>((first + 1) % Size);
+			}
+		}
+
+		uint16_t size() const {
+			return count;
+		}
+
+		// index: 0 - the oldest entry
+		const T& operator[](const uint16_t index) const {
+			return entries[(first + index) % Size];
+		}
+
+		// Index of the first entry with start + duration > timestamp (a period that ends after timestamp), size() if there is no such entry
+		uint16_t find(const uint32_t timestamp, const uint32_t duration) const {
+			uint16_t low = 0;
+			uint16_t high = count;
+			while (low < high) {
+				const uint16_t middle = static_cast<uint16_t>(low + (high - low) / 2);
+				if ((*this)[middle].start + duration <= timestamp) {
+					low = static_cast<uint16_t>(middle + 1);
+				} else {
+					high = middle;
+				}
+			}
+			return low;
+		}
+	};
+
+	////////////////////////////////////////
+
+	template <uint16_t RawSize, uint16_t MinuteSize, uint16_t HourSize, typename Model = Pms5003>
+	class PmsRollup {
+	public:
+		typedef BasicPmsData<Model> data_t;
+		typedef BasicPmsAggregate<Model> aggregate_t;
+
+		static constexpr uint32_t MINUTE = 60; // s
+		static constexpr uint32_t HOUR = 3600; // s
+
+	private:
+		struct Frame {
+			uint32_t start; // timestamp
+			data_t data;
+		};
+
+		PmsRollupRing<Frame, RawSize> frames;
+		PmsRollupRing<aggregate_t, MinuteSize> minutes;
+		PmsRollupRing<aggregate_t, HourSize> hours;
+		aggregate_t minute; // open minute
+		aggregate_t hour; // open hour
+		uint32_t first; // timestamp of the first frame
+		uint32_t last; // the latest timestamp
+		uint32_t updates;
+
+		// Pushes the open period to its ring when timestamp belongs to a later one
+		template <uint16_t Size>
+		static void roll(aggregate_t& open, PmsRollupRing<aggregate_t, Size>& ring, const uint32_t timestamp, const uint32_t duration) {
+			const uint32_t start = timestamp - timestamp % duration;
+			if (open.count > 0 && open.start != start) {
+				ring.push(open);
+			}
+			if (open.count == 0 || open.start != start) {
+				open.reset(start);
+			}
+		}
+
+		// handler(const aggregate_t&) for entries overlapping [from, to] and the open period
+		template <uint16_t Size, typename Handler>
+		static size_t visit(const PmsRollupRing<aggregate_t, Size>& ring, const aggregate_t& open, const uint32_t duration, const uint32_t from, const uint32_t to, Handler& handler) {
+			size_t result = 0;
+			for (uint16_t index = ring.find(from, duration); index < ring.size() && ring[index].start <= to; ++index) {
+				handler(ring[index]);
+				++result;
+			}
+			if (open.count > 0 && open.start + duration > from && open.start <= to) {
+				handler(open);
+				++result;
+			}
+			return result;
+		}
+
+	public:
+		PmsRollup() {
+			reset();
+		}
+
+		void reset() {
+			frames.clear();
+			minutes.clear();
+			hours.clear();
+			minute.reset(0);
+			hour.reset(0);
+			first = 0;
+			last = 0;
+			updates = 0;
+		}
+
+		// timestamp: seconds
+		void update(uint32_t timestamp, const data_t& data) {
+			if (updates == 0) {
+				first = timestamp;
+			} else if (timestamp < last) {
+				timestamp = last;
+			}
+			last = timestamp;
+			++updates;
+
+			frames.push(Frame{ timestamp, data });
+			roll(minute, minutes, timestamp, MINUTE);
+			minute.add(data);
+			roll(hour, hours, timestamp, HOUR);
+			hour.add(data);
+		}
+
+		// Length of periods of a tier, seconds
+		static uint32_t getDuration(const PmsRollupTier tier) {
+			return tier == PmsRollupTier::HOUR ? HOUR : tier == PmsRollupTier::MINUTE ? MINUTE : 1;
+		}
+
+		// The coarsest tier with periods not longer than resolution (seconds)
+		static PmsRollupTier getTier(const uint32_t resolution) {
+			return resolution >= HOUR ? PmsRollupTier::HOUR : resolution >= MINUTE ? PmsRollupTier::MINUTE : PmsRollupTier::RAW;
+		}
+
+		// Tier used by query(from, to, resolution): getTier(resolution), or the finest coarser one which still keeps from
+		// (or the first frame, if from is older). HOUR if none of them does
+		PmsRollupTier getTier(const uint32_t from, const uint32_t resolution) const {
+			const uint32_t start = max(from, first);
+			PmsRollupTier tier = getTier(resolution);
+			while (tier != PmsRollupTier::HOUR && getOldest(tier) > start) {
+				tier = tier == PmsRollupTier::RAW ? PmsRollupTier::MINUTE : PmsRollupTier::HOUR;
+			}
+			return tier;
+		}
+
+		// Closed entries kept by a tier (open minute and hour are not counted)
+		uint16_t getCount(const PmsRollupTier tier) const {
+			return tier == PmsRollupTier::HOUR ? hours.size() : tier == PmsRollupTier::MINUTE ? minutes.size() : frames.size();
+		}
+
+		// Start of the oldest entry of a tier (the open period if nothing was closed yet), 0 if it is empty
+		uint32_t getOldest(const PmsRollupTier tier) const {
+			switch (tier) {
+			case PmsRollupTier::HOUR:
+				return hours.size() > 0 ? hours[0].start : hour.count > 0 ? hour.start : 0;
+			case PmsRollupTier::MINUTE:
+				return minutes.size() > 0 ? minutes[0].start : minute.count > 0 ? minute.start : 0;
+			default:
+				return frames.size() > 0 ? frames[0].start : 0;
+			}
+		}
+
+		// Frames added since construction (or reset())
+		uint32_t getUpdates() const {
+			return updates;
+		}
+
+		// handler(const aggregate_t& entry) for every entry of the tier overlapping [from, to], oldest first
+		// RAW entries are single frames (count 1). Returns number of entries
+		template <typename Handler>
+		size_t query(const PmsRollupTier tier, const uint32_t from, const uint32_t to, Handler&& handler) const {
+			switch (tier) {
+			case PmsRollupTier::HOUR:
+				return visit(hours, hour, HOUR, from, to, handler);
+			case PmsRollupTier::MINUTE:
+				return visit(minutes, minute, MINUTE, from, to, handler);
+			default:
+				break;
+			}
+			size_t result = 0;
+			aggregate_t entry;
+			for (uint16_t index = frames.find(from, 1); index < frames.size() && frames[index].start <= to; ++index) {
+				entry.reset(frames[index].start);
+				entry.add(frames[index].data);
+				handler(static_cast<const aggregate_t&>(entry));
+				++result;
+			}
+			return result;
+		}
+
+		// The same, the tier is selected by resolution (seconds) and from: getTier(from, resolution)
+		template <typename Handler>
+		size_t query(const uint32_t from, const uint32_t to, const uint32_t resolution, Handler&& handler) const {
+			return query(getTier(from, resolution), from, to, handler);
+		}
+	};
+}
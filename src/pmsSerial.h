@@ -1,17 +1,96 @@
 #pragma once
 
+#include <stdint.h>
+#include <stddef.h>
+#include <Arduino.h>
+
 class IPmsSerial {
 public:
 	virtual ~IPmsSerial() = default;
-	virtual bool begin(uint32_t baudRate);
-	virtual void end();
+	virtual bool begin(uint32_t baudRate) = 0;
+	virtual void end() = 0;
+
+	virtual void setTimeout(unsigned long int timeout) = 0;
+	virtual size_t available() = 0;
+
+	virtual void flushInput() = 0;
+	virtual uint8_t peek() = 0;
+	virtual uint8_t read() = 0;
+	virtual size_t read(uint8_t *buffer, size_t length) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size) = 0;
+
+	// Blocks till there is something to read or timeout (ms) is over, returns true if data are available
+	// Default: available() is polled every millisecond. Drivers should wait on the transport (poll() on the descriptor, receive interrupt)
+	virtual bool waitForInput(unsigned long int timeout) {
+		const auto t0 = millis();
+		while (available() == 0) {
+			if (millis() - t0 >= timeout) {
+				return false;
+			}
+			delay(1);
+		}
+		return true;
+	}
+};
+
+// Type erasure: any serial driver (with the same methods as IPmsSerial, virtual or not) as IPmsSerial
+// Handy if the driver is chosen at runtime: IPmsSerial* serial = &adapter;
+// waitForInput() is optional: drivers without it (plain Stream-like classes) get the polling default of IPmsSerial
+template <typename SerialT>
+class PmsSerialAdapter final : public IPmsSerial {
+	SerialT& serial;
+
+	// Selected if SerialT::waitForInput() exists (int argument is a better match than long)
+	template <typename T>
+	static auto waitForInput(T& driver, const unsigned long int timeout, int) -> decltype(static_cast<bool>(driver.waitForInput(timeout))) {
+		return driver.waitForInput(timeout);
+	}
+
+	template <typename T>
+	bool waitForInput(T&, const unsigned long int timeout, long) {
+		return IPmsSerial::waitForInput(timeout);
+	}
+
+public:
+	explicit PmsSerialAdapter(SerialT& serial) : serial(serial) {}
+
+	bool begin(const uint32_t baudRate) override {
+		return serial.begin(baudRate);
+	}
+
+	void end() override {
+		serial.end();
+	}
+
+	void setTimeout(const unsigned long int timeout) override {
+		serial.setTimeout(timeout);
+	}
+
+	size_t available() override {
+		return serial.available();
+	}
+
+	void flushInput() override {
+		serial.flushInput();
+	}
+
+	uint8_t peek() override {
+		return serial.peek();
+	}
+
+	uint8_t read() override {
+		return serial.read();
+	}
+
+	size_t read(uint8_t *buffer, const size_t length) override {
+		return serial.read(buffer, length);
+	}
 
-	virtual void setTimeout(unsigned long int timeout);
-	virtual size_t available();
+	size_t write(const uint8_t *buffer, const size_t size) override {
+		return serial.write(buffer, size);
+	}
 
-	virtual void flushInput();
-	virtual uint8_t peek();
-	virtual uint8_t read();
-	virtual size_t read(uint8_t *buffer, size_t length);
-	virtual size_t write(const uint8_t *buffer, size_t size);
+	bool waitForInput(const unsigned long int timeout) override {
+		return waitForInput(serial, timeout, 0);
+	}
 };
@@ -2,8 +2,11 @@
 
 #include <pmsSerial.h>
 #include <AltSoftSerial.h>
+#ifdef __AVR__
+#include <avr/sleep.h>
+#endif
 
-class PmsAltSerial : public IPmsSerial {
+class PmsAltSerial final : public IPmsSerial {
 	AltSoftSerial serial;
 public:
 	void setTimeout(const unsigned long int timeout) override {
@@ -41,4 +44,20 @@ public:
 	size_t write(const uint8_t *buffer, const size_t size) override {
 		return serial.write(buffer, size);
 	}
+
+#ifdef __AVR__
+	// Receive interrupt fills the buffer: the CPU idles between checks, woken by any interrupt (received edge, timer0 tick of millis())
+	// Other architectures: the polling default of IPmsSerial
+	bool waitForInput(const unsigned long int timeout) override {
+		const auto t0 = millis();
+		set_sleep_mode(SLEEP_MODE_IDLE);
+		while (!serial.available()) {
+			if (millis() - t0 >= timeout) {
+				return false;
+			}
+			sleep_mode();
+		}
+		return true;
+	}
+#endif
 };
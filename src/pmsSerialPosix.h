@@ -0,0 +1,235 @@
+#pragma once
+
+// IPmsSerial implementation for POSIX hosts (Linux gateways)
+//
+// Works with any file descriptor:
+//   tty (USB-serial adapters: /dev/ttyUSB0, /dev/ttyAMA0) - configured using termios: raw, 8N1, requested baud rate
+//   pty (slave side of a pty pair, for example created by socat) - local stand-in for a real sensor
+//   pipe, socket - termios is skipped
+//
+// Descriptor is always switched to non-blocking mode:
+//   available() uses FIONREAD, does not block
+//   read(buffer, length) behaves like Arduino Stream::readBytes(): returns immediately if data are available, otherwise waits up to timeout
+//   waitForInput() blocks in poll(): no CPU is used while waiting, wakes up when the first byte arrives
+
+#include <Arduino.h>
+#include <pmsSerial.h>
+
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+class PmsPosixSerial final : public IPmsSerial {
+	const char* path;
+	int fd;
+	bool ownFd;
+	int timeout;
+	int peeked;
+
+	static constexpr int NO_PEEK = -1;
+
+	static speed_t toSpeed(const uint32_t baudRate) {
+		switch (baudRate) {
+		case 1200: return B1200;
+		case 2400: return B2400;
+		case 4800: return B4800;
+		case 9600: return B9600;
+		case 19200: return B19200;
+		case 38400: return B38400;
+		case 57600: return B57600;
+		case 115200: return B115200;
+		default: return B0;
+		}
+	}
+
+	bool configureTty(const uint32_t baudRate) const {
+		if (!isatty(fd)) {
+			return true;
+		}
+		const auto speed = toSpeed(baudRate);
+		if (speed == B0) {
+			return false;
+		}
+
+		termios tio{};
+		if (tcgetattr(fd, &tio) != 0) {
+			return false;
+		}
+		cfmakeraw(&tio);
+		tio.c_cflag &= ~(CSTOPB | PARENB | CSIZE);
+		tio.c_cflag |= CS8 | CLOCAL | CREAD;
+#ifdef CRTSCTS
+		tio.c_cflag &= ~CRTSCTS; // sensor has no RTS/CTS lines
+#endif
+		tio.c_cc[VMIN] = 0;
+		tio.c_cc[VTIME] = 0;
+		cfsetispeed(&tio, speed);
+		cfsetospeed(&tio, speed);
+		return tcsetattr(fd, TCSANOW, &tio) == 0;
+	}
+
+	bool waitFor(const short events, const int waitTime) const {
+		pollfd pfd{ fd, events, 0 };
+		int result;
+		do {
+			result = poll(&pfd, 1, waitTime);
+		} while (result < 0 && errno == EINTR);
+		return result > 0 && (pfd.revents & events);
+	}
+
+	ssize_t readSome(uint8_t* buffer, const size_t length) const {
+		ssize_t result;
+		do {
+			result = ::read(fd, buffer, length);
+		} while (result < 0 && errno == EINTR);
+		return result;
+	}
+
+public:
+	explicit PmsPosixSerial(const char* path) : path(path), fd(-1), ownFd(true), timeout(0), peeked(NO_PEEK) {}
+
+	// Adopts already opened descriptor (pty master, socketpair, ...). Descriptor is not closed by end()
+	explicit PmsPosixSerial(const int fd) : path(nullptr), fd(fd), ownFd(false), timeout(0), peeked(NO_PEEK) {}
+
+	~PmsPosixSerial() override {
+		end();
+	}
+
+	PmsPosixSerial(const PmsPosixSerial&) = delete;
+	PmsPosixSerial& operator=(const PmsPosixSerial&) = delete;
+
+	int getFd() const {
+		return fd;
+	}
+
+	bool begin(const uint32_t baudRate) override {
+		if (fd < 0 && path != nullptr) {
+			fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+		}
+		if (fd < 0) {
+			return false;
+		}
+		const auto flags = fcntl(fd, F_GETFL);
+		if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0 || !configureTty(baudRate)) {
+			end();
+			return false;
+		}
+		peeked = NO_PEEK;
+		return true;
+	}
+
+	void end() override {
+		if (ownFd && fd >= 0) {
+			close(fd);
+			fd = -1;
+		}
+		peeked = NO_PEEK;
+	}
+
+	void setTimeout(const unsigned long int timeout) override {
+		this->timeout = static_cast<int>(timeout);
+	}
+
+	size_t available() override {
+		if (fd < 0) {
+			return 0;
+		}
+		int count = 0;
+		if (ioctl(fd, FIONREAD, &count) != 0 || count < 0) {
+			count = 0;
+		}
+		return static_cast<size_t>(count) + (peeked == NO_PEEK ? 0 : 1);
+	}
+
+	void flushInput() override {
+		peeked = NO_PEEK;
+		if (fd < 0) {
+			return;
+		}
+		if (isatty(fd)) {
+			tcflush(fd, TCIFLUSH);
+		}
+		uint8_t buffer[64];
+		while (readSome(buffer, sizeof buffer) > 0) {}
+	}
+
+	uint8_t peek() override {
+		if (peeked == NO_PEEK) {
+			uint8_t value;
+			if (fd >= 0 && readSome(&value, 1) == 1) {
+				peeked = value;
+			}
+		}
+		return peeked == NO_PEEK ? UINT8_MAX : static_cast<uint8_t>(peeked);
+	}
+
+	uint8_t read() override {
+		uint8_t value = UINT8_MAX;
+		read(&value, 1);
+		return value;
+	}
+
+	size_t read(uint8_t* buffer, const size_t length) override {
+		size_t done = 0;
+		if (length > 0 && peeked != NO_PEEK) {
+			buffer[done++] = static_cast<uint8_t>(peeked);
+			peeked = NO_PEEK;
+		}
+		if (fd < 0) {
+			return done;
+		}
+		const auto t0 = millis();
+		while (done < length) {
+			const auto result = readSome(buffer + done, length - done);
+			if (result > 0) {
+				done += static_cast<size_t>(result);
+				continue;
+			}
+			if (result == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+				break;
+			}
+			const auto elapsed = static_cast<int>(millis() - t0);
+			if (elapsed >= timeout || !waitFor(POLLIN, timeout - elapsed)) {
+				break;
+			}
+		}
+		return done;
+	}
+
+	size_t write(const uint8_t* buffer, const size_t size) override {
+		if (fd < 0) {
+			return 0;
+		}
+		size_t done = 0;
+		while (done < size) {
+			const auto result = ::write(fd, buffer + done, size - done);
+			if (result > 0) {
+				done += static_cast<size_t>(result);
+				continue;
+			}
+			if (result < 0 && errno == EINTR) {
+				continue;
+			}
+			if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && waitFor(POLLOUT, timeout)) {
+				continue;
+			}
+			break;
+		}
+		return done;
+	}
+
+	bool waitForInput(const unsigned long int timeout) override {
+		if (available() > 0) {
+			return true;
+		}
+		if (fd < 0) {
+			return false;
+		}
+		const auto waitTime = static_cast<int>(min(timeout, static_cast<unsigned long int>(INT_MAX)));
+		return waitFor(POLLIN, waitTime) && available() > 0;
+	}
+};
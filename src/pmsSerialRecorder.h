@@ -0,0 +1,415 @@
+#pragma once
+
+// Recording and replay of the serial byte stream
+//
+// PmsRecorderSerial<Sink, SerialT>: IPmsSerial decorator, every byte read from (or written to) the wrapped driver is appended to a capture
+//   Sink is anything with size_t write(const uint8_t*, size_t), like PmsHistoryWriter (Arduino SD File, pmsx::PmsHistoryFile, ...)
+//   bytes dropped by flushInput() are recorded as dropped: the capture contains everything that came off the wire
+//
+// PmsReplaySerial: IPmsSerial, feeds a capture back through Pms (Pms::available(), Pms::read(), the parser - the real code)
+//   speed 1: real time, bytes become available at recorded times
+//   speed N > 1: N times faster
+//   speed 0: as fast as possible, timestamps are ignored: a week of data is replayed in seconds
+//   written bytes (commands) are accepted and counted, recorded commands are skipped
+//   dropped bytes are skipped (counted by getDiscarded()): the replayed Pms sees the bytes the live one read
+//
+// Capture layout (numbers little endian, varints as in pmsHistory.h):
+//   header (16 bytes): "PMSR", version, 3 reserved bytes, baud rate (4 bytes), millis() at start of the recording (4 bytes)
+//   records: varint(milliseconds since the previous record), varint(size * 4 + direction), size bytes
+//   direction: 0 - received (read by the host), 1 - sent (written by the host), 2 - dropped (by flushInput(), never read)
+//   version 1 (still replayed): varint(size * 2 + direction), dropped bytes are recorded as received
+//
+// Usage:
+//   pmsx::PmsHistoryFile file(fopen("site.pmsr", "wb"));
+//   PmsRecorderSerial<pmsx::PmsHistoryFile> recorder(pmsSerial, file);
+//   pmsx::Pms pms(&recorder);
+//
+//   pmsx::PmsCaptureFile capture;
+//   capture.open("site.pmsr");
+//   PmsReplaySerial replay(capture.getData(), capture.getSize(), 0);
+//   pmsx::Pms pms(&replay);
+//   pms.begin();
+//   while (!replay.isFinished()) {
+//       pms.read(data);
+//   }
+
+#include <Arduino.h>
+#include <pmsSerial.h>
+#include <pmsHistory.h>
+
+class PmsRecordFormat {
+public:
+	static constexpr uint8_t VERSION = 2;
+	static constexpr size_t FILE_HEADER_SIZE = 16;
+	static constexpr size_t MAX_RECORD_HEADER_SIZE = 10; // two varints
+	static constexpr uint8_t DIRECTION_BITS = 2; // version 1: 1
+	static constexpr uint8_t RECEIVED = 0;
+	static constexpr uint8_t SENT = 1;
+	static constexpr uint8_t DROPPED = 2;
+
+	static void putFileHeader(uint8_t* header, const uint32_t baudRate, const uint32_t started) {
+		memset(header, 0, FILE_HEADER_SIZE);
+		memcpy(header, "PMSR", 4);
+		header[4] = VERSION;
+		pmsx::PmsHistoryFormat::putLe(header + 8, baudRate, 4);
+		pmsx::PmsHistoryFormat::putLe(header + 12, started, 4);
+	}
+
+	static bool isFileHeader(const uint8_t* header, const size_t size) {
+		return size >= FILE_HEADER_SIZE && memcmp(header, "PMSR", 4) == 0 && header[4] >= 1 && header[4] <= VERSION;
+	}
+
+	// Bits of the direction in the second varint of a record
+	static uint8_t getDirectionBits(const uint8_t* header) {
+		return header[4] == 1 ? 1 : DIRECTION_BITS;
+	}
+};
+
+////////////////////////////////////////
+
+template <typename Sink, typename SerialT = IPmsSerial, size_t BufferSize = 256>
+class PmsRecorderSerial final : public IPmsSerial {
+	static_assert(BufferSize >= PmsRecordFormat::FILE_HEADER_SIZE + PmsRecordFormat::MAX_RECORD_HEADER_SIZE, "PmsRecorderSerial: BufferSize is too small");
+
+	SerialT& serial;
+	Sink& sink;
+	uint8_t buffer[BufferSize];
+	size_t used;
+	bool started; // file header is written
+	unsigned long last; // millis() of the previous record
+	unsigned long recorded;
+	bool failed;
+
+	void put(const uint8_t* data, const size_t size) {
+		if (used + size > BufferSize) {
+			flush();
+		}
+		if (size > BufferSize) {
+			failed = failed || sink.write(data, size) != size;
+			return;
+		}
+		memcpy(buffer + used, data, size);
+		used += size;
+	}
+
+	void start(const uint32_t baudRate) {
+		if (started) {
+			return;
+		}
+		started = true;
+		last = millis();
+		uint8_t header[PmsRecordFormat::FILE_HEADER_SIZE];
+		PmsRecordFormat::putFileHeader(header, baudRate, static_cast<uint32_t>(last));
+		put(header, sizeof header);
+	}
+
+	void record(const uint8_t direction, const uint8_t* data, const size_t size) {
+		if (size == 0) {
+			return;
+		}
+		start(0);
+		const auto now = millis();
+		uint8_t header[PmsRecordFormat::MAX_RECORD_HEADER_SIZE];
+		uint8_t* end = pmsx::PmsHistoryFormat::putVarint(header, static_cast<uint32_t>(now - last));
+		end = pmsx::PmsHistoryFormat::putVarint(end, static_cast<uint32_t>(size << PmsRecordFormat::DIRECTION_BITS | direction));
+		last = now;
+		put(header, static_cast<size_t>(end - header));
+		put(data, size);
+		recorded += size;
+	}
+
+public:
+	PmsRecorderSerial(SerialT& serial, Sink& sink) : serial(serial), sink(sink), used(0), started(false), last(0), recorded(0), failed(false) {}
+
+	~PmsRecorderSerial() {
+		flush();
+	}
+
+	PmsRecorderSerial(const PmsRecorderSerial&) = delete;
+	PmsRecorderSerial& operator=(const PmsRecorderSerial&) = delete;
+
+	// Buffered records are written to the sink. Called automatically when the buffer is full and by the destructor
+	bool flush() {
+		if (used > 0) {
+			failed = failed || sink.write(buffer, used) != used;
+			used = 0;
+		}
+		return !failed;
+	}
+
+	// Bytes recorded (both directions)
+	unsigned long getRecorded() const {
+		return recorded;
+	}
+
+	// A write to the sink failed, capture is incomplete
+	bool isFailed() const {
+		return failed;
+	}
+
+	////////////////////////////////////////
+	// IPmsSerial
+
+	bool begin(const uint32_t baudRate) override {
+		start(baudRate);
+		return serial.begin(baudRate);
+	}
+
+	void end() override {
+		serial.end();
+		flush();
+	}
+
+	void setTimeout(const unsigned long int timeout) override {
+		serial.setTimeout(timeout);
+	}
+
+	size_t available() override {
+		return serial.available();
+	}
+
+	void flushInput() override {
+		uint8_t dropped[32];
+		for (size_t size = serial.available(); size > 0; size = serial.available()) {
+			const auto done = serial.read(dropped, min(size, sizeof dropped));
+			if (done == 0) {
+				break;
+			}
+			record(PmsRecordFormat::DROPPED, dropped, done);
+		}
+		serial.flushInput();
+	}
+
+	uint8_t peek() override {
+		return serial.peek();
+	}
+
+	uint8_t read() override {
+		const uint8_t value = serial.read();
+		record(PmsRecordFormat::RECEIVED, &value, 1);
+		return value;
+	}
+
+	size_t read(uint8_t* buffer, const size_t length) override {
+		const auto done = serial.read(buffer, length);
+		record(PmsRecordFormat::RECEIVED, buffer, done);
+		return done;
+	}
+
+	size_t write(const uint8_t* buffer, const size_t size) override {
+		const auto done = serial.write(buffer, size);
+		record(PmsRecordFormat::SENT, buffer, done);
+		return done;
+	}
+
+	bool waitForInput(const unsigned long int timeout) override {
+		return serial.waitForInput(timeout);
+	}
+};
+
+////////////////////////////////////////
+
+class PmsReplaySerial final : public IPmsSerial {
+	const uint8_t* data;
+	const uint8_t* limit; // end of the capture
+	const uint8_t* next; // the next record
+	const uint8_t* chunk; // received bytes of the current record
+	size_t left;
+	unsigned int speed;
+	unsigned long started; // millis() at begin()
+	uint32_t timestamp; // recorded millis() of the current record
+	uint32_t first; // recorded millis() at start of the recording
+	uint32_t baudRate;
+	uint8_t directionBits; // of the capture version
+	bool running;
+	bool truncated;
+	unsigned long received;
+	unsigned long sent;
+	unsigned long discarded;
+
+	// Milliseconds till the record is due, 0 if it is due (or speed is 0)
+	unsigned long getWait(const uint32_t recordTimestamp) const {
+		if (speed == 0) {
+			return 0;
+		}
+		const unsigned long due = (recordTimestamp - first) / speed;
+		const unsigned long now = millis() - started;
+		return due > now ? due - now : 0;
+	}
+
+	// Decodes due records till the next one with received bytes
+	bool nextChunk() {
+		while (running && next < limit) {
+			uint32_t delta;
+			uint32_t kind;
+			const uint8_t* where = pmsx::PmsHistoryFormat::getVarint(next, limit, delta);
+			if (where != nullptr) {
+				where = pmsx::PmsHistoryFormat::getVarint(where, limit, kind);
+			}
+			if (where == nullptr || (kind >> directionBits) > static_cast<size_t>(limit - where)) {
+				truncated = true;
+				next = limit;
+				return false;
+			}
+			if (getWait(timestamp + delta) > 0) {
+				return false;
+			}
+			const size_t size = kind >> directionBits;
+			const uint8_t direction = static_cast<uint8_t>(kind & ((1U << directionBits) - 1));
+			timestamp += delta;
+			next = where + size;
+			if (direction == PmsRecordFormat::SENT) {
+				continue;
+			}
+			if (direction == PmsRecordFormat::DROPPED) {
+				// The live Pms never read them
+				discarded += size;
+				continue;
+			}
+			chunk = where;
+			left = size;
+			return true;
+		}
+		return false;
+	}
+
+	uint8_t pop() {
+		--left;
+		++received;
+		return *chunk++;
+	}
+
+public:
+	// speed: 0 - as fast as possible, 1 - real time, N - N times faster
+	PmsReplaySerial(const uint8_t* data, const size_t size, const unsigned int speed = 1) :
+		data(data), limit(data + size), next(data + size), chunk(data), left(0), speed(speed), started(0), timestamp(0), first(0), baudRate(0), directionBits(PmsRecordFormat::DIRECTION_BITS),
+		running(false), truncated(false), received(0), sent(0), discarded(0) {
+	}
+
+	PmsReplaySerial(const PmsReplaySerial&) = delete;
+	PmsReplaySerial& operator=(const PmsReplaySerial&) = delete;
+
+	// All received bytes were replayed
+	bool isFinished() const {
+		return left == 0 && next >= limit;
+	}
+
+	// Recorded millis() of the bytes being read
+	uint32_t getTimestamp() const {
+		return timestamp;
+	}
+
+	// Baud rate of the recording, 0 if it is not known
+	uint32_t getBaudRate() const {
+		return baudRate;
+	}
+
+	// The capture ends in the middle of a record
+	bool isTruncated() const {
+		return truncated;
+	}
+
+	unsigned long getReceived() const {
+		return received;
+	}
+
+	unsigned long getSent() const {
+		return sent;
+	}
+
+	// Bytes dropped by flushInput() of the recorded Pms
+	unsigned long getDiscarded() const {
+		return discarded;
+	}
+
+	////////////////////////////////////////
+	// IPmsSerial
+
+	// Rewinds the capture, false if it is not a capture
+	bool begin(uint32_t) override {
+		running = PmsRecordFormat::isFileHeader(data, static_cast<size_t>(limit - data));
+		if (!running) {
+			return false;
+		}
+		baudRate = pmsx::PmsHistoryFormat::getLe(data + 8, 4);
+		first = pmsx::PmsHistoryFormat::getLe(data + 12, 4);
+		directionBits = PmsRecordFormat::getDirectionBits(data);
+		timestamp = first;
+		next = data + PmsRecordFormat::FILE_HEADER_SIZE;
+		left = 0;
+		truncated = false;
+		received = 0;
+		sent = 0;
+		discarded = 0;
+		started = millis();
+		return true;
+	}
+
+	void end() override {
+		running = false;
+	}
+
+	void setTimeout(unsigned long int) override {}
+
+	size_t available() override {
+		if (left == 0) {
+			nextChunk();
+		}
+		return left;
+	}
+
+	// Dropped bytes are separate records (skipped by available()), received ones were read by the live Pms: nothing to drop
+	// Version 1 capture: dropped bytes were recorded as received, the current record is dropped
+	void flushInput() override {
+		if (directionBits != 1) {
+			return;
+		}
+		discarded += left;
+		chunk += left;
+		left = 0;
+	}
+
+	uint8_t peek() override {
+		return available() == 0 ? UINT8_MAX : *chunk;
+	}
+
+	uint8_t read() override {
+		return available() == 0 ? UINT8_MAX : pop();
+	}
+
+	size_t read(uint8_t* buffer, const size_t length) override {
+		size_t done = 0;
+		while (done < length && available() > 0) {
+			const auto size = min(length - done, left);
+			memcpy(buffer + done, chunk, size);
+			chunk += size;
+			left -= size;
+			received += size;
+			done += size;
+		}
+		return done;
+	}
+
+	size_t write(const uint8_t*, const size_t size) override {
+		if (!running) {
+			return 0;
+		}
+		sent += size;
+		return size;
+	}
+
+	// Sleeps till the next recorded bytes are due, returns immediately at the end of the capture (or if speed is 0)
+	bool waitForInput(const unsigned long int timeout) override {
+		const auto t0 = millis();
+		while (available() == 0) {
+			const auto elapsed = millis() - t0;
+			if (isFinished() || speed == 0 || elapsed >= timeout) {
+				return false;
+			}
+			uint32_t delta;
+			const unsigned long wait = pmsx::PmsHistoryFormat::getVarint(next, limit, delta) == nullptr ? 1 : getWait(timestamp + delta);
+			delay(max(min(wait, timeout - elapsed), 1UL));
+		}
+		return true;
+	}
+};
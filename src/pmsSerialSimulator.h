@@ -0,0 +1,340 @@
+#pragma once
+
+// IPmsSerial implementation simulating PMS5003 sensor (other models: BasicPmsSimSerial<Model>), no hardware is required
+//
+// Simulator:
+//   answers PmsCmd commands sent by Pms::write(): CMD_READ_DATA, CMD_MODE_PASSIVE, CMD_MODE_ACTIVE, CMD_SLEEP, CMD_WAKEUP
+//   emits data frames: in active mode every getInterval() milliseconds, in passive mode after CMD_READ_DATA
+//   injects faults on demand: garbage, truncated frames, bad checksums, wrong frame length
+//
+// Sensor output is kept in a fixed size ring (like UART receive buffer). Bytes are lost if nobody reads them (see getOverruns())
+
+#include <Arduino.h>
+#include <pms.h>
+
+template <typename Model>
+class BasicPmsSimSerial final : public IPmsSerial {
+public:
+	typedef pmsx::BasicPmsData<Model> data_t;
+	typedef pmsx::BasicPmsParser<Model> parser_t;
+
+	static constexpr size_t BUFFER_SIZE = 256;
+	static constexpr unsigned long ACTIVE_INTERVAL = 1000U;
+
+private:
+	uint8_t buffer[BUFFER_SIZE];
+	size_t head;
+	size_t count;
+
+	uint8_t command[7];
+	uint8_t commandLen;
+
+	data_t data;
+	bool modeActive;
+	bool modeSleep;
+	bool running;
+	unsigned long interval;
+	unsigned long warmup;
+	unsigned long lastFrame;
+	unsigned long readyAt;
+
+	uint32_t seed;
+
+	unsigned long framesSent;
+	unsigned long faultsInjected;
+	unsigned long commandsReceived;
+	unsigned long overruns;
+
+	void push(const uint8_t value) {
+		if (count == BUFFER_SIZE) {
+			++overruns;
+			return;
+		}
+		buffer[(head + count) % BUFFER_SIZE] = value;
+		++count;
+	}
+
+	void push(const uint8_t* values, const size_t size) {
+		for (size_t i = 0; i < size; ++i) {
+			push(values[i]);
+		}
+	}
+
+	uint8_t pop() {
+		const auto value = buffer[head];
+		head = (head + 1) % BUFFER_SIZE;
+		--count;
+		return value;
+	}
+
+	static void putWord(uint8_t* where, const pmsx::pmsData_t value) {
+		where[0] = static_cast<uint8_t>(value >> 8);
+		where[1] = static_cast<uint8_t>(value);
+	}
+
+	static pmsx::pmsData_t sum(const uint8_t* values, const size_t size) {
+		pmsx::pmsData_t result = 0;
+		for (size_t i = 0; i < size; ++i) {
+			result += values[i];
+		}
+		return result;
+	}
+
+	void buildFrame(uint8_t* frame) const {
+		frame[0] = parser_t::SIG0;
+		frame[1] = parser_t::SIG1;
+		putWord(frame + 2, data_t::FRAME_SIZE - parser_t::HEADER_SIZE);
+		for (pmsx::pmsIdx_t i = 0; i < data_t::DATA_SIZE; ++i) {
+			putWord(frame + parser_t::HEADER_SIZE + i * sizeof(pmsx::pmsData_t), data.raw.getValue(i));
+		}
+		constexpr size_t crcPos = data_t::FRAME_SIZE - sizeof(pmsx::pmsData_t);
+		putWord(frame + crcPos, sum(frame, crcPos));
+	}
+
+	void sendResponse(const uint8_t cmd, const uint8_t value) {
+		uint8_t frame[data_t::RESPONSE_FRAME_SIZE]{ parser_t::SIG0, parser_t::SIG1, 0x00, 0x04, cmd, value };
+		putWord(frame + 6, sum(frame, 6));
+		push(frame, sizeof frame);
+	}
+
+	bool isReady() const {
+		return running && !modeSleep && static_cast<long>(millis() - readyAt) >= 0;
+	}
+
+	void execute() {
+		++commandsReceived;
+		const uint8_t cmd = command[2];
+		const uint8_t value = command[4];
+		switch (cmd) {
+		case 0xe2:
+			if (isReady() && !modeActive) {
+				emitFrame();
+			}
+			break;
+		case 0xe1:
+			if (!isReady()) {
+				break;
+			}
+			modeActive = value != 0;
+			lastFrame = millis();
+			sendResponse(cmd, value);
+			break;
+		case 0xe4:
+			if (value == 0) {
+				if (isReady()) {
+					sendResponse(cmd, value);
+				}
+				modeSleep = true;
+			} else if (modeSleep) {
+				wakeup();
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	uint32_t nextRandom() {
+		// xorshift32: deterministic garbage, repeatable benchmarks
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		return seed;
+	}
+
+public:
+	BasicPmsSimSerial() : head(0), count(0), commandLen(0), data{}, modeActive(true), modeSleep(false), running(false),
+		interval(ACTIVE_INTERVAL), warmup(0), lastFrame(0), readyAt(0), seed(0x5eed5eed), framesSent(0), faultsInjected(0), commandsReceived(0), overruns(0) {
+	}
+
+	////////////////////////////////////////
+	// Sensor behavior
+
+	// Values sent in the next frames
+	void setData(const data_t& newData) {
+		data = newData;
+	}
+
+	const data_t& getData() const {
+		return data;
+	}
+
+	// Active mode frame period, 0: frames are emitted only on demand (emitFrame())
+	void setInterval(const unsigned long newInterval) {
+		interval = newInterval;
+	}
+
+	unsigned long getInterval() const {
+		return interval;
+	}
+
+	bool isModeActive() const {
+		return modeActive;
+	}
+
+	bool isModeSleep() const {
+		return modeSleep;
+	}
+
+	// Time after CMD_WAKEUP, sensor does not respond
+	void setWarmup(const unsigned long newWarmup) {
+		warmup = newWarmup;
+	}
+
+	unsigned long getWarmup() const {
+		return warmup;
+	}
+
+	// Sensor leaves sleep mode in active mode and is blind for getWarmup() milliseconds
+	void wakeup() {
+		modeSleep = false;
+		modeActive = true;
+		readyAt = millis() + warmup;
+		lastFrame = readyAt;
+	}
+
+	// Emits active mode frames (if it is time to do it). Called by available()
+	void update() {
+		if (!isReady() || !modeActive || interval == 0) {
+			return;
+		}
+		const auto now = millis();
+		if (now - lastFrame >= interval) {
+			lastFrame = now;
+			emitFrame();
+		}
+	}
+
+	////////////////////////////////////////
+	// Frames on demand
+
+	void emitFrame() {
+		uint8_t frame[data_t::FRAME_SIZE];
+		buildFrame(frame);
+		push(frame, sizeof frame);
+		++framesSent;
+	}
+
+	void injectGarbage(const size_t size) {
+		for (size_t i = 0; i < size; ++i) {
+			push(static_cast<uint8_t>(nextRandom()));
+		}
+		++faultsInjected;
+	}
+
+	// Arbitrary bytes: crafted garbage, response frames
+	void injectBytes(const uint8_t* values, const size_t size) {
+		push(values, size);
+		++faultsInjected;
+	}
+
+	// Only the first size bytes of a frame are sent
+	void injectTruncatedFrame(const size_t size) {
+		uint8_t frame[data_t::FRAME_SIZE];
+		buildFrame(frame);
+		push(frame, min(size, sizeof frame));
+		++faultsInjected;
+	}
+
+	void injectBadChecksum() {
+		uint8_t frame[data_t::FRAME_SIZE];
+		buildFrame(frame);
+		frame[sizeof frame - 1] ^= 0x01;
+		push(frame, sizeof frame);
+		++faultsInjected;
+	}
+
+	void injectBadLength() {
+		uint8_t frame[data_t::FRAME_SIZE];
+		buildFrame(frame);
+		putWord(frame + 2, data_t::FRAME_SIZE);
+		constexpr size_t crcPos = data_t::FRAME_SIZE - sizeof(pmsx::pmsData_t);
+		putWord(frame + crcPos, sum(frame, crcPos));
+		push(frame, sizeof frame);
+		++faultsInjected;
+	}
+
+	////////////////////////////////////////
+	// Statistics
+
+	unsigned long getFramesSent() const {
+		return framesSent;
+	}
+
+	unsigned long getFaultsInjected() const {
+		return faultsInjected;
+	}
+
+	unsigned long getCommandsReceived() const {
+		return commandsReceived;
+	}
+
+	unsigned long getOverruns() const {
+		return overruns;
+	}
+
+	////////////////////////////////////////
+	// IPmsSerial
+
+	bool begin(uint32_t) override {
+		running = true;
+		lastFrame = millis();
+		return true;
+	}
+
+	void end() override {
+		running = false;
+	}
+
+	void setTimeout(unsigned long int) override {}
+
+	size_t available() override {
+		update();
+		return count;
+	}
+
+	void flushInput() override {
+		head = 0;
+		count = 0;
+	}
+
+	uint8_t peek() override {
+		return count == 0 ? UINT8_MAX : buffer[head];
+	}
+
+	uint8_t read() override {
+		return count == 0 ? UINT8_MAX : pop();
+	}
+
+	size_t read(uint8_t* values, const size_t length) override {
+		const auto done = min(length, count);
+		for (size_t i = 0; i < done; ++i) {
+			values[i] = pop();
+		}
+		return done;
+	}
+
+	size_t write(const uint8_t* values, const size_t size) override {
+		if (!running) {
+			return 0;
+		}
+		for (size_t i = 0; i < size; ++i) {
+			const auto value = values[i];
+			if ((commandLen == 0 && value != parser_t::SIG0) || (commandLen == 1 && value != parser_t::SIG1)) {
+				commandLen = 0;
+				continue;
+			}
+			command[commandLen++] = value;
+			if (commandLen == sizeof command) {
+				commandLen = 0;
+				const pmsx::pmsData_t crc = static_cast<pmsx::pmsData_t>((command[5] << 8) | command[6]);
+				if (crc == sum(command, 5)) {
+					execute();
+				}
+			}
+		}
+		return size;
+	}
+};
+
+typedef BasicPmsSimSerial<pmsx::Pms5003> PmsSimSerial;
@@ -0,0 +1,345 @@
+#pragma once
+
+// Streaming statistics of PmsData channels
+//
+// Every update is O(1), memory is fixed (no history arrays in the sketch):
+//   PmsRollingWindow<Window> - mean, min, max of the last Window samples (running sum, monotonic deques)
+//   PmsEwma<Shift>           - exponentially weighted moving average, alpha = 1 / 2^Shift, integer arithmetic
+//   PmsP2Quantile            - approximate quantile (P-square algorithm, Jain & Chlamtac), 5 markers, no samples kept
+//
+// PmsStatistics<Window, Shift> and PmsQuantiles apply them to all PmsData::DATA_SIZE channels:
+//   pmsx::PmsStatistics<8> statistics;
+//   statistics.update(data);
+//   statistics.getMean(4); statistics.getMax(4); statistics.getEwma(4);
+//
+// RAM (AVR): PmsStatistics<Window> uses about DATA_SIZE * (4 * Window + 10) bytes, PmsQuantiles about DATA_SIZE * 64 bytes
+
+#include <pms.h>
+
+namespace pmsx {
+
+	template <uint8_t Window>
+	class PmsRollingWindow {
+		static_assert(Window > 0, "PmsRollingWindow: Window should not be empty");
+
+		// Monotonic deque of ring slots. Values are taken from the ring: all slots in the deque are inside of the window
+		class Deque {
+			uint8_t slots[Window];
+			uint8_t first;
+			uint8_t size;
+		public:
+			Deque() : first(0), size(0) {}
+
+			void clear() {
+				first = 0;
+				size = 0;
+			}
+
+			bool empty() const {
+				return size == 0;
+			}
+
+			uint8_t front() const {
+				return slots[first];
+			}
+
+			uint8_t back() const {
+				return slots[(first + size - 1) % Window];
+			}
+
+			void popFront() {
+				first = (first + 1) % Window;
+				--size;
+			}
+
+			void popBack() {
+				--size;
+			}
+
+			void pushBack(const uint8_t slot) {
+				slots[(first + size) % Window] = slot;
+				++size;
+			}
+		};
+
+		pmsData_t values[Window];
+		uint32_t sum;
+		uint8_t next;
+		uint8_t count;
+		Deque minimums;
+		Deque maximums;
+
+	public:
+		static constexpr uint8_t WINDOW = Window;
+
+		PmsRollingWindow() : sum(0), next(0), count(0) {}
+
+		void reset() {
+			sum = 0;
+			next = 0;
+			count = 0;
+			minimums.clear();
+			maximums.clear();
+		}
+
+		void update(const pmsData_t value) {
+			const uint8_t slot = next;
+			if (count == Window) {
+				// Slot of the oldest sample is reused
+				sum -= values[slot];
+				if (!minimums.empty() && minimums.front() == slot) {
+					minimums.popFront();
+				}
+				if (!maximums.empty() && maximums.front() == slot) {
+					maximums.popFront();
+				}
+			} else {
+				++count;
+			}
+			values[slot] = value;
+			sum += value;
+			next = (slot + 1) % Window;
+
+			while (!minimums.empty() && values[minimums.back()] >= value) {
+				minimums.popBack();
+			}
+			minimums.pushBack(slot);
+			while (!maximums.empty() && values[maximums.back()] <= value) {
+				maximums.popBack();
+			}
+			maximums.pushBack(slot);
+		}
+
+		uint8_t getCount() const {
+			return count;
+		}
+
+		float getMean() const {
+			return count == 0 ? NAN : static_cast<float>(sum) / count;
+		}
+
+		pmsData_t getMin() const {
+			return minimums.empty() ? 0 : values[minimums.front()];
+		}
+
+		pmsData_t getMax() const {
+			return maximums.empty() ? 0 : values[maximums.front()];
+		}
+	};
+
+	template <uint8_t Shift>
+	class PmsEwma {
+		static_assert(Shift > 0 && Shift < 16, "PmsEwma: alpha = 1 / 2^Shift, Shift should be in range 1..15");
+		static constexpr uint8_t FRACTION = 8;
+
+		int32_t state; // value * 2^FRACTION
+		bool initialized;
+
+	public:
+		static constexpr uint8_t SHIFT = Shift;
+
+		PmsEwma() : state(0), initialized(false) {}
+
+		void reset() {
+			state = 0;
+			initialized = false;
+		}
+
+		void update(const pmsData_t value) {
+			const int32_t scaled = static_cast<int32_t>(value) << FRACTION;
+			if (!initialized) {
+				state = scaled;
+				initialized = true;
+				return;
+			}
+			state += (scaled - state) >> Shift;
+		}
+
+		float get() const {
+			return initialized ? static_cast<float>(state) / (1 << FRACTION) : NAN;
+		}
+	};
+
+	class PmsP2Quantile {
+		static constexpr uint8_t MARKERS = 5;
+
+		float quantile;
+		float heights[MARKERS];
+		float desired[MARKERS];
+		uint32_t positions[MARKERS];
+		uint32_t count;
+
+		float increment(const uint8_t i) const {
+			// desired positions move by: 0, p/2, p, (1+p)/2, 1
+			return i == 0 ? 0.0f : i == 1 ? quantile / 2 : i == 2 ? quantile : i == 3 ? (1.0f + quantile) / 2 : 1.0f;
+		}
+
+		float parabolic(const uint8_t i, const float d) const {
+			const float n0 = static_cast<float>(positions[i - 1]);
+			const float n1 = static_cast<float>(positions[i]);
+			const float n2 = static_cast<float>(positions[i + 1]);
+			return heights[i] + d / (n2 - n0) * (
+				(n1 - n0 + d) * (heights[i + 1] - heights[i]) / (n2 - n1) +
+				(n2 - n1 - d) * (heights[i] - heights[i - 1]) / (n1 - n0));
+		}
+
+		float linear(const uint8_t i, const int8_t d) const {
+			const uint8_t j = static_cast<uint8_t>(i + d);
+			return heights[i] + d * (heights[j] - heights[i]) / (static_cast<float>(positions[j]) - static_cast<float>(positions[i]));
+		}
+
+		static void sort(float* values, const uint8_t size) {
+			for (uint8_t i = 1; i < size; ++i) {
+				const float value = values[i];
+				uint8_t j = i;
+				for (; j > 0 && values[j - 1] > value; --j) {
+					values[j] = values[j - 1];
+				}
+				values[j] = value;
+			}
+		}
+
+	public:
+		// quantile: 0.5 - median, 0.9 - 90th percentile, ...
+		explicit PmsP2Quantile(const float quantile = 0.5f) : quantile(quantile), count(0) {}
+
+		void reset() {
+			count = 0;
+		}
+
+		void update(const float value) {
+			if (count < MARKERS) {
+				heights[count++] = value;
+				if (count == MARKERS) {
+					sort(heights, MARKERS);
+					for (uint8_t i = 0; i < MARKERS; ++i) {
+						positions[i] = i;
+						desired[i] = 4 * increment(i);
+					}
+				}
+				return;
+			}
+
+			uint8_t cell;
+			if (value < heights[0]) {
+				heights[0] = value;
+				cell = 0;
+			} else if (value >= heights[MARKERS - 1]) {
+				heights[MARKERS - 1] = value;
+				cell = MARKERS - 2;
+			} else {
+				cell = 0;
+				while (value >= heights[cell + 1]) {
+					++cell;
+				}
+			}
+			for (uint8_t i = cell + 1; i < MARKERS; ++i) {
+				++positions[i];
+			}
+			for (uint8_t i = 0; i < MARKERS; ++i) {
+				desired[i] += increment(i);
+			}
+			++count;
+
+			for (uint8_t i = 1; i < MARKERS - 1; ++i) {
+				const float d = desired[i] - static_cast<float>(positions[i]);
+				if ((d >= 1.0f && positions[i + 1] - positions[i] > 1) || (d <= -1.0f && positions[i] - positions[i - 1] > 1)) {
+					const int8_t step = d >= 0 ? 1 : -1;
+					const float candidate = parabolic(i, step);
+					heights[i] = (heights[i - 1] < candidate && candidate < heights[i + 1]) ? candidate : linear(i, step);
+					positions[i] += step;
+				}
+			}
+		}
+
+		uint32_t getCount() const {
+			return count;
+		}
+
+		float get() const {
+			if (count == 0) {
+				return NAN;
+			}
+			if (count < MARKERS) {
+				float sorted[MARKERS];
+				memcpy(sorted, heights, count * sizeof(float));
+				sort(sorted, static_cast<uint8_t>(count));
+				return sorted[static_cast<uint8_t>(quantile * (count - 1) + 0.5f)];
+			}
+			return heights[MARKERS / 2];
+		}
+	};
+
+	////////////////////////////////////////
+
+	template <uint8_t Window, uint8_t Shift = 3>
+	class PmsStatistics {
+		PmsRollingWindow<Window> windows[PmsData::DATA_SIZE];
+		PmsEwma<Shift> averages[PmsData::DATA_SIZE];
+
+	public:
+		void reset() {
+			for (PmsData::pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+				windows[i].reset();
+				averages[i].reset();
+			}
+		}
+
+		void update(const PmsData& data) {
+			for (PmsData::pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+				const auto value = data.raw.getValue(i);
+				windows[i].update(value);
+				averages[i].update(value);
+			}
+		}
+
+		// Number of samples in the window
+		uint8_t getCount() const {
+			return windows[0].getCount();
+		}
+
+		// index: the same as PmsData::raw index
+		float getMean(const PmsData::pmsIdx_t index) const {
+			return windows[index].getMean();
+		}
+
+		pmsData_t getMin(const PmsData::pmsIdx_t index) const {
+			return windows[index].getMin();
+		}
+
+		pmsData_t getMax(const PmsData::pmsIdx_t index) const {
+			return windows[index].getMax();
+		}
+
+		float getEwma(const PmsData::pmsIdx_t index) const {
+			return averages[index].get();
+		}
+	};
+
+	class PmsQuantiles {
+		PmsP2Quantile estimators[PmsData::DATA_SIZE];
+
+	public:
+		explicit PmsQuantiles(const float quantile = 0.5f) {
+			for (PmsData::pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+				estimators[i] = PmsP2Quantile(quantile);
+			}
+		}
+
+		void reset() {
+			for (PmsData::pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+				estimators[i].reset();
+			}
+		}
+
+		void update(const PmsData& data) {
+			for (PmsData::pmsIdx_t i = 0; i < PmsData::DATA_SIZE; ++i) {
+				estimators[i].update(data.raw.getValue(i));
+			}
+		}
+
+		float get(const PmsData::pmsIdx_t index) const {
+			return estimators[index].get();
+		}
+	};
+}
@@ -0,0 +1,197 @@
+#ifndef _JB_LIBRARIES_SEQLOCK_H_
+#define _JB_LIBRARIES_SEQLOCK_H_
+
+// Single writer, many readers publication slot: sequence lock
+//
+// Writer (ISR, sampling thread) never waits: sequence becomes odd, value is stored, sequence becomes even again.
+// Reader copies the value between two loads of the sequence. Odd or changed sequence: the copy is torn, reader retries.
+// Readers do not write shared memory: no locks, no read-modify-write operations, any number of readers
+//
+// Value is stored as words:
+//   AVR: bytes, single core, compiler barriers only (writer in an ISR is never interrupted by a reader)
+//   other platforms: relaxed std::atomic words between acquire/release fences, no data race even for torn copies
+//
+// Version: number of completed stores, 0 - nothing was stored yet (wraps: 2^31 on 32-bit sequence, 2^15 on AVR). Readers compare it to skip unchanged values.
+//
+// T should be trivially copyable (it is copied by memcpy())
+//
+// Created by https://github.com/jbanaszczyk
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined __AVR__
+#include <util/atomic.h>
+#else
+#include <atomic>
+#include <type_traits>
+#endif
+
+namespace jb {
+	namespace threads {
+
+		template <typename T>
+		class seqlock {
+#if defined __AVR__
+			typedef uint8_t word_t;
+			typedef uint16_t sequence_t;
+
+			volatile sequence_t sequence;
+			volatile word_t words[sizeof(T)];
+
+			static void barrier() {
+				__asm__ __volatile__("" ::: "memory");
+			}
+
+			sequence_t loadSequence() const {
+				sequence_t result;
+				ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+					result = sequence;
+				}
+				return result;
+			}
+
+			void storeSequence(const sequence_t value) {
+				ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+					sequence = value;
+				}
+			}
+
+			sequence_t beginRead() const {
+				const sequence_t result = loadSequence();
+				barrier();
+				return result;
+			}
+
+			bool endRead(const sequence_t started) const {
+				barrier();
+				return loadSequence() == started;
+			}
+
+			void loadWords(word_t* buffer) const {
+				for (size_t i = 0; i < WORDS; ++i) {
+					buffer[i] = words[i];
+				}
+			}
+
+			void storeWords(const word_t* buffer) {
+				for (size_t i = 0; i < WORDS; ++i) {
+					words[i] = buffer[i];
+				}
+			}
+#else
+			static_assert(std::is_trivially_copyable<T>::value, "seqlock: T should be trivially copyable");
+
+			typedef uint32_t word_t;
+			typedef uint32_t sequence_t;
+
+			std::atomic<sequence_t> sequence;
+			std::atomic<word_t> words[(sizeof(T) + sizeof(word_t) - 1) / sizeof(word_t)];
+
+			sequence_t loadSequence() const {
+				return sequence.load(std::memory_order_acquire);
+			}
+
+			void storeSequence(const sequence_t value) {
+				sequence.store(value, std::memory_order_release);
+			}
+
+			sequence_t beginRead() const {
+				return sequence.load(std::memory_order_acquire);
+			}
+
+			// Loads of words can not be moved below the fence
+			bool endRead(const sequence_t started) const {
+				std::atomic_thread_fence(std::memory_order_acquire);
+				return sequence.load(std::memory_order_relaxed) == started;
+			}
+
+			void loadWords(word_t* buffer) const {
+				for (size_t i = 0; i < WORDS; ++i) {
+					buffer[i] = words[i].load(std::memory_order_relaxed);
+				}
+			}
+
+			void storeWords(const word_t* buffer) {
+				for (size_t i = 0; i < WORDS; ++i) {
+					words[i].store(buffer[i], std::memory_order_relaxed);
+				}
+			}
+#endif
+			static constexpr size_t WORDS = (sizeof(T) + sizeof(word_t) - 1) / sizeof(word_t);
+
+			// Writer's own copy of the sequence: the writer never reads shared memory
+			sequence_t written;
+
+		public:
+			seqlock() : sequence(0), words{}, written(0) {}
+			seqlock(const seqlock&) = delete;
+			seqlock& operator = (const seqlock&) = delete;
+
+			// Writer side, single writer only
+			void store(const T& value) {
+				word_t buffer[WORDS]{};
+				memcpy(buffer, &value, sizeof(T));
+#if defined __AVR__
+				storeSequence(static_cast<sequence_t>(written + 1));
+				barrier();
+				storeWords(buffer);
+				barrier();
+#else
+				sequence.store(static_cast<sequence_t>(written + 1), std::memory_order_relaxed);
+				// Odd sequence is visible before any word
+				std::atomic_thread_fence(std::memory_order_release);
+				storeWords(buffer);
+#endif
+				written = static_cast<sequence_t>(written + 2);
+				storeSequence(written);
+			}
+
+			// Reader side: one attempt, returns false if the writer was active (value is not modified)
+			bool try_load(T& value, uint32_t& version) const {
+				const sequence_t started = beginRead();
+				if ((started & 1) != 0) {
+					return false;
+				}
+				word_t buffer[WORDS];
+				loadWords(buffer);
+				if (!endRead(started)) {
+					return false;
+				}
+				memcpy(&value, buffer, sizeof(T));
+				version = started >> 1;
+				return true;
+			}
+
+			// Reader side: consistent copy of the latest value, returns its version
+			uint32_t load(T& value) const {
+				uint32_t version;
+				while (!try_load(value, version)) {
+				}
+				return version;
+			}
+
+			// Reader side: copies the value only if its version differs from the given one, version is updated
+			bool load_changed(T& value, uint32_t& version) const {
+				for (;;) {
+					if (this->version() == version) {
+						return false;
+					}
+					uint32_t loaded;
+					if (try_load(value, loaded)) {
+						version = loaded;
+						return true;
+					}
+				}
+			}
+
+			// Number of completed stores
+			uint32_t version() const {
+				return loadSequence() >> 1;
+			}
+		};
+	}
+}
+
+#endif
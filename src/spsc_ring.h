@@ -0,0 +1,189 @@
+#ifndef _JB_LIBRARIES_SPSC_RING_H_
+#define _JB_LIBRARIES_SPSC_RING_H_
+
+// Fixed capacity, lock-free, single producer / single consumer ring
+//
+// Producer (ISR, sampling thread) never waits for the consumer. If the ring is full:
+//   overflow_policy::drop_newest - new value is discarded
+//   overflow_policy::drop_oldest - the oldest value is discarded, new one is stored
+// Both cases are counted, see overflows()
+//
+// Indices:
+//   AVR: single byte indices, multibyte operations are guarded by ATOMIC_BLOCK
+//   other platforms: std::atomic, acquire/release
+//
+// drop_oldest: producer moves tail (compare and swap) before it overwrites the oldest slot.
+// Consumer copies a slot and confirms it using compare and swap on tail. If the producer was faster, the copy is discarded and consumer retries.
+// The copy races with the producer overwriting the same slot: a torn value is never returned, but the copy itself is a data race.
+// It is harmless only for plain bytes, so drop_oldest requires a trivially copyable T (no copy constructor to run on a torn object).
+//
+// Created by https://github.com/jbanaszczyk
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined __AVR__
+#include <util/atomic.h>
+#else
+#include <atomic>
+#include <type_traits>
+#endif
+
+namespace jb {
+	namespace threads {
+
+		enum class overflow_policy : uint8_t {
+			drop_newest,
+			drop_oldest
+		};
+
+#if defined __AVR__
+		template <typename T>
+		class atomic_index {
+			volatile T value;
+		public:
+			atomic_index() : value(0) {}
+
+			T load() const {
+				T result;
+				ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+					result = value;
+				}
+				return result;
+			}
+
+			void store(const T desired) {
+				ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+					value = desired;
+				}
+			}
+
+			bool compare_exchange(T& expected, const T desired) {
+				bool result;
+				ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+					result = value == expected;
+					if (result) {
+						value = desired;
+					} else {
+						expected = value;
+					}
+				}
+				return result;
+			}
+		};
+
+		typedef uint8_t ring_index_t;
+#else
+		template <typename T>
+		class atomic_index {
+			std::atomic<T> value;
+		public:
+			atomic_index() : value(0) {}
+
+			T load() const {
+				return value.load(std::memory_order_acquire);
+			}
+
+			void store(const T desired) {
+				value.store(desired, std::memory_order_release);
+			}
+
+			bool compare_exchange(T& expected, const T desired) {
+				return value.compare_exchange_strong(expected, desired, std::memory_order_acq_rel, std::memory_order_acquire);
+			}
+		};
+
+		typedef uint32_t ring_index_t;
+#endif
+
+		template <typename T, size_t Capacity, overflow_policy Policy = overflow_policy::drop_newest>
+		class spsc_ring {
+			static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "spsc_ring: Capacity should be a power of 2");
+			static_assert(Capacity <= (static_cast<ring_index_t>(~ring_index_t{ 0 }) >> 1) + 1, "spsc_ring: Capacity is too big for ring_index_t");
+#if defined __AVR__
+			static_assert(Policy != overflow_policy::drop_oldest || __is_trivially_copyable(T), "spsc_ring: drop_oldest requires a trivially copyable T");
+#else
+			static_assert(Policy != overflow_policy::drop_oldest || std::is_trivially_copyable<T>::value, "spsc_ring: drop_oldest requires a trivially copyable T");
+#endif
+
+			// Free running counters, slot = counter % Capacity
+			atomic_index<ring_index_t> head;
+			atomic_index<ring_index_t> tail;
+			atomic_index<uint32_t> overflowCount;
+			T slots[Capacity];
+
+			static size_t slot(const ring_index_t index) {
+				return index & (Capacity - 1);
+			}
+
+		public:
+			static constexpr size_t CAPACITY = Capacity;
+			static constexpr overflow_policy POLICY = Policy;
+
+			spsc_ring() = default;
+			spsc_ring(const spsc_ring&) = delete;
+			spsc_ring& operator = (const spsc_ring&) = delete;
+
+			// Producer side. Returns false if any value was dropped
+			bool push(const T& value) {
+				const ring_index_t h = head.load();
+				ring_index_t t = tail.load();
+				if (static_cast<ring_index_t>(h - t) >= Capacity) {
+					if (Policy == overflow_policy::drop_newest) {
+						overflowCount.store(overflowCount.load() + 1);
+						return false;
+					}
+					// Failure means that consumer has just released the slot
+					if (tail.compare_exchange(t, static_cast<ring_index_t>(t + 1))) {
+						overflowCount.store(overflowCount.load() + 1);
+						slots[slot(h)] = value;
+						head.store(static_cast<ring_index_t>(h + 1));
+						return false;
+					}
+				}
+				slots[slot(h)] = value;
+				head.store(static_cast<ring_index_t>(h + 1));
+				return true;
+			}
+
+			// Consumer side. Returns false if the ring is empty
+			bool pop(T& value) {
+				for (;;) {
+					ring_index_t t = tail.load();
+					if (t == head.load()) {
+						return false;
+					}
+					value = slots[slot(t)];
+					if (Policy == overflow_policy::drop_newest) {
+						tail.store(static_cast<ring_index_t>(t + 1));
+						return true;
+					}
+					if (tail.compare_exchange(t, static_cast<ring_index_t>(t + 1))) {
+						return true;
+					}
+				}
+			}
+
+			size_t size() const {
+				const ring_index_t t = tail.load();
+				const ring_index_t h = head.load();
+				return static_cast<ring_index_t>(h - t);
+			}
+
+			bool empty() const {
+				return size() == 0;
+			}
+
+			static constexpr size_t capacity() {
+				return Capacity;
+			}
+
+			// Number of dropped values
+			uint32_t overflows() const {
+				return overflowCount.load();
+			}
+		};
+	}
+}
+
+#endif
@@ -87,7 +87,7 @@ namespace jb {
 		constexpr tribool operator!=(unknown_keyword_t, const tribool lhs) { return tribool(unknown) != lhs; }
 		constexpr tribool operator!=(const tribool lhs, unknown_keyword_t) { return lhs != tribool(unknown); }
 
-		constexpr bool unknown(tribool arg, unknown_t dummy) { return arg.value == tribool::unknown_value; };
+		constexpr bool unknown(tribool arg, unknown_t) { return arg.value == tribool::unknown_value; };
 	}
 }
 